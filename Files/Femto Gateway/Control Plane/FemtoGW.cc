@@ -1,64 +1,331 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+
 #include <ns3/fatal-error.h>
 #include <ns3/log.h>
+#include <ns3/abort.h>
+#include <ns3/boolean.h>
+
+#include <algorithm>
 
 #include "epc-s1ap-sap.h"
 #include "epc-s11-sap.h"
 
 #include "FemtoGW.h"
+#include "epc-femto-gw-application.h"
+
+NS_LOG_COMPONENT_DEFINE ("FemtoGW");
 
 namespace ns3 {
 
+NS_OBJECT_ENSURE_REGISTERED (FemtoGW);
+
 FemtoGW::FemtoGW ()
+  : m_mmeS1apSapMme (0),
+    m_mmeS11SapMme (0),
+    m_s11SapSgw (0),
+    m_nLocalPathSwitches (0),
+    m_nForwardedPathSwitches (0)
 {
+  NS_LOG_FUNCTION (this);
   m_s1apSapMme = new MemberEpcS1apSapMme<FemtoGW> (this);
+  m_s1apSapEnb = new MemberEpcS1apSapEnb<FemtoGW> (this);
   m_s11SapMme = new MemberEpcS11SapMme<FemtoGW> (this);
 }
 
 
 FemtoGW::~FemtoGW ()
 {
+  NS_LOG_FUNCTION (this);
+}
+
+void
+FemtoGW::DoDispose ()
+{
+  NS_LOG_FUNCTION (this);
+  m_femtoGwApp = 0;
+  delete m_s1apSapMme;
+  delete m_s1apSapEnb;
+  delete m_s11SapMme;
+}
+
+TypeId
+FemtoGW::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::FemtoGW")
+    .SetParent<Object> ()
+    .AddConstructor<FemtoGW> ()
+    .AddAttribute ("LocalPathSwitch",
+                   "If true, the handovers between two HeNBs of the gateway are completed "
+                   "by the gateway; otherwise all the path switches are relayed to the MME.",
+                   BooleanValue (true),
+                   MakeBooleanAccessor (&FemtoGW::m_localPathSwitch),
+                   MakeBooleanChecker ())
+    ;
+  return tid;
+}
+
+EpcS1apSapMme*
+FemtoGW::GetS1apSapMme ()
+{
+  return m_s1apSapMme;
+}
+
+EpcS1apSapEnb*
+FemtoGW::GetS1apSapEnb ()
+{
+  return m_s1apSapEnb;
+}
+
+void
+FemtoGW::SetS1apSapMme (EpcS1apSapMme * s)
+{
+  m_mmeS1apSapMme = s;
+}
+
+void
+FemtoGW::SetS11SapSgw (EpcS11SapSgw * s)
+{
+  m_s11SapSgw = s;
+}
+
+void
+FemtoGW::SetS11SapMme (EpcS11SapMme * s)
+{
+  m_mmeS11SapMme = s;
+}
+
+EpcS11SapMme*
+FemtoGW::GetS11SapMme ()
+{
+  return m_s11SapMme;
+}
+
+void
+FemtoGW::SetFemtoGwApplication (Ptr<EpcFemtoGwApplication> app)
+{
+  m_femtoGwApp = app;
 }
 
-void 
+void
 FemtoGW::AddEnb (uint16_t gci, Ipv4Address enbS1uAddr, EpcS1apSapEnb* enbS1apSap)
 {
   NS_LOG_FUNCTION (this << gci << enbS1uAddr);
-  Ptr<EnbInfo> enbInfo = Create<EnbInfo> ();
+  EnbInfo* enbInfo = &m_enbInfoMap[gci];
   enbInfo->gci = gci;
   enbInfo->s1uAddr = enbS1uAddr;
   enbInfo->s1apSapEnb = enbS1apSap;
-  m_enbInfoMap[gci] = enbInfo;
 }
 
-void 
-FemtoGW::AddUe (uint64_t imsi)
+bool
+FemtoGW::HasEnb (uint16_t gci) const
 {
-  NS_LOG_FUNCTION (this << imsi);
-  Ptr<UeInfo> ueInfo = Create<UeInfo> ();
-  ueInfo->imsi = imsi;
-  ueInfo->mmeUeS1Id = imsi;
-  m_ueInfoMap[imsi] = ueInfo;
-  ueInfo->bearerCounter = 0;
+  return m_enbInfoMap.find (gci) != m_enbInfoMap.end ();
 }
 
-void 
+FemtoGW::EnbInfo*
+FemtoGW::FindEnbInfo (uint16_t gci)
+{
+  std::map<uint16_t, EnbInfo>::iterator it = m_enbInfoMap.find (gci);
+  NS_ASSERT_MSG (it != m_enbInfoMap.end (), "could not find any HeNB with CellId " << gci);
+  return &it->second;
+}
+
+void
+FemtoGW::AddUeTunnel (UeInfo &ueInfo, uint32_t enbTeid)
+{
+  if (std::find (ueInfo.enbTeids.begin (), ueInfo.enbTeids.end (), enbTeid) == ueInfo.enbTeids.end ())
+    {
+      ueInfo.enbTeids.push_back (enbTeid);
+    }
+}
+
+uint64_t
+FemtoGW::GetNLocalPathSwitches () const
+{
+  return m_nLocalPathSwitches;
+}
+
+uint64_t
+FemtoGW::GetNForwardedPathSwitches () const
+{
+  return m_nForwardedPathSwitches;
+}
+
+
+// S1-AP SAP MME forwarded methods
+
+void
 FemtoGW::DoInitialUeMessage (uint64_t mmeUeS1Id, uint16_t enbUeS1Id, uint64_t imsi, uint16_t gci)
 {
-   m_s1apSapMme->InitialUeMessage (imsi, rnti, imsi, m_cellId);
+  NS_LOG_FUNCTION (this << mmeUeS1Id << enbUeS1Id << imsi << gci);
+  // side effect: create entry if not exist
+  UeInfo& ueInfo = m_ueInfoMap[imsi];
+  ueInfo.mmeUeS1Id = mmeUeS1Id;
+  ueInfo.enbUeS1Id = enbUeS1Id;
+  ueInfo.cellId = gci;
+  ueInfo.localPathSwitch = false;
+  ueInfo.forwardedPathSwitch = false;
+  m_mmeS1apSapMme->InitialUeMessage (mmeUeS1Id, enbUeS1Id, imsi, gci);
+}
+
+void
+FemtoGW::DoInitialContextSetupResponse (uint64_t mmeUeS1Id, uint16_t enbUeS1Id, const EpcS1apSapMme::ErabSetupList &erabSetupList)
+{
+  NS_LOG_FUNCTION (this << mmeUeS1Id << enbUeS1Id);
+  m_mmeS1apSapMme->InitialContextSetupResponse (mmeUeS1Id, enbUeS1Id, erabSetupList);
 }
 
-void 
-FemtoGW::DoPathSwitchRequest (uint64_t enbUeS1Id, uint64_t mmeUeS1Id, uint16_t gci, std::list<EpcS1apSapMme::ErabSwitchedInDownlinkItem> erabToBeSwitchedInDownlinkList)
+void
+FemtoGW::DoPathSwitchRequest (uint64_t enbUeS1Id, uint64_t mmeUeS1Id, uint16_t gci, const EpcS1apSapMme::ErabSwitchedInDownlinkList &erabToBeSwitchedInDownlinkList)
 {
-	m_s1apSapMme->PathSwitchRequest (enbUeS1Id, mmeUeS1Id, gci, erabToBeSwitchedInDownlinkList);
+  NS_LOG_FUNCTION (this << mmeUeS1Id << enbUeS1Id << gci);
+  uint64_t imsi = mmeUeS1Id;
+  std::map<uint64_t, UeInfo>::iterator it = m_ueInfoMap.find (imsi);
+  if (m_localPathSwitch && (it != m_ueInfoMap.end ()) && HasEnb (it->second.cellId) && HasEnb (gci))
+    {
+      // both the source and the target cell belong to the gateway
+      NS_LOG_INFO ("IMSI " << imsi << " local path switch from cell " << it->second.cellId << " to cell " << gci);
+      it->second.enbUeS1Id = enbUeS1Id;
+      it->second.cellId = gci;
+      ++m_nLocalPathSwitches;
+      if (m_femtoGwApp != 0)
+        {
+          // the SGW keeps sending to the gateway: just re-point the tunnels
+          for (EpcS1apSapMme::ErabSwitchedInDownlinkList::const_iterator erabIt = erabToBeSwitchedInDownlinkList.begin ();
+               erabIt != erabToBeSwitchedInDownlinkList.end ();
+               ++erabIt)
+            {
+              m_femtoGwApp->SetTunnel (erabIt->enbTeid, gci);
+              AddUeTunnel (it->second, erabIt->enbTeid);
+            }
+          EpcS1apSapEnb::ErabSwitchedInUplinkList erabToBeSwitchedInUplinkList; // unused for now
+          FindEnbInfo (gci)->s1apSapEnb->PathSwitchRequestAcknowledge (enbUeS1Id, mmeUeS1Id, gci, erabToBeSwitchedInUplinkList);
+          return;
+        }
+      it->second.localPathSwitch = true;
+      EpcS11SapSgw::ModifyBearerRequestMessage msg;
+      msg.teid = imsi; // trick to avoid the need for allocating TEIDs on the S11 interface
+      msg.uli.gci = gci;
+      m_s11SapSgw->ModifyBearerRequest (msg);
+      return;
+    }
+
+  // the UE comes from or goes to a cell outside the gateway, or is not
+  // known yet
+  NS_LOG_INFO ("IMSI " << imsi << " path switch to cell " << gci << " relayed to the MME");
+  UeInfo& ueInfo = m_ueInfoMap[imsi];
+  ueInfo.mmeUeS1Id = mmeUeS1Id;
+  ueInfo.enbUeS1Id = enbUeS1Id;
+  ueInfo.cellId = gci;
+  ueInfo.localPathSwitch = false;
+  ueInfo.forwardedPathSwitch = true;
+  ++m_nForwardedPathSwitches;
+  if (m_femtoGwApp != 0)
+    {
+      for (EpcS1apSapMme::ErabSwitchedInDownlinkList::const_iterator erabIt = erabToBeSwitchedInDownlinkList.begin ();
+           erabIt != erabToBeSwitchedInDownlinkList.end ();
+           ++erabIt)
+        {
+          m_femtoGwApp->SetTunnel (erabIt->enbTeid, gci);
+          AddUeTunnel (ueInfo, erabIt->enbTeid);
+        }
+    }
+  m_mmeS1apSapMme->PathSwitchRequest (enbUeS1Id, mmeUeS1Id, gci, erabToBeSwitchedInDownlinkList);
 }
 
-void 
-FemtoGW::DoInitialContextSetupRequest (uint64_t mmeUeS1Id, uint16_t enbUeS1Id, std::list<EpcS1apSapEnb::ErabToBeSetupItem> erabToBeSetupList)
+
+// S1-AP SAP ENB forwarded methods
+
+void
+FemtoGW::DoInitialContextSetupRequest (uint64_t mmeUeS1Id, uint16_t enbUeS1Id, const EpcS1apSapEnb::ErabToBeSetupList &erabToBeSetupList)
 {
+  NS_LOG_FUNCTION (this << mmeUeS1Id << enbUeS1Id);
+  uint64_t imsi = mmeUeS1Id;
+  std::map<uint64_t, UeInfo>::iterator it = m_ueInfoMap.find (imsi);
+  NS_ASSERT_MSG (it != m_ueInfoMap.end (), "could not find any UE with IMSI " << imsi);
+  UeInfo& ueInfo = it->second;
+  uint16_t cellId = ueInfo.cellId;
+  if (m_femtoGwApp != 0)
+    {
+      // the HeNB sees the TEIDs of the gateway
+      EpcS1apSapEnb::ErabToBeSetupList henbErabToBeSetupList = erabToBeSetupList;
+      for (EpcS1apSapEnb::ErabToBeSetupList::iterator erabIt = henbErabToBeSetupList.begin ();
+           erabIt != henbErabToBeSetupList.end ();
+           ++erabIt)
+        {
+          erabIt->sgwTeid = m_femtoGwApp->AddTunnel (erabIt->sgwTeid, cellId);
+          AddUeTunnel (ueInfo, erabIt->sgwTeid);
+        }
+      FindEnbInfo (cellId)->s1apSapEnb->InitialContextSetupRequest (mmeUeS1Id, enbUeS1Id, henbErabToBeSetupList);
+      return;
+    }
+  FindEnbInfo (cellId)->s1apSapEnb->InitialContextSetupRequest (mmeUeS1Id, enbUeS1Id, erabToBeSetupList);
 }
 
-void 
-FemtoGW::DoPathSwitchRequestAcknowledge (uint64_t enbUeS1Id, uint64_t mmeUeS1Id, uint16_t gci, std::list<EpcS1apSapEnb::ErabSwitchedInUplinkItem> erabToBeSwitchedInUplinkList)
+void
+FemtoGW::DoPathSwitchRequestAcknowledge (uint64_t enbUeS1Id, uint64_t mmeUeS1Id, uint16_t gci, const EpcS1apSapEnb::ErabSwitchedInUplinkList &erabToBeSwitchedInUplinkList)
 {
-}
\ No newline at end of file
+  NS_LOG_FUNCTION (this << mmeUeS1Id << enbUeS1Id << gci);
+  uint64_t imsi = mmeUeS1Id;
+  std::map<uint64_t, UeInfo>::iterator it = m_ueInfoMap.find (imsi);
+  if (it != m_ueInfoMap.end ())
+    {
+      it->second.forwardedPathSwitch = false;
+    }
+  FindEnbInfo (gci)->s1apSapEnb->PathSwitchRequestAcknowledge (enbUeS1Id, mmeUeS1Id, gci, erabToBeSwitchedInUplinkList);
+}
+
+
+// S11 SAP MME forwarded methods
+
+void
+FemtoGW::DoCreateSessionResponse (EpcS11SapMme::CreateSessionResponseMessage msg)
+{
+  NS_LOG_FUNCTION (this << msg.teid);
+  m_mmeS11SapMme->CreateSessionResponse (msg);
+}
+
+void
+FemtoGW::DoModifyBearerResponse (EpcS11SapMme::ModifyBearerResponseMessage msg)
+{
+  NS_LOG_FUNCTION (this << msg.teid);
+  uint64_t imsi = msg.teid;
+  std::map<uint64_t, UeInfo>::iterator it = m_ueInfoMap.find (imsi);
+  if (it != m_ueInfoMap.end ())
+    {
+      UeInfo& ueInfo = it->second;
+      if (ueInfo.localPathSwitch)
+        {
+          NS_ASSERT (msg.cause == EpcS11SapMme::ModifyBearerResponseMessage::REQUEST_ACCEPTED);
+          ueInfo.localPathSwitch = false;
+          EpcS1apSapEnb::ErabSwitchedInUplinkList erabToBeSwitchedInUplinkList; // unused for now
+          FindEnbInfo (ueInfo.cellId)->s1apSapEnb->PathSwitchRequestAcknowledge (ueInfo.enbUeS1Id, ueInfo.mmeUeS1Id, ueInfo.cellId, erabToBeSwitchedInUplinkList);
+          return;
+        }
+      if (!ueInfo.forwardedPathSwitch)
+        {
+          // the MME has switched the path of the UE to a cell
+          // outside the gateway: its context is no longer valid
+          NS_LOG_LOGIC ("IMSI " << imsi << " has left the gateway");
+          if (m_femtoGwApp != 0)
+            {
+              for (std::vector<uint32_t>::const_iterator teidIt = ueInfo.enbTeids.begin ();
+                   teidIt != ueInfo.enbTeids.end ();
+                   ++teidIt)
+                {
+                  // the target eNB got the TEIDs of the gateway over X2,
+                  // which the SGW does not know
+                  NS_ABORT_MSG_IF (m_femtoGwApp->IsTranslated (*teidIt),
+                                   "IMSI " << imsi << " with the translated TEID " << *teidIt
+                                   << " has left the femto gateway; TranslateTeids requires "
+                                   "the femto UEs to stay under the gateway");
+                  m_femtoGwApp->RemoveTunnel (*teidIt);
+                }
+            }
+          m_ueInfoMap.erase (it);
+        }
+    }
+  m_mmeS11SapMme->ModifyBearerResponse (msg);
+}
+
+} // namespace ns3
@@ -1,94 +1,243 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+
+#ifndef FEMTO_GW_H
+#define FEMTO_GW_H
+
 #include <ns3/object.h>
+#include <ns3/ptr.h>
+#include <ns3/ipv4-address.h>
 #include <ns3/epc-s1ap-sap.h>
 #include <ns3/epc-s11-sap.h>
 
 #include <map>
 #include <list>
+#include <vector>
 
 namespace ns3 {
 
-class Node;
-class NetDevice;
+class EpcFemtoGwApplication;
 
-class FemtoGW : public object
+/**
+ * \brief S1-AP concentrator between the HeNBs and the MME (HeNB GW).
+ *
+ * Towards the HeNBs the gateway plays the role of the MME, towards the
+ * MME it plays the role of an eNB serving all the cells of its HeNBs.
+ * It keeps its own context of the UEs served by its HeNBs, so that a
+ * handover between two of its HeNBs is completed locally, and the MME
+ * sees no signalling at all.
+ *
+ * If the gateway has a data plane (EpcFemtoGwApplication), the SGW
+ * sees the gateway as the S1-U endpoint of all its cells, and a local
+ * handover only re-points the tunnels of the UE in the data plane: the
+ * target HeNB is acknowledged at once. Otherwise, the gateway asks the
+ * SGW to switch the path and acknowledges the target HeNB when the SGW
+ * answers.
+ *
+ * The gateway is on the path of the S11 responses of the SGW, in order
+ * to receive the answers to its own Modify Bearer Requests; all the
+ * other responses are relayed to the MME.
+ *
+ * When the path of a UE is switched to a cell outside the gateway, its
+ * context and its tunnels in the data plane are removed.
+ */
+class FemtoGW : public Object
 {
 
+  friend class MemberEpcS1apSapMme<FemtoGW>;
+  friend class MemberEpcS1apSapEnb<FemtoGW>;
+  friend class MemberEpcS11SapMme<FemtoGW>;
+
 public:
-  
-  /** 
+
+  /**
    * Constructor
    */
   FemtoGW ();
 
-  /** 
+  /**
    * Destructor
-   */  
+   */
   virtual ~FemtoGW ();
 
-  /** 
-   * Add a new ENB to the MME. 
-   * \param imsi the unique identifier of the UE
-   * \param enbS1apSap the ENB side of the S1-AP SAP 
-   */
-  void AddEnb (uint16_t egci, Ipv4Address enbS1UAddr, EpcS1apSapEnb* enbS1apSap); 
-  
-  /** 
-   * Add a new UE to the HEnb. This is the equivalent of storing the UE
-   * credentials before the UE is ever turned on. 
-   * 
-   * \param imsi the unique identifier of the UE
-   */
-  void AddUe (uint64_t imsi);  
-void 
-FemtoGW::DoInitialUeMessage (uint64_t mmeUeS1Id, uint16_t enbUeS1Id, uint64_t imsi, uint16_t gci);
-void 
-FemtoGW::DoPathSwitchRequest (uint64_t enbUeS1Id, uint64_t mmeUeS1Id, uint16_t gci, std::list<EpcS1apSapMme::ErabSwitchedInDownlinkItem> erabToBeSwitchedInDownlinkList);
-void 
-FemtoGW::DoInitialContextSetupRequest (uint64_t mmeUeS1Id, uint16_t enbUeS1Id, std::list<EpcS1apSapEnb::ErabToBeSetupItem> erabToBeSetupList);
-void 
-FemtoGW::DoPathSwitchRequestAcknowledge (uint64_t enbUeS1Id, uint64_t mmeUeS1Id, uint16_t gci, std::list<EpcS1apSapEnb::ErabSwitchedInUplinkItem> erabToBeSwitchedInUplinkList);
-	
+  // inherited from Object
+  static TypeId GetTypeId (void);
+protected:
+  virtual void DoDispose ();
+
+public:
+
+  /**
+   *
+   * \return the MME side of the S1-AP SAP, to be used by the HeNBs
+   */
+  EpcS1apSapMme* GetS1apSapMme ();
+
+  /**
+   *
+   * \return the eNB side of the S1-AP SAP, to be registered at the MME
+   * for every cell of the gateway
+   */
+  EpcS1apSapEnb* GetS1apSapEnb ();
+
+  /**
+   * Set the MME side of the S1-AP SAP of the MME
+   *
+   * \param s the MME side of the S1-AP SAP
+   */
+  void SetS1apSapMme (EpcS1apSapMme * s);
+
+  /**
+   * Set the SGW side of the S11 SAP
+   *
+   * \param s the SGW side of the S11 SAP
+   */
+  void SetS11SapSgw (EpcS11SapSgw * s);
+
+  /**
+   * Set the MME side of the S11 SAP of the MME, to which the responses
+   * of the SGW are relayed
+   *
+   * \param s the MME side of the S11 SAP
+   */
+  void SetS11SapMme (EpcS11SapMme * s);
+
+  /**
+   *
+   * \return the MME side of the S11 SAP, to be used by the SGW
+   */
+  EpcS11SapMme* GetS11SapMme ();
+
+  /**
+   * Set the data plane of the gateway, whose tunnels are set up and
+   * re-pointed by the gateway
+   *
+   * \param app the data plane of the gateway
+   */
+  void SetFemtoGwApplication (Ptr<EpcFemtoGwApplication> app);
+
+  /**
+   * Add a new HeNB to the gateway.
+   * \param gci the cell ID of the HeNB
+   * \param enbS1uAddr the S1-U address of the HeNB
+   * \param enbS1apSap the ENB side of the S1-AP SAP of the HeNB
+   */
+  void AddEnb (uint16_t gci, Ipv4Address enbS1uAddr, EpcS1apSapEnb* enbS1apSap);
+
+  /**
+   * \param gci a cell ID
+   * \return true if the cell belongs to a HeNB of the gateway
+   */
+  bool HasEnb (uint16_t gci) const;
+
+  /**
+   * \return the number of path switches completed by the gateway
+   */
+  uint64_t GetNLocalPathSwitches () const;
+
+  /**
+   * \return the number of path switches relayed to the MME
+   */
+  uint64_t GetNForwardedPathSwitches () const;
+
 private:
-	
+
+  // S1-AP SAP MME forwarded methods, called by the HeNBs
+  void DoInitialUeMessage (uint64_t mmeUeS1Id, uint16_t enbUeS1Id, uint64_t imsi, uint16_t gci);
+  void DoInitialContextSetupResponse (uint64_t mmeUeS1Id, uint16_t enbUeS1Id, const EpcS1apSapMme::ErabSetupList &erabSetupList);
+  void DoPathSwitchRequest (uint64_t enbUeS1Id, uint64_t mmeUeS1Id, uint16_t gci, const EpcS1apSapMme::ErabSwitchedInDownlinkList &erabToBeSwitchedInDownlinkList);
+
+  // S1-AP SAP ENB forwarded methods, called by the MME
+  void DoInitialContextSetupRequest (uint64_t mmeUeS1Id, uint16_t enbUeS1Id, const EpcS1apSapEnb::ErabToBeSetupList &erabToBeSetupList);
+  void DoPathSwitchRequestAcknowledge (uint64_t enbUeS1Id, uint64_t mmeUeS1Id, uint16_t gci, const EpcS1apSapEnb::ErabSwitchedInUplinkList &erabToBeSwitchedInUplinkList);
+
+  // S11 SAP MME forwarded methods, called by the SGW
+  void DoCreateSessionResponse (EpcS11SapMme::CreateSessionResponseMessage msg);
+  void DoModifyBearerResponse (EpcS11SapMme::ModifyBearerResponseMessage msg);
+
   /**
-   * Hold info on a UE
-   * 
+   * Hold info on a UE served by a HeNB of the gateway
+   *
    */
-  struct UeInfo : public SimpleRefCount<UeInfo>
+  struct UeInfo
   {
     uint64_t mmeUeS1Id;
     uint16_t enbUeS1Id;
-    uint64_t imsi;
     uint16_t cellId;
-    std::list<BearerInfo> bearersToBeActivated;
-    uint16_t bearerCounter;
+    bool localPathSwitch;     ///< true while a path switch completed by the gateway is in progress
+    bool forwardedPathSwitch; ///< true while a path switch relayed to the MME is in progress
+    std::vector<uint32_t> enbTeids; ///< TEIDs towards the HeNBs of the tunnels of the UE in the data plane
   };
 
+  /**
+   * Remember a tunnel of a UE in the data plane, so that it is removed
+   * when the UE leaves the gateway
+   *
+   * \param ueInfo the context of the UE
+   * \param enbTeid the TEID of the tunnel towards the HeNBs
+   */
+  static void AddUeTunnel (UeInfo &ueInfo, uint32_t enbTeid);
+
   /**
    * UeInfo stored by IMSI
-   * 
-   */  
-  std::map<uint64_t, Ptr<UeInfo> > m_ueInfoMap;
+   *
+   */
+  std::map<uint64_t, UeInfo> m_ueInfoMap;
+
   /**
-   * Hold info on a ENB
-   * 
+   * Hold info on a HeNB
+   *
    */
-  struct EnbInfo : public SimpleRefCount<EnbInfo>
+  struct EnbInfo
   {
     uint16_t gci;
     Ipv4Address s1uAddr;
     EpcS1apSapEnb* s1apSapEnb;
   };
 
+  /**
+   * \param gci the cell ID of the HeNB
+   * \return the info of the HeNB, which must exist
+   */
+  EnbInfo* FindEnbInfo (uint16_t gci);
+
   /**
    * EnbInfo stored by EGCI
-   * 
+   *
    */
-  std::map<uint16_t, Ptr<EnbInfo> > m_enbInfoMap;
+  std::map<uint16_t, EnbInfo> m_enbInfoMap;
 
   /**
-   * MME side of the S1-AP SAP
-   * 
+   * MME side of the S1-AP SAP, used by the HeNBs
+   *
    */
   EpcS1apSapMme* m_s1apSapMme;
 
+  /**
+   * ENB side of the S1-AP SAP, used by the MME
+   *
+   */
+  EpcS1apSapEnb* m_s1apSapEnb;
+
+  /**
+   * MME side of the S1-AP SAP of the MME
+   *
+   */
+  EpcS1apSapMme* m_mmeS1apSapMme;
+
+  EpcS11SapMme* m_s11SapMme;
+  EpcS11SapMme* m_mmeS11SapMme;
+  EpcS11SapSgw* m_s11SapSgw;
+
+  /**
+   * data plane, 0 if the HeNBs are connected directly to the SGW
+   */
+  Ptr<EpcFemtoGwApplication> m_femtoGwApp;
+
+  bool m_localPathSwitch;
+  uint64_t m_nLocalPathSwitches;
+  uint64_t m_nForwardedPathSwitches;
+};
+
+} // namespace ns3
+
+#endif // FEMTO_GW_H
@@ -0,0 +1,169 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#ifndef EPC_BENCHMARK_STUBS_H
+#define EPC_BENCHMARK_STUBS_H
+
+#include <ns3/nstime.h>
+#include <ns3/simulator.h>
+#include <ns3/ipv4-address.h>
+#include <ns3/epc-s1ap-sap.h>
+#include <ns3/epc-s11-sap.h>
+
+#include <list>
+
+namespace ns3 {
+
+/**
+ * \ingroup lte
+ *
+ * SGW stub of the EPC benchmarks. It creates the bearers of a UE with
+ * the TEIDs given by GetTeid and accepts every Modify Bearer Request.
+ * The responses are given within the call if the delay is zero, and
+ * scheduled after the delay otherwise.
+ */
+class BenchmarkSgw : public EpcS11SapSgw
+{
+public:
+  BenchmarkSgw (Time delay = Seconds (0))
+    : m_mme (0),
+      m_delay (delay),
+      m_nCreateSessionRequests (0),
+      m_nModifyBearerRequests (0)
+  {
+  }
+
+  /**
+   * \param imsi the IMSI of a UE
+   * \param n the index (starting from 1) of the bearer in the Create
+   * Session Request
+   * \return the TEID of the bearer at the SGW
+   */
+  static uint32_t GetTeid (uint64_t imsi, uint32_t n)
+  {
+    return (imsi - 1) * EpcS1apSapEnb::ErabToBeSetupList::MAX_ERABS + n;
+  }
+
+  virtual void CreateSessionRequest (CreateSessionRequestMessage msg)
+  {
+    ++m_nCreateSessionRequests;
+    EpcS11SapMme::CreateSessionResponseMessage res;
+    res.teid = msg.imsi;
+    uint32_t n = 0;
+    for (std::list<BearerContextToBeCreated>::iterator bit = msg.bearerContextsToBeCreated.begin ();
+         bit != msg.bearerContextsToBeCreated.end ();
+         ++bit)
+      {
+        EpcS11SapMme::BearerContextCreated bearerContext;
+        bearerContext.sgwFteid.teid = GetTeid (msg.imsi, ++n);
+        bearerContext.sgwFteid.address = Ipv4Address ("10.0.0.1");
+        bearerContext.epsBearerId = bit->epsBearerId;
+        bearerContext.bearerLevelQos = bit->bearerLevelQos;
+        bearerContext.tft = bit->tft;
+        res.bearerContextsCreated.push_back (bearerContext);
+      }
+    if (m_delay.IsZero ())
+      {
+        m_mme->CreateSessionResponse (res);
+      }
+    else
+      {
+        Simulator::Schedule (m_delay, &EpcS11SapMme::CreateSessionResponse, m_mme, res);
+      }
+  }
+
+  virtual void ModifyBearerRequest (ModifyBearerRequestMessage msg)
+  {
+    ++m_nModifyBearerRequests;
+    EpcS11SapMme::ModifyBearerResponseMessage res;
+    res.teid = msg.teid;
+    res.cause = EpcS11SapMme::ModifyBearerResponseMessage::REQUEST_ACCEPTED;
+    if (m_delay.IsZero ())
+      {
+        m_mme->ModifyBearerResponse (res);
+      }
+    else
+      {
+        Simulator::Schedule (m_delay, &EpcS11SapMme::ModifyBearerResponse, m_mme, res);
+      }
+  }
+
+  EpcS11SapMme* m_mme;
+  Time m_delay;
+  uint64_t m_nCreateSessionRequests;
+  uint64_t m_nModifyBearerRequests;
+};
+
+/**
+ * \ingroup lte
+ *
+ * eNB stub of the EPC benchmarks, which only counts the S1-AP messages
+ * it receives
+ */
+class BenchmarkEnb : public EpcS1apSapEnb
+{
+public:
+  BenchmarkEnb ()
+    : m_nContextSetups (0),
+      m_nErabs (0),
+      m_nAcks (0)
+  {
+  }
+  virtual void InitialContextSetupRequest (uint64_t mmeUeS1Id, uint16_t enbUeS1Id, const ErabToBeSetupList &erabToBeSetupList)
+  {
+    ++m_nContextSetups;
+    m_nErabs += erabToBeSetupList.size ();
+  }
+  virtual void PathSwitchRequestAcknowledge (uint64_t enbUeS1Id, uint64_t mmeUeS1Id, uint16_t cgi, const ErabSwitchedInUplinkList &erabToBeSwitchedInUplinkList)
+  {
+    ++m_nAcks;
+  }
+  uint64_t m_nContextSetups;
+  uint64_t m_nErabs;
+  uint64_t m_nAcks;
+};
+
+/**
+ * \ingroup lte
+ *
+ * MME stub of the EPC benchmarks, which only counts the S1-AP messages
+ * it receives
+ */
+class BenchmarkMme : public EpcS1apSapMme
+{
+public:
+  BenchmarkMme ()
+    : m_nMessages (0)
+  {
+  }
+  virtual void InitialUeMessage (uint64_t mmeUeS1Id, uint16_t enbUeS1Id, uint64_t imsi, uint16_t ecgi)
+  {
+    ++m_nMessages;
+  }
+  virtual void InitialContextSetupResponse (uint64_t mmeUeS1Id, uint16_t enbUeS1Id, const ErabSetupList &erabSetupList)
+  {
+    ++m_nMessages;
+  }
+  virtual void PathSwitchRequest (uint64_t enbUeS1Id, uint64_t mmeUeS1Id, uint16_t gci, const ErabSwitchedInDownlinkList &erabToBeSwitchedInDownlinkList)
+  {
+    ++m_nMessages;
+  }
+  uint64_t m_nMessages;
+};
+
+} // namespace ns3
+
+#endif // EPC_BENCHMARK_STUBS_H
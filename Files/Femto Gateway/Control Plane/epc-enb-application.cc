@@ -26,8 +26,11 @@
 #include "ns3/ipv4.h"
 #include "ns3/inet-socket-address.h"
 #include "ns3/uinteger.h"
+#include "ns3/abort.h"
+#include "ns3/boolean.h"
+#include "ns3/simulator.h"
+#include "ns3/trace-source-accessor.h"
 
-#include "epc-gtpu-header.h"
 #include "eps-bearer-tag.h"
 
 
@@ -35,6 +38,15 @@ namespace ns3 {
 
 NS_LOG_COMPONENT_DEFINE ("EpcEnbApplication");
 
+// GTP-U message types, from 3GPP TS 29.281 Section 6.1
+static const uint8_t GTPU_END_MARKER = 254;
+
+// size of the payload of the end marker sent over X2-U: this is not
+// part of the standard, the source eNB uses it to tell the target eNB
+// the last time it sent a packet to the UE and the number of packets
+// it forwarded
+static const uint32_t END_MARKER_PAYLOAD_SIZE = 12;
+
 
 EpcEnbApplication::EpsFlowId_t::EpsFlowId_t ()
 {
@@ -63,7 +75,30 @@ TypeId
 EpcEnbApplication::GetTypeId (void)
 {
   static TypeId tid = TypeId ("ns3::EpcEnbApplication")
-    .SetParent<Object> ();
+    .SetParent<Object> ()
+    .AddAttribute ("DataForwarding",
+                   "If true, the downlink packets of the UEs handed over to a neighbour eNB "
+                   "are forwarded to the target eNB over X2-U until the UE context is released",
+                   BooleanValue (true),
+                   MakeBooleanAccessor (&EpcEnbApplication::m_dataForwarding),
+                   MakeBooleanChecker ())
+    .AddAttribute ("DataForwardingTimeout",
+                   "Maximum time during which the target eNB holds the packets of a tunnel "
+                   "handed over to it, from the Path Switch Request or the first forwarded "
+                   "packet, waiting for the end marker of the source eNB",
+                   TimeValue (Seconds (1)),
+                   MakeTimeAccessor (&EpcEnbApplication::m_dataForwardingTimeout),
+                   MakeTimeChecker ())
+    .AddTraceSource ("HandoverData",
+                     "End of the data forwarding of a handover to this eNB: interruption time and lost packets",
+                     MakeTraceSourceAccessor (&EpcEnbApplication::m_handoverDataTrace))
+    .AddTraceSource ("PathSwitchRequest",
+                     "The Path Switch Request of a UE handed over to this eNB is sent to the MME",
+                     MakeTraceSourceAccessor (&EpcEnbApplication::m_pathSwitchRequestTrace))
+    .AddTraceSource ("PathSwitchRequestAcknowledge",
+                     "The Path Switch Request Acknowledge of a UE handed over to this eNB is received",
+                     MakeTraceSourceAccessor (&EpcEnbApplication::m_pathSwitchRequestAckTrace))
+    ;
   return tid;
 }
 
@@ -73,6 +108,16 @@ EpcEnbApplication::DoDispose (void)
   NS_LOG_FUNCTION (this);
   m_lteSocket = 0;
   m_s1uSocket = 0;
+  m_x2uSocket = 0;
+  for (std::map<uint32_t, IncomingForwardingInfo>::iterator it = m_incomingForwardingMap.begin ();
+       it != m_incomingForwardingMap.end ();
+       ++it)
+    {
+      it->second.timeout.Cancel ();
+    }
+  m_incomingForwardingMap.clear ();
+  m_outgoingForwardingMap.clear ();
+  m_handoverDataMap.clear ();
   delete m_s1SapProvider;
   delete m_s1apSapEnb;
 }
@@ -83,17 +128,23 @@ EpcEnbApplication::EpcEnbApplication (Ptr<Socket> lteSocket, Ptr<Socket> s1uSock
     m_s1uSocket (s1uSocket),    
     m_enbS1uAddress (enbS1uAddress),
     m_sgwS1uAddress (sgwS1uAddress),
+    m_nTeids (0),
+    m_teidRbidTableBits (6),
     m_gtpuUdpPort (2152), // fixed by the standard
     m_s1SapUser (0),
-//    m_s1apSapMme (0),
-  m_s1apSapGW (0),
-    m_cellId (cellId)
+    m_s1apSapMme (0),
+    m_cellId (cellId),
+    m_x2uUdpPort (2153)
 {
   NS_LOG_FUNCTION (this << lteSocket << s1uSocket << sgwS1uAddress);
+  m_sgwS1uSocketAddress = InetSocketAddress (m_sgwS1uAddress, m_gtpuUdpPort);
   m_s1uSocket->SetRecvCallback (MakeCallback (&EpcEnbApplication::RecvFromS1uSocket, this));
   m_lteSocket->SetRecvCallback (MakeCallback (&EpcEnbApplication::RecvFromLteSocket, this));
   m_s1SapProvider = new MemberEpcEnbS1SapProvider<EpcEnbApplication> (this);
   m_s1apSapEnb = new MemberEpcS1apSapEnb<EpcEnbApplication> (this);
+  TeidEntry unused;
+  unused.used = false;
+  m_teidRbidTable.resize (1 << m_teidRbidTableBits, unused);
 }
 
 
@@ -117,9 +168,9 @@ EpcEnbApplication::GetS1SapProvider ()
 }
 
 void 
-EpcEnbApplication::SetS1apSapGW (EpcS1apSapMme * s)
+EpcEnbApplication::SetS1apSapMme (EpcS1apSapMme * s)
 {
-  m_s1apSapGW = s;
+  m_s1apSapMme = s;
 }
 
   
@@ -129,6 +180,55 @@ EpcEnbApplication::GetS1apSapEnb ()
   return m_s1apSapEnb;
 }
 
+void 
+EpcEnbApplication::SetX2uSocket (Ptr<Socket> x2uSocket)
+{
+  NS_LOG_FUNCTION (this << x2uSocket);
+  m_x2uSocket = x2uSocket;
+  m_x2uSocket->SetRecvCallback (MakeCallback (&EpcEnbApplication::RecvFromX2uSocket, this));
+}
+
+void 
+EpcEnbApplication::AddX2uNeighbour (uint16_t cellId, Ipv4Address x2Address)
+{
+  NS_LOG_FUNCTION (this << cellId << x2Address);
+  m_x2uNeighbourAddressMap[cellId] = x2Address;
+  m_x2uNeighbourCellIdMap[x2Address] = cellId;
+}
+
+void 
+EpcEnbApplication::HandoverStart (uint64_t imsi, uint16_t cellId, uint16_t rnti, uint16_t targetCellId)
+{
+  NS_LOG_FUNCTION (this << imsi << cellId << rnti << targetCellId);
+  if (!m_dataForwarding || m_x2uSocket == 0)
+    {
+      return;
+    }
+  std::map<uint16_t, Ipv4Address>::iterator neighbourIt = m_x2uNeighbourAddressMap.find (targetCellId);
+  if (neighbourIt == m_x2uNeighbourAddressMap.end ())
+    {
+      NS_LOG_WARN ("no X2-U interface with cell " << targetCellId << ", the packets of RNTI " << rnti << " are not forwarded");
+      return;
+    }
+  if (rnti >= m_rbidTeidTable.size ())
+    {
+      return;
+    }
+  const UeBearers& ue = m_rbidTeidTable[rnti];
+  for (uint8_t i = 0; i < MAX_EPS_BEARERS; ++i)
+    {
+      if (ue.bidMask & (1 << i))
+        {
+          OutgoingForwardingInfo info;
+          info.rnti = rnti;
+          info.targetX2Address = neighbourIt->second;
+          info.nForwarded = 0;
+          info.lastDelivery = ue.lastDelivery;
+          m_outgoingForwardingMap[ue.gtpu[i].GetTeid ()] = info;
+        }
+    }
+}
+
 void 
 EpcEnbApplication::DoInitialUeMessage (uint64_t imsi, uint16_t rnti)
 {
@@ -136,7 +236,6 @@ EpcEnbApplication::DoInitialUeMessage (uint64_t imsi, uint16_t rnti)
   // side effect: create entry if not exist
   m_imsiRntiMap[imsi] = rnti;
   m_s1apSapMme->InitialUeMessage (imsi, rnti, imsi, m_cellId);
- //   m_s1apSapGW->InitialUeMessage (imsi, rnti, imsi, m_cellId);
 }
 
 void 
@@ -150,20 +249,12 @@ EpcEnbApplication::DoPathSwitchRequest (EpcEnbS1SapProvider::PathSwitchRequestPa
   m_imsiRntiMap[imsi] = params.rnti;
 
   uint16_t gci = params.cellId;
-  std::list<EpcS1apSapMme::ErabSwitchedInDownlinkItem> erabToBeSwitchedInDownlinkList;
+  EpcS1apSapMme::ErabSwitchedInDownlinkList erabToBeSwitchedInDownlinkList;
   for (std::list<EpcEnbS1SapProvider::BearerToBeSwitched>::iterator bit = params.bearersToBeSwitched.begin ();
        bit != params.bearersToBeSwitched.end ();
        ++bit)
     {
-      EpsFlowId_t flowId;
-      flowId.m_rnti = params.rnti;
-      flowId.m_bid = bit->epsBearerId;
-      uint32_t teid = bit->teid;
-      
-      EpsFlowId_t rbid (params.rnti, bit->epsBearerId);
-      // side effect: create entries if not exist
-      m_rbidTeidMap[params.rnti][bit->epsBearerId] = teid;
-      m_teidRbidMap[teid] = rbid;
+      SetupS1Bearer (bit->teid, params.rnti, bit->epsBearerId);
 
       EpcS1apSapMme::ErabSwitchedInDownlinkItem erab;
       erab.erabId = bit->epsBearerId;
@@ -172,34 +263,74 @@ EpcEnbApplication::DoPathSwitchRequest (EpcEnbS1SapProvider::PathSwitchRequestPa
 
       erabToBeSwitchedInDownlinkList.push_back (erab);
     }
+  if (m_dataForwarding && m_x2uSocket != 0)
+    {
+      // every switched tunnel waits for the end marker of the source
+      // eNB, even if nothing was forwarded yet, so that the packets of
+      // the SGW are held behind the forwarded ones and the handover is
+      // reported. All the tunnels are tracked before any is flushed,
+      // since the handover is reported once none of them is left.
+      for (std::list<EpcEnbS1SapProvider::BearerToBeSwitched>::iterator bit = params.bearersToBeSwitched.begin ();
+           bit != params.bearersToBeSwitched.end ();
+           ++bit)
+        {
+          if (m_incomingForwardingMap.find (bit->teid) == m_incomingForwardingMap.end ())
+            {
+              AddIncomingForwarding (bit->teid, 0);
+            }
+        }
+    }
+  if (!m_incomingForwardingMap.empty ())
+    {
+      // deliver the packets forwarded by the source eNB before the UE
+      // was connected
+      for (std::list<EpcEnbS1SapProvider::BearerToBeSwitched>::iterator bit = params.bearersToBeSwitched.begin ();
+           bit != params.bearersToBeSwitched.end ();
+           ++bit)
+        {
+          if (m_incomingForwardingMap.find (bit->teid) != m_incomingForwardingMap.end ())
+            {
+              FlushIncomingForwarding (bit->teid);
+            }
+        }
+    }
+  m_pathSwitchRequestTrace (imsi, m_cellId, params.rnti);
   m_s1apSapMme->PathSwitchRequest (enbUeS1Id, mmeUeS1Id, gci, erabToBeSwitchedInDownlinkList);
-//  m_s1apSapGW->PathSwitchRequest (enbUeS1Id, mmeUeS1Id, gci, erabToBeSwitchedInDownlinkList);
 }
 
 void 
 EpcEnbApplication::DoUeContextRelease (uint16_t rnti)
 {
   NS_LOG_FUNCTION (this << rnti);
-  std::map<uint16_t, std::map<uint8_t, uint32_t> >::iterator rntiIt = m_rbidTeidMap.find (rnti);
-  if (rntiIt != m_rbidTeidMap.end ())
+  if (rnti < m_rbidTeidTable.size ())
     {
-      for (std::map<uint8_t, uint32_t>::iterator bidIt = rntiIt->second.begin ();
-           bidIt != rntiIt->second.end ();
-           ++bidIt)
+      UeBearers& ue = m_rbidTeidTable[rnti];
+      for (uint8_t i = 0; i < MAX_EPS_BEARERS; ++i)
         {
-          uint32_t teid = bidIt->second;
-          m_teidRbidMap.erase (teid);
+          if (ue.bidMask & (1 << i))
+            {
+              uint32_t teid = ue.gtpu[i].GetTeid ();
+              if (m_outgoingForwardingMap.find (teid) != m_outgoingForwardingMap.end ())
+                {
+                  // the path has been switched: the SGW has sent its
+                  // last packet to this eNB
+                  EndOutgoingForwarding (teid);
+                }
+              RemoveTeid (teid);
+            }
         }
-      m_rbidTeidMap.erase (rntiIt);
+      ue.bidMask = 0;
+      ue.lastDelivery = Seconds (-1);
     }
+  m_handoverDataMap.erase (rnti);
 }
 
 void 
-EpcEnbApplication::DoInitialContextSetupRequest (uint64_t mmeUeS1Id, uint16_t enbUeS1Id, std::list<EpcS1apSapEnb::ErabToBeSetupItem> erabToBeSetupList)
+EpcEnbApplication::DoInitialContextSetupRequest (uint64_t mmeUeS1Id, uint16_t enbUeS1Id, const EpcS1apSapEnb::ErabToBeSetupList &erabToBeSetupList)
 {
   NS_LOG_FUNCTION (this);
   
-  for (std::list<EpcS1apSapEnb::ErabToBeSetupItem>::iterator erabIt = erabToBeSetupList.begin ();
+  for (EpcS1apSapEnb::ErabToBeSetupList::const_iterator erabIt = erabToBeSetupList.begin ();
        erabIt != erabToBeSetupList.end ();
        ++erabIt)
     {
@@ -217,16 +348,139 @@ EpcEnbApplication::DoInitialContextSetupRequest (uint64_t mmeUeS1Id, uint16_t en
       params.gtpTeid = erabIt->sgwTeid;
       m_s1SapUser->DataRadioBearerSetupRequest (params);
 
-      EpsFlowId_t rbid (rnti, erabIt->erabId);
-      // side effect: create entries if not exist
-      m_rbidTeidMap[rnti][erabIt->erabId] = params.gtpTeid;
-      m_teidRbidMap[params.gtpTeid] = rbid;
+      SetupS1Bearer (params.gtpTeid, rnti, erabIt->erabId);
+    }
+}
 
+void 
+EpcEnbApplication::SetupS1Bearer (uint32_t teid, uint16_t rnti, uint8_t bid)
+{
+  NS_LOG_FUNCTION (this << teid << rnti << (uint32_t) bid);
+  NS_ASSERT_MSG (bid >= 1 && bid <= MAX_EPS_BEARERS, "invalid EPS Bearer ID " << (uint32_t) bid);
+  if (rnti >= m_rbidTeidTable.size ())
+    {
+      UeBearers none;
+      none.bidMask = 0;
+      none.lastDelivery = Seconds (-1);
+      m_rbidTeidTable.resize (rnti + 1, none);
+    }
+  UeBearers& ue = m_rbidTeidTable[rnti];
+  uint16_t bidBit = 1 << (bid - 1);
+  if ((ue.bidMask & bidBit) && (ue.gtpu[bid - 1].GetTeid () != teid))
+    {
+      // the bearer had another TEID, forget it unless it has been
+      // reused by another bearer in the meantime
+      uint32_t oldTeid = ue.gtpu[bid - 1].GetTeid ();
+      const EpsFlowId_t* oldRbid = FindTeid (oldTeid);
+      if (oldRbid != 0 && oldRbid->m_rnti == rnti && oldRbid->m_bid == bid)
+        {
+          RemoveTeid (oldTeid);
+        }
+    }
+  // the UE may come back before the end of the forwarding
+  m_outgoingForwardingMap.erase (teid);
+  // the GTP-U header of the tunnel is serialized once, here
+  ue.gtpu[bid - 1] = GtpuHeaderTemplate (teid);
+  ue.bidMask |= bidBit;
+  AddTeid (teid, EpsFlowId_t (rnti, bid));
+}
+
+uint32_t
+EpcEnbApplication::HashTeid (uint32_t teid) const
+{
+  // Fibonacci hashing: consecutive TEIDs, as allocated by the SGW, are
+  // spread over the whole table
+  return (teid * 2654435761U) >> (32 - m_teidRbidTableBits);
+}
+
+uint32_t
+EpcEnbApplication::FindTeidIndex (uint32_t teid) const
+{
+  uint32_t mask = m_teidRbidTable.size () - 1;
+  uint32_t i = HashTeid (teid);
+  while (m_teidRbidTable[i].used && m_teidRbidTable[i].teid != teid)
+    {
+      i = (i + 1) & mask;
+    }
+  return i;
+}
+
+const EpcEnbApplication::EpsFlowId_t*
+EpcEnbApplication::FindTeid (uint32_t teid) const
+{
+  const TeidEntry& entry = m_teidRbidTable[FindTeidIndex (teid)];
+  return entry.used ? &entry.rbid : 0;
+}
+
+void
+EpcEnbApplication::AddTeid (uint32_t teid, EpsFlowId_t rbid)
+{
+  uint32_t i = FindTeidIndex (teid);
+  if (m_teidRbidTable[i].used)
+    {
+      m_teidRbidTable[i].rbid = rbid;
+      return;
+    }
+  if (2 * (m_nTeids + 1) > m_teidRbidTable.size ())
+    {
+      // grow the table and insert all the TEIDs again
+      NS_ABORT_MSG_IF (m_teidRbidTableBits == 30, "too many S1-U TEIDs");
+      std::vector<TeidEntry> oldTable;
+      oldTable.swap (m_teidRbidTable);
+      ++m_teidRbidTableBits;
+      TeidEntry unused;
+      unused.used = false;
+      m_teidRbidTable.resize (1 << m_teidRbidTableBits, unused);
+      for (std::vector<TeidEntry>::const_iterator it = oldTable.begin (); it != oldTable.end (); ++it)
+        {
+          if (it->used)
+            {
+              m_teidRbidTable[FindTeidIndex (it->teid)] = *it;
+            }
+        }
+      i = FindTeidIndex (teid);
+    }
+  m_teidRbidTable[i].teid = teid;
+  m_teidRbidTable[i].rbid = rbid;
+  m_teidRbidTable[i].used = true;
+  ++m_nTeids;
+}
+
+void
+EpcEnbApplication::RemoveTeid (uint32_t teid)
+{
+  uint32_t i = FindTeidIndex (teid);
+  if (!m_teidRbidTable[i].used)
+    {
+      return;
+    }
+  m_teidRbidTable[i].used = false;
+  --m_nTeids;
+  // move back the following entries of the cluster which can no
+  // longer be reached by linear probing
+  uint32_t mask = m_teidRbidTable.size () - 1;
+  uint32_t j = i;
+  while (true)
+    {
+      j = (j + 1) & mask;
+      if (!m_teidRbidTable[j].used)
+        {
+          break;
+        }
+      uint32_t home = HashTeid (m_teidRbidTable[j].teid);
+      // the entry stays if its home slot is cyclically in (i, j]
+      if (((j - home) & mask) < ((j - i) & mask))
+        {
+          continue;
+        }
+      m_teidRbidTable[i] = m_teidRbidTable[j];
+      m_teidRbidTable[j].used = false;
+      i = j;
     }
 }
 
 void 
-EpcEnbApplication::DoPathSwitchRequestAcknowledge (uint64_t enbUeS1Id, uint64_t mmeUeS1Id, uint16_t gci, std::list<EpcS1apSapEnb::ErabSwitchedInUplinkItem> erabToBeSwitchedInUplinkList)
+EpcEnbApplication::DoPathSwitchRequestAcknowledge (uint64_t enbUeS1Id, uint64_t mmeUeS1Id, uint16_t gci, const EpcS1apSapEnb::ErabSwitchedInUplinkList &erabToBeSwitchedInUplinkList)
 {
   NS_LOG_FUNCTION (this);
 
@@ -234,6 +488,7 @@ EpcEnbApplication::DoPathSwitchRequestAcknowledge (uint64_t enbUeS1Id, uint64_t
   std::map<uint64_t, uint16_t>::iterator imsiIt = m_imsiRntiMap.find (imsi);
   NS_ASSERT_MSG (imsiIt != m_imsiRntiMap.end (), "unknown IMSI");
   uint16_t rnti = imsiIt->second;
+  m_pathSwitchRequestAckTrace (imsi, m_cellId, rnti);
   EpcEnbS1SapUser::PathSwitchRequestAcknowledgeParameters params;
   params.rnti = rnti;
   m_s1SapUser->PathSwitchRequestAcknowledge (params);
@@ -256,17 +511,14 @@ EpcEnbApplication::RecvFromLteSocket (Ptr<Socket> socket)
   uint16_t rnti = tag.GetRnti ();
   uint8_t bid = tag.GetBid ();
   NS_LOG_LOGIC ("received packet with RNTI=" << (uint32_t) rnti << ", BID=" << (uint32_t)  bid);
-  std::map<uint16_t, std::map<uint8_t, uint32_t> >::iterator rntiIt = m_rbidTeidMap.find (rnti);
-  if (rntiIt == m_rbidTeidMap.end ())
+  if (rnti >= m_rbidTeidTable.size () || m_rbidTeidTable[rnti].bidMask == 0)
     {
       NS_LOG_WARN ("UE context not found, discarding packet");
     }
   else
     {
-      std::map<uint8_t, uint32_t>::iterator bidIt = rntiIt->second.find (bid);
-      NS_ASSERT (bidIt != rntiIt->second.end ());
-      uint32_t teid = bidIt->second;
-      SendToS1uSocket (packet, teid);
+      NS_ASSERT (bid >= 1 && bid <= MAX_EPS_BEARERS && (m_rbidTeidTable[rnti].bidMask & (1 << (bid - 1))));
+      SendToS1uSocket (packet, m_rbidTeidTable[rnti].gtpu[bid - 1]);
     }
 }
 
@@ -276,17 +528,268 @@ EpcEnbApplication::RecvFromS1uSocket (Ptr<Socket> socket)
   NS_LOG_FUNCTION (this << socket);  
   NS_ASSERT (socket == m_s1uSocket);
   Ptr<Packet> packet = socket->Recv ();
-  GtpuHeader gtpu;
+  GtpuHeaderTemplate gtpu;
   packet->RemoveHeader (gtpu);
   uint32_t teid = gtpu.GetTeid ();
-  std::map<uint32_t, EpsFlowId_t>::iterator it = m_teidRbidMap.find (teid);
-  NS_ASSERT (it != m_teidRbidMap.end ());
 
   // workaround for bug 231 https://www.nsnam.org/bugzilla/show_bug.cgi?id=231
   SocketAddressTag tag;
   packet->RemovePacketTag (tag);
-  
-  SendToLteSocket (packet, it->second.m_rnti, it->second.m_bid);
+
+  if (!m_outgoingForwardingMap.empty ())
+    {
+      std::map<uint32_t, OutgoingForwardingInfo>::iterator it = m_outgoingForwardingMap.find (teid);
+      if (it != m_outgoingForwardingMap.end ())
+        {
+          // the UE is being handed over, the packet goes to the target eNB
+          ++it->second.nForwarded;
+          packet->AddHeader (gtpu);
+          SendToX2uSocket (packet, it->second.targetX2Address);
+          return;
+        }
+    }
+  if (!m_incomingForwardingMap.empty ())
+    {
+      std::map<uint32_t, IncomingForwardingInfo>::iterator it = m_incomingForwardingMap.find (teid);
+      if (it != m_incomingForwardingMap.end () && !it->second.endMarker)
+        {
+          // the source eNB may still forward older packets
+          it->second.s1uPackets.push_back (packet);
+          return;
+        }
+    }
+  const EpsFlowId_t* rbid = FindTeid (teid);
+  if (rbid == 0)
+    {
+      NS_LOG_WARN ("unknown TEID " << teid << ", discarding packet");
+      return;
+    }
+  SendToLteSocket (packet, rbid->m_rnti, rbid->m_bid);
+}
+
+void 
+EpcEnbApplication::RecvFromX2uSocket (Ptr<Socket> socket)
+{
+  NS_LOG_FUNCTION (this << socket);
+  NS_ASSERT (socket == m_x2uSocket);
+  Address from;
+  Ptr<Packet> packet = socket->RecvFrom (from);
+
+  // workaround for bug 231 https://www.nsnam.org/bugzilla/show_bug.cgi?id=231
+  SocketAddressTag tag;
+  packet->RemovePacketTag (tag);
+
+  GtpuHeaderTemplate gtpu;
+  packet->RemoveHeader (gtpu);
+  uint32_t teid = gtpu.GetTeid ();
+  bool endMarker = (gtpu.GetMessageType () == GTPU_END_MARKER);
+
+  std::map<Ipv4Address, uint16_t>::iterator cellIt = m_x2uNeighbourCellIdMap.find (InetSocketAddress::ConvertFrom (from).GetIpv4 ());
+  uint16_t sourceCellId = (cellIt != m_x2uNeighbourCellIdMap.end ()) ? cellIt->second : 0;
+  std::map<uint32_t, IncomingForwardingInfo>::iterator it = m_incomingForwardingMap.find (teid);
+  if (it == m_incomingForwardingMap.end ())
+    {
+      if (endMarker && FindTeid (teid) != 0)
+        {
+          // the forwarding of the tunnel already timed out
+          NS_LOG_WARN ("late end marker for TEID " << teid << ", discarded");
+          return;
+        }
+      // the UE is not connected yet
+      AddIncomingForwarding (teid, sourceCellId);
+      it = m_incomingForwardingMap.find (teid);
+    }
+  else if (it->second.sourceCellId == 0)
+    {
+      // tracked since the Path Switch Request
+      it->second.sourceCellId = sourceCellId;
+    }
+
+  if (endMarker)
+    {
+      NS_ASSERT (packet->GetSize () == END_MARKER_PAYLOAD_SIZE);
+      uint8_t payload[END_MARKER_PAYLOAD_SIZE];
+      packet->CopyData (payload, END_MARKER_PAYLOAD_SIZE);
+      uint64_t lastDelivery = 0;
+      for (uint32_t i = 0; i < 8; ++i)
+        {
+          lastDelivery = (lastDelivery << 8) | payload[i];
+        }
+      uint32_t nForwarded = 0;
+      for (uint32_t i = 8; i < END_MARKER_PAYLOAD_SIZE; ++i)
+        {
+          nForwarded = (nForwarded << 8) | payload[i];
+        }
+      it->second.endMarker = true;
+      it->second.nForwarded = nForwarded;
+      it->second.sourceLastDelivery = NanoSeconds ((int64_t) lastDelivery);
+    }
+  else
+    {
+      ++it->second.nReceived;
+      it->second.x2uPackets.push_back (packet);
+    }
+
+  if (FindTeid (teid) != 0)
+    {
+      FlushIncomingForwarding (teid);
+    }
+}
+
+void 
+EpcEnbApplication::AddIncomingForwarding (uint32_t teid, uint16_t sourceCellId)
+{
+  NS_LOG_FUNCTION (this << teid << sourceCellId);
+  IncomingForwardingInfo info;
+  info.sourceCellId = sourceCellId;
+  info.nReceived = 0;
+  info.nDropped = 0;
+  info.endMarker = false;
+  info.nForwarded = 0;
+  info.sourceLastDelivery = Seconds (-1);
+  info.timeout = Simulator::Schedule (m_dataForwardingTimeout, &EpcEnbApplication::EndIncomingForwarding, this, teid);
+  m_incomingForwardingMap[teid] = info;
+}
+
+void 
+EpcEnbApplication::FlushIncomingForwarding (uint32_t teid)
+{
+  NS_LOG_FUNCTION (this << teid);
+  std::map<uint32_t, IncomingForwardingInfo>::iterator it = m_incomingForwardingMap.find (teid);
+  NS_ASSERT (it != m_incomingForwardingMap.end ());
+  const EpsFlowId_t* rbid = FindTeid (teid);
+  NS_ASSERT (rbid != 0);
+  uint16_t rnti = rbid->m_rnti;
+  uint8_t bid = rbid->m_bid;
+
+  if (m_handoverDataMap.find (rnti) == m_handoverDataMap.end ())
+    {
+      HandoverDataInfo handoverData;
+      handoverData.sourceCellId = it->second.sourceCellId;
+      handoverData.nForwarded = 0;
+      handoverData.nReceived = 0;
+      handoverData.nDropped = 0;
+      handoverData.sourceLastDelivery = Seconds (-1);
+      handoverData.firstDelivery = Seconds (-1);
+      m_handoverDataMap[rnti] = handoverData;
+    }
+
+  std::list<Ptr<Packet> >& x2uPackets = it->second.x2uPackets;
+  while (!x2uPackets.empty ())
+    {
+      SendToLteSocket (x2uPackets.front (), rnti, bid);
+      x2uPackets.pop_front ();
+    }
+  if (it->second.endMarker)
+    {
+      EndIncomingForwarding (teid);
+    }
+}
+
+void 
+EpcEnbApplication::EndIncomingForwarding (uint32_t teid)
+{
+  NS_LOG_FUNCTION (this << teid);
+  std::map<uint32_t, IncomingForwardingInfo>::iterator it = m_incomingForwardingMap.find (teid);
+  NS_ASSERT (it != m_incomingForwardingMap.end ());
+  IncomingForwardingInfo& info = it->second;
+  info.timeout.Cancel ();
+  // without the end marker, the forwarded packets are taken as the
+  // packets received
+  uint32_t nForwarded = info.endMarker ? info.nForwarded : info.nReceived;
+
+  const EpsFlowId_t* rbid = FindTeid (teid);
+  if (rbid == 0)
+    {
+      // the UE never arrived
+      info.nDropped += info.x2uPackets.size () + info.s1uPackets.size ();
+      NS_LOG_WARN ("forwarding of TEID " << teid << " timed out, " << info.nDropped << " packets dropped");
+      uint32_t nLost = (nForwarded > info.nReceived ? nForwarded - info.nReceived : 0) + info.nDropped;
+      m_handoverDataTrace (0, info.sourceCellId, m_cellId, Seconds (0), nForwarded, nLost);
+      m_incomingForwardingMap.erase (it);
+      return;
+    }
+
+  uint16_t rnti = rbid->m_rnti;
+  uint8_t bid = rbid->m_bid;
+  // deliver in order the forwarded packets, then the ones received
+  // from the SGW
+  while (!info.x2uPackets.empty ())
+    {
+      SendToLteSocket (info.x2uPackets.front (), rnti, bid);
+      info.x2uPackets.pop_front ();
+    }
+  while (!info.s1uPackets.empty ())
+    {
+      SendToLteSocket (info.s1uPackets.front (), rnti, bid);
+      info.s1uPackets.pop_front ();
+    }
+
+  std::map<uint16_t, HandoverDataInfo>::iterator handoverIt = m_handoverDataMap.find (rnti);
+  NS_ASSERT (handoverIt != m_handoverDataMap.end ());
+  HandoverDataInfo& handoverData = handoverIt->second;
+  if (handoverData.sourceCellId == 0)
+    {
+      handoverData.sourceCellId = info.sourceCellId;
+    }
+  handoverData.nForwarded += nForwarded;
+  handoverData.nReceived += info.nReceived;
+  handoverData.nDropped += info.nDropped;
+  if (info.sourceLastDelivery > handoverData.sourceLastDelivery)
+    {
+      handoverData.sourceLastDelivery = info.sourceLastDelivery;
+    }
+  m_incomingForwardingMap.erase (it);
+
+  // the handover is reported when all the tunnels of the UE are done
+  const UeBearers& ue = m_rbidTeidTable[rnti];
+  for (uint8_t i = 0; i < MAX_EPS_BEARERS; ++i)
+    {
+      if ((ue.bidMask & (1 << i))
+          && m_incomingForwardingMap.find (ue.gtpu[i].GetTeid ()) != m_incomingForwardingMap.end ())
+        {
+          return;
+        }
+    }
+  Time interruption = Seconds (0);
+  if (!handoverData.sourceLastDelivery.IsStrictlyNegative ()
+      && !handoverData.firstDelivery.IsStrictlyNegative ())
+    {
+      interruption = handoverData.firstDelivery - handoverData.sourceLastDelivery;
+    }
+  uint32_t nLost = (handoverData.nForwarded > handoverData.nReceived ? handoverData.nForwarded - handoverData.nReceived : 0)
+    + handoverData.nDropped;
+  NS_LOG_INFO ("handover of RNTI " << rnti << " from cell " << handoverData.sourceCellId
+               << ": interruption " << interruption.GetSeconds () << " s, "
+               << handoverData.nForwarded << " packets forwarded, " << nLost << " lost");
+  m_handoverDataTrace (rnti, handoverData.sourceCellId, m_cellId, interruption, handoverData.nForwarded, nLost);
+  m_handoverDataMap.erase (handoverIt);
+}
+
+void 
+EpcEnbApplication::EndOutgoingForwarding (uint32_t teid)
+{
+  NS_LOG_FUNCTION (this << teid);
+  std::map<uint32_t, OutgoingForwardingInfo>::iterator it = m_outgoingForwardingMap.find (teid);
+  NS_ASSERT (it != m_outgoingForwardingMap.end ());
+  uint8_t payload[END_MARKER_PAYLOAD_SIZE];
+  uint64_t lastDelivery = (uint64_t) it->second.lastDelivery.GetNanoSeconds ();
+  for (uint32_t i = 0; i < 8; ++i)
+    {
+      payload[i] = (lastDelivery >> (56 - 8 * i)) & 0xff;
+    }
+  uint32_t nForwarded = it->second.nForwarded;
+  for (uint32_t i = 0; i < 4; ++i)
+    {
+      payload[8 + i] = (nForwarded >> (24 - 8 * i)) & 0xff;
+    }
+  Ptr<Packet> packet = Create<Packet> (payload, END_MARKER_PAYLOAD_SIZE);
+  GtpuHeaderTemplate endMarker (teid);
+  endMarker.SetMessageType (GTPU_END_MARKER);
+  endMarker.SetPayloadSize (packet->GetSize ());
+  packet->AddHeader (endMarker);
+  SendToX2uSocket (packet, it->second.targetX2Address);
+  m_outgoingForwardingMap.erase (it);
 }
 
 void 
@@ -297,21 +800,35 @@ EpcEnbApplication::SendToLteSocket (Ptr<Packet> packet, uint16_t rnti, uint8_t b
   packet->AddPacketTag (tag);
   int sentBytes = m_lteSocket->Send (packet);
   NS_ASSERT (sentBytes > 0);
+  m_rbidTeidTable[rnti].lastDelivery = Simulator::Now ();
+  if (!m_handoverDataMap.empty ())
+    {
+      std::map<uint16_t, HandoverDataInfo>::iterator it = m_handoverDataMap.find (rnti);
+      if (it != m_handoverDataMap.end () && it->second.firstDelivery.IsStrictlyNegative ())
+        {
+          it->second.firstDelivery = Simulator::Now ();
+        }
+    }
 }
 
 
 void 
-EpcEnbApplication::SendToS1uSocket (Ptr<Packet> packet, uint32_t teid)
-{
-  NS_LOG_FUNCTION (this << packet << teid);  
-  GtpuHeader gtpu;
-  gtpu.SetTeid (teid);
-  // From 3GPP TS 29.281 v10.0.0 Section 5.1
-  // Length of the payload + the non obligatory GTP-U header
-  gtpu.SetLength (packet->GetSize () + gtpu.GetSerializedSize () - 8);  
+EpcEnbApplication::SendToS1uSocket (Ptr<Packet> packet, GtpuHeaderTemplate& gtpu)
+{
+  NS_LOG_FUNCTION (this << packet << gtpu.GetTeid ());  
+  gtpu.SetPayloadSize (packet->GetSize ());
   packet->AddHeader (gtpu);
   uint32_t flags = 0;
-  m_s1uSocket->SendTo (packet, flags, InetSocketAddress(m_sgwS1uAddress, m_gtpuUdpPort));
+  m_s1uSocket->SendTo (packet, flags, m_sgwS1uSocketAddress);
+}
+
+
+void 
+EpcEnbApplication::SendToX2uSocket (Ptr<Packet> packet, Ipv4Address x2Address)
+{
+  NS_LOG_FUNCTION (this << packet << x2Address);
+  uint32_t flags = 0;
+  m_x2uSocket->SendTo (packet, flags, InetSocketAddress (x2Address, m_x2uUdpPort));
 }
 
 
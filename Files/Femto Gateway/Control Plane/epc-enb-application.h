@@ -27,6 +27,8 @@
 #include <ns3/virtual-net-device.h>
 #include <ns3/traced-callback.h>
 #include <ns3/callback.h>
+#include <ns3/nstime.h>
+#include <ns3/event-id.h>
 #include <ns3/ptr.h>
 #include <ns3/object.h>
 #include <ns3/lte-common.h>
@@ -34,7 +36,10 @@
 #include <ns3/eps-bearer.h>
 #include <ns3/epc-enb-s1-sap.h>
 #include <ns3/epc-s1ap-sap.h>
+#include <ns3/epc-gtpu-header-template.h>
 #include <map>
+#include <list>
+#include <vector>
 
 namespace ns3 {
 class EpcEnbS1SapUser;
@@ -100,7 +105,7 @@ public:
    * 
    * \param s the MME side of the S1-AP SAP 
    */
-  void SetS1apSapGW (EpcS1apSapGW * s);
+  void SetS1apSapMme (EpcS1apSapMme * s);
 
   /** 
    * 
@@ -123,6 +128,44 @@ public:
    */
   void RecvFromS1uSocket (Ptr<Socket> socket);
 
+  /** 
+   * Set the socket used to forward the downlink packets of the UEs
+   * handed over to and from the neighbour eNBs (X2-U)
+   * 
+   * \param x2uSocket the UDP socket, bound to the X2-U port
+   */
+  void SetX2uSocket (Ptr<Socket> x2uSocket);
+
+  /** 
+   * Add a neighbour eNB to which data can be forwarded over X2-U
+   * 
+   * \param cellId the cell ID of the neighbour eNB
+   * \param x2Address the X2 address of the neighbour eNB
+   */
+  void AddX2uNeighbour (uint16_t cellId, Ipv4Address x2Address);
+
+  /** 
+   * Start forwarding to the target eNB the downlink packets of a UE
+   * which is being handed over; the forwarding ends when the UE
+   * context is released. To be connected to the HandoverStart trace
+   * source of the LteEnbRrc of the eNB.
+   * 
+   * \param imsi the IMSI of the UE
+   * \param cellId the cell ID of this eNB
+   * \param rnti the RNTI of the UE in this eNB
+   * \param targetCellId the cell ID of the target eNB
+   */
+  void HandoverStart (uint64_t imsi, uint16_t cellId, uint16_t rnti, uint16_t targetCellId);
+
+  /** 
+   * Method to be assigned to the recv callback of the X2-U socket. It
+   * is called when the eNB receives a data packet forwarded by the
+   * source eNB of a UE handed over to this eNB.
+   * 
+   * \param socket pointer to the X2-U socket
+   */
+  void RecvFromX2uSocket (Ptr<Socket> socket);
+
 
   struct EpsFlowId_t
   {
@@ -166,8 +209,8 @@ private:
   void DoUeContextRelease (uint16_t rnti);
   
   // S1-AP SAP ENB methods
-  void DoInitialContextSetupRequest (uint64_t mmeUeS1Id, uint16_t enbUeS1Id, std::list<EpcS1apSapEnb::ErabToBeSetupItem> erabToBeSetupList);
-  void DoPathSwitchRequestAcknowledge (uint64_t enbUeS1Id, uint64_t mmeUeS1Id, uint16_t cgi, std::list<EpcS1apSapEnb::ErabSwitchedInUplinkItem> erabToBeSwitchedInUplinkList);
+  void DoInitialContextSetupRequest (uint64_t mmeUeS1Id, uint16_t enbUeS1Id, const EpcS1apSapEnb::ErabToBeSetupList &erabToBeSetupList);
+  void DoPathSwitchRequestAcknowledge (uint64_t enbUeS1Id, uint64_t mmeUeS1Id, uint16_t cgi, const EpcS1apSapEnb::ErabSwitchedInUplinkList &erabToBeSwitchedInUplinkList);
 
   /** 
    * Send a packet to the UE via the LTE radio interface of the eNB
@@ -182,9 +225,10 @@ private:
    * Send a packet to the SGW via the S1-U interface
    * 
    * \param packet packet to be sent
-   * \param teid the Tunnel Enpoint IDentifier
+   * \param gtpu the GTP-U header of the tunnel, whose length is set
+   * for the packet
    */
-  void SendToS1uSocket (Ptr<Packet> packet, uint32_t teid);
+  void SendToS1uSocket (Ptr<Packet> packet, GtpuHeaderTemplate& gtpu);
 
 
   
@@ -197,6 +241,48 @@ private:
    */
   void SetupS1Bearer (uint32_t teid, uint16_t rnti, uint8_t bid);
 
+  /** 
+   * Send a GTP-U packet to a neighbour eNB via the X2-U interface
+   * 
+   * \param packet the packet, GTP-U header included
+   * \param x2Address the X2 address of the neighbour eNB
+   */
+  void SendToX2uSocket (Ptr<Packet> packet, Ipv4Address x2Address);
+
+  /** 
+   * Start holding the packets of a tunnel handed over to this eNB,
+   * until the end marker of the source eNB or DataForwardingTimeout
+   * 
+   * \param teid the TEID of the tunnel
+   * \param sourceCellId the cell ID of the source eNB, 0 if not known yet
+   */
+  void AddIncomingForwarding (uint32_t teid, uint16_t sourceCellId);
+
+  /** 
+   * Deliver to the UE the packets held for a tunnel whose data is
+   * forwarded to this eNB, and end the forwarding if the source eNB
+   * has sent its end marker
+   * 
+   * \param teid the TEID of the tunnel
+   */
+  void FlushIncomingForwarding (uint32_t teid);
+
+  /** 
+   * End the forwarding of a tunnel to this eNB, at the latest
+   * DataForwardingTimeout after it was added
+   * 
+   * \param teid the TEID of the tunnel
+   */
+  void EndIncomingForwarding (uint32_t teid);
+
+  /** 
+   * Send to the target eNB the end marker of a tunnel whose data is
+   * forwarded, and stop the forwarding
+   * 
+   * \param teid the TEID of the tunnel
+   */
+  void EndOutgoingForwarding (uint32_t teid);
+
   
 
   /**
@@ -205,22 +291,100 @@ private:
   Ipv4Address m_sgwS1uAddress;
 
   /**
-   * map of maps telling for each RNTI and BID the corresponding  S1-U TEID
+   * maximum number of EPS bearers of a UE; the EPS Bearer IDs of the
+   * data radio bearers go from 1 to 11
+   */
+  static const uint8_t MAX_EPS_BEARERS = 11;
+
+  /**
+   * S1-U tunnels of the bearers of a UE
+   */
+  struct UeBearers
+  {
+    uint16_t bidMask;                           ///< bit (BID - 1) is set if the bearer exists
+    GtpuHeaderTemplate gtpu[MAX_EPS_BEARERS];   ///< GTP-U header of the tunnel, indexed by BID - 1
+    Time lastDelivery;                          ///< last time a packet was sent to the UE
+  };
+
+  /**
+   * table telling for each RNTI and BID the corresponding S1-U tunnel,
+   * indexed by RNTI
    * 
    */
-  std::map<uint16_t, std::map<uint8_t, uint32_t> > m_rbidTeidMap;  
+  std::vector<UeBearers> m_rbidTeidTable;
 
   /**
-   * map telling for each S1-U TEID the corresponding RNTI,BID
+   * entry of the TEID table
+   */
+  struct TeidEntry
+  {
+    uint32_t teid;
+    EpsFlowId_t rbid;
+    bool used;
+  };
+
+  /**
+   * table telling for each S1-U TEID the corresponding RNTI,BID. It is
+   * an open addressing hash table with linear probing, whose size is a
+   * power of two and which is kept at most half full.
+   * 
+   */
+  std::vector<TeidEntry> m_teidRbidTable;
+
+  /**
+   * number of TEIDs in m_teidRbidTable
+   */
+  uint32_t m_nTeids;
+
+  /**
+   * log2 of the size of m_teidRbidTable
+   */
+  uint8_t m_teidRbidTableBits;
+
+  /** 
+   * \param teid an S1-U TEID
+   * \return the home slot of teid in m_teidRbidTable
+   */
+  uint32_t HashTeid (uint32_t teid) const;
+
+  /** 
+   * \param teid an S1-U TEID
+   * \return the index of teid in m_teidRbidTable if it is there,
+   * otherwise the index where it would be inserted
+   */
+  uint32_t FindTeidIndex (uint32_t teid) const;
+
+  /** 
+   * \param teid an S1-U TEID
+   * \return the RNTI,BID of the TEID, or 0 if the TEID is unknown
+   */
+  const EpsFlowId_t* FindTeid (uint32_t teid) const;
+
+  /** 
+   * add a TEID to m_teidRbidTable, or change the RNTI,BID of an existing TEID
    * 
+   * \param teid 
+   * \param rbid 
+   */
+  void AddTeid (uint32_t teid, EpsFlowId_t rbid);
+
+  /** 
+   * remove a TEID from m_teidRbidTable, if it is there
+   * 
+   * \param teid 
    */
-  std::map<uint32_t, EpsFlowId_t> m_teidRbidMap;
+  void RemoveTeid (uint32_t teid);
  
   /**
    * UDP port to be used for GTP
    */
   uint16_t m_gtpuUdpPort;
 
+  /**
+   * socket address of the SGW, built once for all the uplink packets
+   */
+  Address m_sgwS1uSocketAddress;
+
   /**
    * Provider for the S1 SAP 
    */
@@ -237,8 +401,6 @@ private:
    */
   EpcS1apSapMme* m_s1apSapMme;
 
-//EpcS1apSapGW* m_s1apSapGW;
-
   /**
    * UE context info
    * 
@@ -247,6 +409,108 @@ private:
 
   uint16_t m_cellId;
 
+  /**
+   * UDP socket to send and receive the forwarded GTP-U packets to and
+   * from the neighbour eNBs
+   */
+  Ptr<Socket> m_x2uSocket;
+
+  /**
+   * UDP port of the X2-U data forwarding. It is not the GTP-U port,
+   * which the EpcX2 entity already binds on the X2 addresses.
+   */
+  uint16_t m_x2uUdpPort;
+
+  /**
+   * X2 address of the neighbour eNBs, by cell ID, and the other way round
+   */
+  std::map<uint16_t, Ipv4Address> m_x2uNeighbourAddressMap;
+  std::map<Ipv4Address, uint16_t> m_x2uNeighbourCellIdMap;
+
+  bool m_dataForwarding;
+  Time m_dataForwardingTimeout;
+
+  /**
+   * tunnel of a UE leaving this eNB, whose downlink packets are
+   * forwarded to the target eNB
+   */
+  struct OutgoingForwardingInfo
+  {
+    uint16_t rnti;
+    Ipv4Address targetX2Address;
+    uint32_t nForwarded;
+    Time lastDelivery;   ///< last time a packet of the UE was sent to the radio interface of this eNB
+  };
+
+  /**
+   * outgoing forwarding, by TEID
+   */
+  std::map<uint32_t, OutgoingForwardingInfo> m_outgoingForwardingMap;
+
+  /**
+   * tunnel of a UE arriving at this eNB, whose downlink packets are
+   * forwarded by the source eNB. The forwarded packets are held until
+   * the UE is connected, and from the Path Switch Request on the packets
+   * coming from the SGW are held until the end marker of the source
+   * eNB, so that they are delivered in order.
+   */
+  struct IncomingForwardingInfo
+  {
+    uint16_t sourceCellId;
+    std::list<Ptr<Packet> > x2uPackets;
+    std::list<Ptr<Packet> > s1uPackets;
+    uint32_t nReceived;
+    uint32_t nDropped;
+    bool endMarker;
+    uint32_t nForwarded;       ///< as counted by the source eNB, valid with the end marker
+    Time sourceLastDelivery;   ///< valid with the end marker
+    EventId timeout;
+  };
+
+  /**
+   * incoming forwarding, by TEID
+   */
+  std::map<uint32_t, IncomingForwardingInfo> m_incomingForwardingMap;
+
+  /**
+   * data of a handover to this eNB, summed over the tunnels of the UE
+   */
+  struct HandoverDataInfo
+  {
+    uint16_t sourceCellId;
+    uint32_t nForwarded;
+    uint32_t nReceived;
+    uint32_t nDropped;
+    Time sourceLastDelivery;
+    Time firstDelivery;
+  };
+
+  /**
+   * handovers to this eNB whose forwarding is in progress, by RNTI
+   */
+  std::map<uint16_t, HandoverDataInfo> m_handoverDataMap;
+
+  /**
+   * The `HandoverData` trace source, fired by the target eNB at the end
+   * of the data forwarding of every handover, even if the source eNB
+   * forwarded no packet. Exporting the RNTI of the UE
+   * in the target eNB, the source and target cell IDs, the interruption
+   * of the downlink (from the last packet sent to the UE by the source
+   * eNB to the first one sent by the target eNB, 0 if unknown), the
+   * number of packets forwarded by the source eNB and the number of
+   * packets lost (on the X2 link or dropped by the target eNB).
+   */
+  TracedCallback<uint16_t, uint16_t, uint16_t, Time, uint32_t, uint32_t> m_handoverDataTrace;
+
+  /**
+   * The `PathSwitchRequest` and `PathSwitchRequestAcknowledge` trace
+   * sources, fired when the Path Switch Request of a UE handed over to
+   * this eNB is sent to the MME and when its acknowledge is received.
+   * Exporting the IMSI, the cell ID and the RNTI of the UE.
+   */
+  TracedCallback<uint64_t, uint16_t, uint16_t> m_pathSwitchRequestTrace;
+  TracedCallback<uint64_t, uint16_t, uint16_t> m_pathSwitchRequestAckTrace;
+
 };
 
 } //namespace ns3
@@ -0,0 +1,263 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+// Measures the packets per second forwarded by the EpcEnbApplication
+// between the radio interface and the S1-U interface, in both
+// directions, with nUes UEs of nBearersPerUe bearers each. The radio
+// interface and the S1-U link are SimpleNetDevices without delay, the
+// RRC and the MME are stubs, so that mostly the forwarding path of the
+// eNB is measured. With direct=true the GTP-U packets are handed
+// directly between the S1-U sockets, as with EpcHelper::S1uDirect.
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include <ns3/epc-enb-application.h>
+#include <ns3/epc-enb-s1-sap.h>
+#include <ns3/epc-s1ap-sap.h>
+#include <ns3/epc-benchmark-stubs.h>
+#include <ns3/epc-s1u-direct-socket.h>
+#include <ns3/epc-gtpu-header.h>
+#include <ns3/eps-bearer-tag.h>
+#include <ns3/system-wall-clock-ms.h>
+
+using namespace ns3;
+
+class BenchmarkRrc : public EpcEnbS1SapUser
+{
+public:
+  virtual void DataRadioBearerSetupRequest (DataRadioBearerSetupRequestParameters params)
+  {
+  }
+  virtual void PathSwitchRequestAcknowledge (PathSwitchRequestAcknowledgeParameters params)
+  {
+  }
+};
+
+static uint64_t g_nUplinkPackets = 0;
+static uint64_t g_nDownlinkPackets = 0;
+
+void
+SgwReceive (Ptr<Socket> socket)
+{
+  while (socket->Recv ())
+    {
+      ++g_nUplinkPackets;
+    }
+}
+
+void
+UeReceive (Ptr<NetDevice> device, Ptr<const Packet> packet, uint16_t protocol,
+           const Address &from, const Address &to, NetDevice::PacketType packetType)
+{
+  ++g_nDownlinkPackets;
+}
+
+/**
+ * Send one uplink packet on every bearer of every UE, and schedule the
+ * next burst
+ */
+void
+SendUplinkBurst (Ptr<NetDevice> ueDevice, Address enbRadioAddress, uint32_t nUes, uint32_t nBearersPerUe,
+                 uint32_t packetSize, uint32_t nBurstsLeft)
+{
+  for (uint32_t rnti = 1; rnti <= nUes; ++rnti)
+    {
+      for (uint32_t bid = 1; bid <= nBearersPerUe; ++bid)
+        {
+          Ptr<Packet> packet = Create<Packet> (packetSize);
+          EpsBearerTag tag (rnti, bid);
+          packet->AddPacketTag (tag);
+          ueDevice->Send (packet, enbRadioAddress, Ipv4L3Protocol::PROT_NUMBER);
+        }
+    }
+  if (--nBurstsLeft > 0)
+    {
+      Simulator::Schedule (MicroSeconds (1), &SendUplinkBurst, ueDevice, enbRadioAddress, nUes, nBearersPerUe, packetSize, nBurstsLeft);
+    }
+}
+
+/**
+ * Send one downlink GTP-U packet on every tunnel, and schedule the
+ * next burst
+ */
+void
+SendDownlinkBurst (Ptr<Socket> sgwSocket, Ipv4Address enbAddress, uint32_t nTeids,
+                   uint32_t packetSize, uint32_t nBurstsLeft)
+{
+  for (uint32_t teid = 1; teid <= nTeids; ++teid)
+    {
+      Ptr<Packet> packet = Create<Packet> (packetSize);
+      GtpuHeader gtpu;
+      gtpu.SetTeid (teid);
+      gtpu.SetLength (packet->GetSize () + gtpu.GetSerializedSize () - 8);
+      packet->AddHeader (gtpu);
+      sgwSocket->SendTo (packet, 0, InetSocketAddress (enbAddress, 2152));
+    }
+  if (--nBurstsLeft > 0)
+    {
+      Simulator::Schedule (MicroSeconds (1), &SendDownlinkBurst, sgwSocket, enbAddress, nTeids, packetSize, nBurstsLeft);
+    }
+}
+
+int main (int argc, char *argv[])
+{
+  uint32_t nUes = 1000;
+  uint32_t nBearersPerUe = 4;
+  uint32_t nBursts = 100;
+  uint32_t packetSize = 100;
+  bool direct = false;
+  CommandLine cmd;
+  cmd.AddValue ("nUes", "Number of UEs served by the eNB", nUes);
+  cmd.AddValue ("nBearersPerUe", "Number of EPS bearers of each UE (at most 11)", nBearersPerUe);
+  cmd.AddValue ("nBursts", "Number of packets sent on each bearer in each direction", nBursts);
+  cmd.AddValue ("packetSize", "Size of the user packets [bytes]", packetSize);
+  cmd.AddValue ("direct", "Skip UDP/IP between the eNB and the SGW", direct);
+  cmd.Parse (argc, argv);
+  NS_ABORT_MSG_IF (nUes < 1 || nUes > 65535, "nUes must be between 1 and 65535");
+  NS_ABORT_MSG_IF (nBearersPerUe < 1 || nBearersPerUe > 11, "nBearersPerUe must be between 1 and 11");
+
+  NodeContainer nodes;
+  nodes.Create (3);
+  Ptr<Node> ue = nodes.Get (0);
+  Ptr<Node> enb = nodes.Get (1);
+  Ptr<Node> sgw = nodes.Get (2);
+
+  // radio interface: all the UEs share a single device
+  Ptr<SimpleChannel> radioChannel = CreateObject<SimpleChannel> ();
+  Ptr<SimpleNetDevice> ueDevice = CreateObject<SimpleNetDevice> ();
+  ueDevice->SetAddress (Mac48Address::Allocate ());
+  ueDevice->SetChannel (radioChannel);
+  ue->AddDevice (ueDevice);
+  ue->RegisterProtocolHandler (MakeCallback (&UeReceive), 0, ueDevice);
+  Ptr<SimpleNetDevice> enbRadioDevice = CreateObject<SimpleNetDevice> ();
+  enbRadioDevice->SetAddress (Mac48Address::Allocate ());
+  enbRadioDevice->SetChannel (radioChannel);
+  enb->AddDevice (enbRadioDevice);
+
+  // S1-U link
+  InternetStackHelper internet;
+  internet.Install (enb);
+  internet.Install (sgw);
+  Ptr<SimpleChannel> s1uChannel = CreateObject<SimpleChannel> ();
+  NetDeviceContainer s1uDevices;
+  for (uint32_t i = 1; i <= 2; ++i)
+    {
+      Ptr<SimpleNetDevice> device = CreateObject<SimpleNetDevice> ();
+      device->SetAddress (Mac48Address::Allocate ());
+      device->SetChannel (s1uChannel);
+      nodes.Get (i)->AddDevice (device);
+      s1uDevices.Add (device);
+    }
+  Ipv4AddressHelper s1uAddressHelper;
+  s1uAddressHelper.SetBase ("10.0.0.0", "255.255.255.252");
+  Ipv4InterfaceContainer s1uInterfaces = s1uAddressHelper.Assign (s1uDevices);
+  Ipv4Address enbAddress = s1uInterfaces.GetAddress (0);
+  Ipv4Address sgwAddress = s1uInterfaces.GetAddress (1);
+
+  Ptr<Socket> sgwSocket = Socket::CreateSocket (sgw, TypeId::LookupByName ("ns3::UdpSocketFactory"));
+  NS_ABORT_IF (sgwSocket->Bind (InetSocketAddress (sgwAddress, 2152)) != 0);
+
+  // eNB sockets, as created by the EpcHelper
+  Ptr<Socket> enbS1uSocket = Socket::CreateSocket (enb, TypeId::LookupByName ("ns3::UdpSocketFactory"));
+  NS_ABORT_IF (enbS1uSocket->Bind (InetSocketAddress (enbAddress, 2152)) != 0);
+  if (direct)
+    {
+      Ptr<EpcS1uDirectSocket> sgwDirectSocket = CreateObject<EpcS1uDirectSocket> (sgwSocket);
+      Ptr<EpcS1uDirectSocket> enbDirectSocket = CreateObject<EpcS1uDirectSocket> (enbS1uSocket);
+      EpcS1uDirectSocket::Link (enbDirectSocket, enbAddress, sgwDirectSocket, sgwAddress, Seconds (0));
+      sgwSocket = sgwDirectSocket;
+      enbS1uSocket = enbDirectSocket;
+    }
+  sgwSocket->SetRecvCallback (MakeCallback (&SgwReceive));
+  PacketSocketHelper packetSocket;
+  packetSocket.Install (enb);
+  Ptr<Socket> enbLteSocket = Socket::CreateSocket (enb, TypeId::LookupByName ("ns3::PacketSocketFactory"));
+  PacketSocketAddress enbLteSocketBindAddress;
+  enbLteSocketBindAddress.SetSingleDevice (enbRadioDevice->GetIfIndex ());
+  enbLteSocketBindAddress.SetProtocol (Ipv4L3Protocol::PROT_NUMBER);
+  NS_ABORT_IF (enbLteSocket->Bind (enbLteSocketBindAddress) != 0);
+  PacketSocketAddress enbLteSocketConnectAddress;
+  enbLteSocketConnectAddress.SetPhysicalAddress (Mac48Address::GetBroadcast ());
+  enbLteSocketConnectAddress.SetSingleDevice (enbRadioDevice->GetIfIndex ());
+  enbLteSocketConnectAddress.SetProtocol (Ipv4L3Protocol::PROT_NUMBER);
+  NS_ABORT_IF (enbLteSocket->Connect (enbLteSocketConnectAddress) != 0);
+
+  Ptr<EpcEnbApplication> enbApp = CreateObject<EpcEnbApplication> (enbLteSocket, enbS1uSocket, enbAddress, sgwAddress, 1);
+  enb->AddApplication (enbApp);
+  BenchmarkRrc rrc;
+  BenchmarkMme mme;
+  enbApp->SetS1SapUser (&rrc);
+  enbApp->SetS1apSapMme (&mme);
+
+  // set up the bearers: the TEID of bearer b of the UE of RNTI r is
+  // (r - 1) * nBearersPerUe + b, as the SGW would allocate them
+  SystemWallClockMs clock;
+  clock.Start ();
+  for (uint32_t rnti = 1; rnti <= nUes; ++rnti)
+    {
+      uint64_t imsi = rnti;
+      enbApp->GetS1SapProvider ()->InitialUeMessage (imsi, rnti);
+      EpcS1apSapEnb::ErabToBeSetupList erabToBeSetupList;
+      for (uint32_t bid = 1; bid <= nBearersPerUe; ++bid)
+        {
+          EpcS1apSapEnb::ErabToBeSetupItem erab;
+          erab.erabId = bid;
+          erab.erabLevelQosParameters = EpsBearer (EpsBearer::NGBR_VIDEO_TCP_DEFAULT);
+          erab.transportLayerAddress = sgwAddress;
+          erab.sgwTeid = (rnti - 1) * nBearersPerUe + bid;
+          erabToBeSetupList.push_back (erab);
+        }
+      enbApp->GetS1apSapEnb ()->InitialContextSetupRequest (imsi, rnti, erabToBeSetupList);
+    }
+  int64_t setupMs = clock.End ();
+
+  uint32_t nTeids = nUes * nBearersPerUe;
+  uint64_t nPackets = (uint64_t) nTeids * nBursts;
+
+  Simulator::Schedule (Seconds (0), &SendUplinkBurst, ueDevice, enbRadioDevice->GetAddress (),
+                       nUes, nBearersPerUe, packetSize, nBursts);
+  clock.Start ();
+  Simulator::Run ();
+  int64_t uplinkMs = clock.End ();
+
+  Simulator::Schedule (Seconds (0), &SendDownlinkBurst, sgwSocket, enbAddress, nTeids, packetSize, nBursts);
+  clock.Start ();
+  Simulator::Run ();
+  int64_t downlinkMs = clock.End ();
+
+  NS_ABORT_MSG_IF (g_nUplinkPackets != nPackets, "lost uplink packets: " << nPackets - g_nUplinkPackets);
+  NS_ABORT_MSG_IF (g_nDownlinkPackets != nPackets, "lost downlink packets: " << nPackets - g_nDownlinkPackets);
+  std::cout << "UEs: " << nUes << ", bearers per UE: " << nBearersPerUe
+            << (direct ? ", direct S1-U" : "") << std::endl;
+  std::cout << "bearer setup time [ms]: " << setupMs << std::endl;
+  std::cout << "packets per direction: " << nPackets << std::endl;
+  std::cout << "uplink time [ms]: " << uplinkMs << std::endl;
+  std::cout << "uplink packets per second: "
+            << (uplinkMs > 0 ? nPackets * 1000.0 / uplinkMs : 0) << std::endl;
+  std::cout << "downlink time [ms]: " << downlinkMs << std::endl;
+  std::cout << "downlink packets per second: "
+            << (downlinkMs > 0 ? nPackets * 1000.0 / downlinkMs : 0) << std::endl;
+
+  if (direct)
+    {
+      // break the links between the two sockets
+      sgwSocket->Dispose ();
+    }
+  Simulator::Destroy ();
+  return 0;
+}
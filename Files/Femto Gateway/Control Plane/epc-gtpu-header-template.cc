@@ -0,0 +1,117 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#include "epc-gtpu-header-template.h"
+#include "epc-gtpu-header.h"
+#include "ns3/assert.h"
+#include "ns3/buffer.h"
+
+namespace ns3 {
+
+TypeId
+GtpuHeaderTemplate::GetInstanceTypeId (void) const
+{
+  return GtpuHeader::GetTypeId ();
+}
+
+GtpuHeaderTemplate::GtpuHeaderTemplate ()
+{
+  for (uint32_t i = 0; i < SERIALIZED_SIZE; ++i)
+    {
+      m_bytes[i] = 0;
+    }
+}
+
+GtpuHeaderTemplate::GtpuHeaderTemplate (uint32_t teid)
+{
+  GtpuHeader gtpu;
+  gtpu.SetTeid (teid);
+  NS_ASSERT (gtpu.GetSerializedSize () == SERIALIZED_SIZE);
+  Buffer buffer;
+  buffer.AddAtStart (SERIALIZED_SIZE);
+  gtpu.Serialize (buffer.Begin ());
+  buffer.Begin ().Read (m_bytes, SERIALIZED_SIZE);
+}
+
+GtpuHeaderTemplate::~GtpuHeaderTemplate ()
+{
+}
+
+uint32_t
+GtpuHeaderTemplate::GetTeid () const
+{
+  return ((uint32_t) m_bytes[4] << 24) | ((uint32_t) m_bytes[5] << 16) | ((uint32_t) m_bytes[6] << 8) | m_bytes[7];
+}
+
+void
+GtpuHeaderTemplate::SetTeid (uint32_t teid)
+{
+  m_bytes[4] = (teid >> 24) & 0xff;
+  m_bytes[5] = (teid >> 16) & 0xff;
+  m_bytes[6] = (teid >> 8) & 0xff;
+  m_bytes[7] = teid & 0xff;
+}
+
+uint8_t
+GtpuHeaderTemplate::GetMessageType () const
+{
+  return m_bytes[1];
+}
+
+void
+GtpuHeaderTemplate::SetMessageType (uint8_t messageType)
+{
+  m_bytes[1] = messageType;
+}
+
+void
+GtpuHeaderTemplate::SetPayloadSize (uint32_t payloadSize)
+{
+  // From 3GPP TS 29.281 v10.0.0 Section 5.1
+  // Length of the payload + the non obligatory GTP-U header
+  uint16_t length = payloadSize + SERIALIZED_SIZE - 8;
+  m_bytes[2] = (length >> 8) & 0xff;
+  m_bytes[3] = length & 0xff;
+}
+
+uint32_t
+GtpuHeaderTemplate::GetSerializedSize (void) const
+{
+  return SERIALIZED_SIZE;
+}
+
+void
+GtpuHeaderTemplate::Serialize (Buffer::Iterator start) const
+{
+  start.Write (m_bytes, SERIALIZED_SIZE);
+}
+
+uint32_t
+GtpuHeaderTemplate::Deserialize (Buffer::Iterator start)
+{
+  start.Read (m_bytes, SERIALIZED_SIZE);
+  return SERIALIZED_SIZE;
+}
+
+void
+GtpuHeaderTemplate::Print (std::ostream &os) const
+{
+  os << " messageType=" << (uint32_t) m_bytes[1]
+     << " length=" << ((m_bytes[2] << 8) | m_bytes[3])
+     << " teid=" << GetTeid ();
+}
+
+} // namespace ns3
@@ -0,0 +1,83 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#ifndef EPC_GTPU_HEADER_TEMPLATE_H
+#define EPC_GTPU_HEADER_TEMPLATE_H
+
+#include <ns3/header.h>
+
+namespace ns3 {
+
+/**
+ * \ingroup lte
+ *
+ * Pre-serialized GTP-U header. It has the same wire format as the
+ * GtpuHeader, but it keeps the header as bytes: serializing it is a
+ * single copy, and only the message type, the length and the TEID can
+ * be changed. In the packet metadata it is recorded as a GtpuHeader, so
+ * that a GTP-U header added as a template can be removed as a
+ * GtpuHeader and the other way round.
+ */
+class GtpuHeaderTemplate : public Header
+{
+public:
+  virtual TypeId GetInstanceTypeId (void) const;
+
+  /**
+   * Build the header of TEID 0
+   */
+  GtpuHeaderTemplate ();
+
+  /**
+   * Build the header of a tunnel, with the same fields as a
+   * GtpuHeader of the same TEID
+   *
+   * \param teid the Tunnel Endpoint IDentifier
+   */
+  GtpuHeaderTemplate (uint32_t teid);
+
+  virtual ~GtpuHeaderTemplate ();
+
+  uint32_t GetTeid () const;
+  void SetTeid (uint32_t teid);
+  uint8_t GetMessageType () const;
+  void SetMessageType (uint8_t messageType);
+
+  /**
+   * Set the length field for a given payload
+   *
+   * \param payloadSize the size of the packet which the header is added to
+   */
+  void SetPayloadSize (uint32_t payloadSize);
+
+  virtual uint32_t GetSerializedSize (void) const;
+  virtual void Serialize (Buffer::Iterator start) const;
+  virtual uint32_t Deserialize (Buffer::Iterator start);
+  virtual void Print (std::ostream &os) const;
+
+  /**
+   * size of a GTP-U header with the sequence number, N-PDU number and
+   * next extension header type fields, as serialized by the GtpuHeader
+   */
+  static const uint32_t SERIALIZED_SIZE = 12;
+
+private:
+  uint8_t m_bytes[SERIALIZED_SIZE];
+};
+
+} // namespace ns3
+
+#endif // EPC_GTPU_HEADER_TEMPLATE_H
@@ -23,6 +23,7 @@
 #include <ns3/epc-helper.h>
 #include <ns3/log.h>
 #include <ns3/inet-socket-address.h>
+#include <ns3/boolean.h>
 #include <ns3/mac48-address.h>
 #include <ns3/eps-bearer.h>
 #include <ns3/ipv4-address.h>
@@ -38,6 +39,11 @@
 #include <ns3/lte-enb-net-device.h>
 #include <ns3/lte-ue-net-device.h>
 #include <ns3/epc-mme.h>
+#include <ns3/FemtoGW.h>
+#include <ns3/epc-femto-gw-application.h>
+#include <ns3/epc-s1u-direct-socket.h>
+#include <ns3/epc-s1ap-transport.h>
+#include <ns3/handover-latency-stats.h>
 #include <ns3/epc-ue-nas.h>
 #include "ns3/ipv4-global-routing-helper.h" /*added*/
 
@@ -49,7 +55,10 @@ NS_OBJECT_ENSURE_REGISTERED (EpcHelper);
 
 
 EpcHelper::EpcHelper () 
-  : m_gtpuUdpPort (2152)  // fixed by the standard
+  : m_gtpuUdpPort (2152),  // fixed by the standard
+    m_x2uUdpPort (2153),
+    m_s1apUdpPort (36412),  // the SCTP port of S1-AP, fixed by the standard
+    m_femtoGwBackhaulInstalled (false)
 {
   NS_LOG_FUNCTION (this);
 
@@ -57,7 +66,9 @@ EpcHelper::EpcHelper ()
   // we use a /30 subnet which can hold exactly two addresses 
   // (remember that net broadcast and null address are not valid)
   m_s1uIpv4AddressHelper.SetBase ("10.0.0.0", "255.255.255.240");
-  //m_s1u_femtogw_Ipv4AddressHelper.SetBase("9.0.0.0", "255.255.255.252"); /*added*/
+  // one /30 subnet per HeNB access link, out of a /8 of its own, so
+  // that thousands of HeNBs do not exhaust the S1-U address space
+  m_s1u_femtogw_Ipv4AddressHelper.SetBase ("9.0.0.0", "255.255.255.252");
   m_x2Ipv4AddressHelper.SetBase ("12.0.0.0", "255.255.255.252");
 
   // we use a /8 net for all UEs
@@ -65,43 +76,36 @@ EpcHelper::EpcHelper ()
   
   // create SgwPgwNode
   m_sgwPgw = CreateObject<Node> ();
+  m_sgwPgw->SetRole (Node::GATEWAY);
   m_sgwPgw2 = CreateObject<Node> ();
-  m_sgwPgw3 = CreateObject<Node> ();
+  m_sgwPgw2->SetRole (Node::GATEWAY);
   InternetStackHelper internet;
   internet.Install (m_sgwPgw);
   internet.Install (m_sgwPgw2);
-  internet.Install (m_sgwPgw3);
   
   // create S1-U socket
   Ptr<Socket> sgwPgwS1uSocket = Socket::CreateSocket (m_sgwPgw, TypeId::LookupByName ("ns3::UdpSocketFactory"));
   int retval = sgwPgwS1uSocket->Bind (InetSocketAddress (Ipv4Address::GetAny (), m_gtpuUdpPort));
   Ptr<Socket> sgwPgwS1uSocket2 = Socket::CreateSocket (m_sgwPgw2, TypeId::LookupByName ("ns3::UdpSocketFactory"));
-  //int retval2 =// sgwPgwS1uSocket2->Bind (InetSocketAddress (Ipv4Address::GetAny (), m_gtpuUdpPort));
-  Ptr<Socket> sgwPgwS1uSocket3 = Socket::CreateSocket (m_sgwPgw3, TypeId::LookupByName ("ns3::UdpSocketFactory"));
-  //int retval3 =// sgwPgwS1uSocket3->Bind (InetSocketAddress (Ipv4Address::GetAny (), m_gtpuUdpPort));
+  int retval2 = sgwPgwS1uSocket2->Bind (InetSocketAddress (Ipv4Address::GetAny (), m_gtpuUdpPort));
+  NS_ASSERT (retval2 == 0);
   NS_ASSERT (retval == 0);
+  // the GTP-U packets towards the endpoints linked to these sockets
+  // skip the UDP/IP stack, see the S1uDirect attribute
+  m_sgwPgwS1uSocket = CreateObject<EpcS1uDirectSocket> (sgwPgwS1uSocket);
+  m_femtoGwS1uSocket = CreateObject<EpcS1uDirectSocket> (sgwPgwS1uSocket2);
 
   // create TUN device implementing tunneling of user data over GTP-U/UDP/IP 
   m_tunDevice = CreateObject<VirtualNetDevice> ();
-  m_tunDevice2 = CreateObject<VirtualNetDevice> ();
-  m_tunDevice3 = CreateObject<VirtualNetDevice> ();
   // allow jumbo packets
   m_tunDevice->SetAttribute ("Mtu", UintegerValue (30000));
-  m_tunDevice2->SetAttribute ("Mtu", UintegerValue (30000));
-  m_tunDevice3->SetAttribute ("Mtu", UintegerValue (30000));
 
   // yes we need this
   m_tunDevice->SetAddress (Mac48Address::Allocate ());
-  m_tunDevice2->SetAddress (Mac48Address::Allocate ());
-  m_tunDevice3->SetAddress (Mac48Address::Allocate ()); 
 
   m_sgwPgw->AddDevice (m_tunDevice);
-  m_sgwPgw2->AddDevice (m_tunDevice2);
-  m_sgwPgw3->AddDevice (m_tunDevice3);
   NetDeviceContainer tunDeviceContainer;
   tunDeviceContainer.Add (m_tunDevice);
-  tunDeviceContainer.Add (m_tunDevice2);
-  tunDeviceContainer.Add (m_tunDevice3);
   
   // the TUN device is on the same subnet as the UEs, so when a packet
   // addressed to an UE arrives at the intenet to the WAN interface of
@@ -109,20 +113,28 @@ EpcHelper::EpcHelper ()
   Ipv4InterfaceContainer tunDeviceIpv4IfContainer = m_ueAddressHelper.Assign (tunDeviceContainer.Get(0));  
 
   // create EpcSgwPgwApplication
-  m_sgwPgwApp = CreateObject<EpcSgwPgwApplication> (m_tunDevice, sgwPgwS1uSocket);
+  m_sgwPgwApp = CreateObject<EpcSgwPgwApplication> (m_tunDevice, m_sgwPgwS1uSocket);
   m_sgwPgw->AddApplication (m_sgwPgwApp);
-  /*m_sgwPgwApp2 = CreateObject<EpcSgwPgwApplication> (m_tunDevice2, sgwPgwS1uSocket);
-  m_sgwPgw2->AddApplication (m_sgwPgwApp2);
-  m_sgwPgwApp3 = CreateObject<EpcSgwPgwApplication> (m_tunDevice3, sgwPgwS1uSocket);
-  m_sgwPgw3->AddApplication (m_sgwPgwApp3);
-  */
   // connect SgwPgwApplication and virtual net device for tunneling
   m_tunDevice->SetSendCallback (MakeCallback (&EpcSgwPgwApplication::RecvFromTunDevice, m_sgwPgwApp));
 
   // Create MME and connect with SGW via S11 interface
   m_mme = CreateObject<EpcMme> ();
   m_mme->SetS11SapSgw (m_sgwPgwApp->GetS11SapSgw ());
-  m_sgwPgwApp->SetS11SapMme (m_mme->GetS11SapMme ());
+
+  // Create the femto gateway between the HeNBs and the MME; it is on
+  // the path of the S11 responses of the SGW, which it relays to the MME
+  m_femtoGw = CreateObject<FemtoGW> ();
+  m_femtoGw->SetS1apSapMme (m_mme->GetS1apSapMme ());
+  m_femtoGw->SetS11SapSgw (m_sgwPgwApp->GetS11SapSgw ());
+  m_femtoGw->SetS11SapMme (m_mme->GetS11SapMme ());
+  m_sgwPgwApp->SetS11SapMme (m_femtoGw->GetS11SapMme ());
+
+  // the femto gateway relays the GTP-U packets of the HeNBs, so that it
+  // can switch their tunnels without involving the SGW
+  m_femtoGwApp = CreateObject<EpcFemtoGwApplication> (m_femtoGwS1uSocket);
+  m_sgwPgw2->AddApplication (m_femtoGwApp);
+  m_femtoGw->SetFemtoGwApplication (m_femtoGwApp);
 }
 
 EpcHelper::~EpcHelper ()
@@ -151,6 +163,34 @@ EpcHelper::GetTypeId (void)
                    UintegerValue (2000),
                    MakeUintegerAccessor (&EpcHelper::m_s1uLinkMtu),
                    MakeUintegerChecker<uint16_t> ())
+    .AddAttribute ("S1uDirect",
+                   "If true, the GTP-U packets of the next S1-U links to be created are handed "
+                   "directly from the S1-U socket of one end to the S1-U socket of the other end "
+                   "after the delay of the link, skipping UDP, IP and the point-to-point link, "
+                   "whose data rate and MTU are then ignored. The links and their addresses are "
+                   "created anyway.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&EpcHelper::m_s1uDirect),
+                   MakeBooleanChecker ())
+    .AddAttribute ("S1apSerialized",
+                   "If true, the S1-AP messages are serialized and sent over UDP on the S1 links, "
+                   "between the eNBs and the SGW/PGW node, where the MME is, and between the HeNBs, "
+                   "the femto gateway and the SGW/PGW node, instead of being direct calls which take "
+                   "no time. Each of these nodes then has an EpcS1apTransport aggregated, which counts "
+                   "the S1-AP messages and bytes. To be set before the first eNB is added.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&EpcHelper::m_s1apSerialized),
+                   MakeBooleanChecker ())
+    .AddAttribute ("FemtoGwBackhaulLinkDataRate",
+                   "The data rate of the link between the femto gateway and the SGW, shared by all the HeNBs",
+                   DataRateValue (DataRate ("10Gb/s")),
+                   MakeDataRateAccessor (&EpcHelper::m_femtoGwBackhaulLinkDataRate),
+                   MakeDataRateChecker ())
+    .AddAttribute ("FemtoGwBackhaulLinkDelay",
+                   "The delay of the link between the femto gateway and the SGW",
+                   TimeValue (Seconds (0)),
+                   MakeTimeAccessor (&EpcHelper::m_femtoGwBackhaulLinkDelay),
+                   MakeTimeChecker ())
     .AddAttribute ("X2LinkDataRate",
                    "The data rate to be used for the next X2 link to be created",
                    DataRateValue (DataRate ("10Gb/s")),
@@ -179,7 +219,16 @@ EpcHelper::DoDispose ()
   m_sgwPgwApp = 0;  
   m_sgwPgw->Dispose ();
   m_sgwPgw2->Dispose ();
-  m_sgwPgw3->Dispose ();
+  m_femtoGw->Dispose ();
+  m_femtoGw = 0;
+  m_femtoGwApp = 0;
+  m_sgwPgwS1uSocket->Dispose ();
+  m_sgwPgwS1uSocket = 0;
+  m_femtoGwS1uSocket->Dispose ();
+  m_femtoGwS1uSocket = 0;
+  m_handoverLatencyStats = 0;
+  m_mmeS1apTransport = 0;
+  m_femtoGwS1apTransport = 0;
 }
 
 
@@ -189,6 +238,15 @@ EpcHelper::AddEnb (Ptr<Node> enb, Ptr<NetDevice> lteEnbNetDevice, uint16_t cellI
   NS_LOG_FUNCTION (this << enb << lteEnbNetDevice << cellId);
 
   NS_ASSERT (enb == lteEnbNetDevice->GetNode ());
+  // the HeNBs are connected through the femto gateway, the other eNBs
+  // directly to the SGW
+  if (enb->GetRole () == Node::UNSPECIFIED)
+    {
+      enb->SetRole (Node::MACRO_ENB);
+    }
+  NS_ASSERT_MSG (enb->GetRole () != Node::UE && enb->GetRole () != Node::GATEWAY,
+                 "node " << enb->GetId () << " cannot be an eNB");
+  bool homeEnb = (enb->GetRole () == Node::HOME_ENB);
 
   // add an IPv4 stack to the previously created eNB
   InternetStackHelper internet;
@@ -207,8 +265,8 @@ EpcHelper::AddEnb (Ptr<Node> enb, Ptr<NetDevice> lteEnbNetDevice, uint16_t cellI
   Ptr<Socket> enbS1uSocket;
   Ipv4Address enbAddress;
   Ipv4Address sgwAddress;
-  Ipv4Address sgw_sgw3Address;
-  if(enb->femto==false){  
+  Ipv4Address gwAddress;
+  if(!homeEnb){  
         NetDeviceContainer enbSgwDevices = p2ph.Install (enb, m_sgwPgw);
         NS_LOG_LOGIC ("number of Ipv4 ifaces of the eNB after installing p2p dev: " << enb->GetObject<Ipv4> ()->GetNInterfaces ());  
         Ptr<NetDevice> enbDev = enbSgwDevices.Get (0);
@@ -224,36 +282,37 @@ EpcHelper::AddEnb (Ptr<Node> enb, Ptr<NetDevice> lteEnbNetDevice, uint16_t cellI
         enbS1uSocket = Socket::CreateSocket (enb, TypeId::LookupByName ("ns3::UdpSocketFactory"));
         int retval = enbS1uSocket->Bind (InetSocketAddress (enbAddress, m_gtpuUdpPort));
         NS_ASSERT (retval == 0);
+        if (m_s1uDirect)
+          {
+            Ptr<EpcS1uDirectSocket> enbS1uDirectSocket = CreateObject<EpcS1uDirectSocket> (enbS1uSocket);
+            EpcS1uDirectSocket::Link (enbS1uDirectSocket, enbAddress, m_sgwPgwS1uSocket, sgwAddress, m_s1uLinkDelay);
+            enbS1uSocket = enbS1uDirectSocket;
+          }
   }
   else{  
-         NetDeviceContainer enbSgw2Devices = p2ph.Install (enb, m_sgwPgw2);
-         NetDeviceContainer Sgw2Sgw3Devices = p2ph.Install (m_sgwPgw2, m_sgwPgw3);
-         NetDeviceContainer Sgw3SgwDevices = p2ph.Install (m_sgwPgw3, m_sgwPgw);
-         NS_LOG_LOGIC ("number of Ipv4 ifaces of the eNB after installing p2p dev: " << enb->GetObject<Ipv4> ()->GetNInterfaces ());  
-         Ptr<NetDevice> enb_sgw2Dev = enbSgw2Devices.Get (0);
-         Ptr<NetDevice> sgw2_enbDev = enbSgw2Devices.Get (1);
-         Ptr<NetDevice> sgw2_sgw3Dev = Sgw2Sgw3Devices.Get (0);
-         Ptr<NetDevice> sgw3_sgw2Dev = Sgw2Sgw3Devices.Get (1);
-         Ptr<NetDevice> sgw3_sgwDev = Sgw3SgwDevices.Get (0);
-         Ptr<NetDevice> sgw_sgw3Dev = Sgw3SgwDevices.Get (1);
-         m_s1uIpv4AddressHelper.NewNetwork ();
-         Ipv4InterfaceContainer enbSgw2IpIfaces = m_s1uIpv4AddressHelper.Assign (enbSgw2Devices);
-         Ipv4InterfaceContainer Sgw2Sgw3IpIfaces = m_s1uIpv4AddressHelper.Assign (Sgw2Sgw3Devices);
-         Ipv4InterfaceContainer Sgw3SgwIpIfaces = m_s1uIpv4AddressHelper.Assign (Sgw3SgwDevices);
-         NS_LOG_LOGIC ("number of Ipv4 ifaces of the eNB after assigning Ipv4 addr to S1 dev: " << enb->GetObject<Ipv4> ()->GetNInterfaces ());
+        // the HeNB only gets an access link to the femto gateway, which
+        // reaches the SGW through its backhaul link shared by all HeNBs;
+        // every S1-U hop is on-link, so no routing is needed
+        InstallFemtoGwBackhaul ();
+        NetDeviceContainer enbGwDevices = p2ph.Install (enb, m_sgwPgw2);
+        NS_LOG_LOGIC ("number of Ipv4 ifaces of the eNB after installing p2p dev: " << enb->GetObject<Ipv4> ()->GetNInterfaces ());  
+        m_s1u_femtogw_Ipv4AddressHelper.NewNetwork ();
+        Ipv4InterfaceContainer enbGwIpIfaces = m_s1u_femtogw_Ipv4AddressHelper.Assign (enbGwDevices);
+        NS_LOG_LOGIC ("number of Ipv4 ifaces of the eNB after assigning Ipv4 addr to S1 dev: " << enb->GetObject<Ipv4> ()->GetNInterfaces ());
   
-        enbAddress = enbSgw2IpIfaces.GetAddress (0);
-        /*Ipv4Address sgw2_enbAddress = enbSgw2IpIfaces.GetAddress (1);
-        Ipv4Address sgw2_sgw3Address = Sgw2Sgw3IpIfaces.GetAddress (0);
-        Ipv4Address sgw3_sgw2Address = Sgw2Sgw3IpIfaces.GetAddress (1);
-        Ipv4Address sgw3_sgwAddress = Sgw3SgwIpIfaces.GetAddress (0);
-        */sgw_sgw3Address = Sgw3SgwIpIfaces.GetAddress (1);
+        enbAddress = enbGwIpIfaces.GetAddress (0);
+        gwAddress = enbGwIpIfaces.GetAddress (1);
         
         // create S1-U socket for the ENB
         enbS1uSocket = Socket::CreateSocket (enb, TypeId::LookupByName ("ns3::UdpSocketFactory"));
         int retval = enbS1uSocket->Bind (InetSocketAddress (enbAddress, m_gtpuUdpPort));
-        //Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
         NS_ASSERT (retval == 0);       
+        if (m_s1uDirect)
+          {
+            Ptr<EpcS1uDirectSocket> enbS1uDirectSocket = CreateObject<EpcS1uDirectSocket> (enbS1uSocket);
+            EpcS1uDirectSocket::Link (enbS1uDirectSocket, enbAddress, m_femtoGwS1uSocket, gwAddress, m_s1uLinkDelay);
+            enbS1uSocket = enbS1uDirectSocket;
+          }
   }
   
   // give PacketSocket powers to the eNB
@@ -277,10 +336,10 @@ EpcHelper::AddEnb (Ptr<Node> enb, Ptr<NetDevice> lteEnbNetDevice, uint16_t cellI
 
   NS_LOG_INFO ("create EpcEnbApplication");
   Ptr<EpcEnbApplication> enbApp;
-  if (enb->femto==false)
+  if (!homeEnb)
         enbApp = CreateObject<EpcEnbApplication> (enbLteSocket, enbS1uSocket, enbAddress, sgwAddress, cellId);
   else
-        enbApp = CreateObject<EpcEnbApplication> (enbLteSocket, enbS1uSocket, enbAddress, sgw_sgw3Address, cellId);
+        enbApp = CreateObject<EpcEnbApplication> (enbLteSocket, enbS1uSocket, enbAddress, gwAddress, cellId);
   enb->AddApplication (enbApp);
   NS_ASSERT (enb->GetNApplications () == 1);
   NS_ASSERT_MSG (enb->GetApplication (0)->GetObject<EpcEnbApplication> () != 0, "cannot retrieve EpcEnbApplication");
@@ -291,17 +350,108 @@ EpcHelper::AddEnb (Ptr<Node> enb, Ptr<NetDevice> lteEnbNetDevice, uint16_t cellI
   Ptr<EpcX2> x2 = CreateObject<EpcX2> ();
   enb->AggregateObject (x2);
 
+  // create X2-U socket for the ENB, to forward the downlink packets of
+  // the UEs during handover; it is bound on all the X2 addresses, which
+  // the EpcX2 entity already binds to the GTP-U port
+  Ptr<Socket> enbX2uSocket = Socket::CreateSocket (enb, TypeId::LookupByName ("ns3::UdpSocketFactory"));
+  retval = enbX2uSocket->Bind (InetSocketAddress (Ipv4Address::GetAny (), m_x2uUdpPort));
+  NS_ASSERT (retval == 0);
+  enbApp->SetX2uSocket (enbX2uSocket);
+  lteEnbNetDevice->GetObject<LteEnbNetDevice> ()->GetRrc ()->TraceConnectWithoutContext ("HandoverStart", MakeCallback (&EpcEnbApplication::HandoverStart, enbApp));
+
   NS_LOG_INFO ("connect S1-AP interface");
-  m_mme->AddEnb (cellId, enbAddress, enbApp->GetS1apSapEnb ());
-  m_sgwPgwApp->AddEnb (cellId, enbAddress, sgwAddress);
-  /*m_sgwPgwApp2->AddEnb (cellId, enbAddress, sgwAddress);
-  m_sgwPgwApp3->AddEnb (cellId, enbAddress, sgwAddress);
-  */
-
-  // Create router nodes, initialize routing database and set up the routing
-  // tables in the nodes.
-  
-  enbApp->SetS1apSapMme (m_mme->GetS1apSapMme ());
+  if (m_s1apSerialized)
+    {
+      // the S1-AP messages go over the S1 links, to the node of the
+      // MME (the SGW/PGW node) or to the femto gateway for the HeNBs
+      Ptr<EpcS1apTransport> enbS1apTransport = InstallS1apTransport (enb);
+      enbS1apTransport->SetS1apSapEnb (enbApp->GetS1apSapEnb ());
+      if (m_mmeS1apTransport == 0)
+        {
+          m_mmeS1apTransport = InstallS1apTransport (m_sgwPgw);
+          m_mmeS1apTransport->SetS1apSapMme (m_mme->GetS1apSapMme ());
+        }
+      if (!homeEnb)
+        {
+          m_mme->AddEnb (cellId, enbAddress, m_mmeS1apTransport->GetS1apSapEnb (enbAddress));
+          enbApp->SetS1apSapMme (enbS1apTransport->GetS1apSapMme (sgwAddress));
+        }
+      else
+        {
+          m_femtoGw->AddEnb (cellId, enbAddress, m_femtoGwS1apTransport->GetS1apSapEnb (enbAddress));
+          m_mme->AddEnb (cellId, enbAddress, m_mmeS1apTransport->GetS1apSapEnb (m_femtoGwS1uAddress));
+          enbApp->SetS1apSapMme (enbS1apTransport->GetS1apSapMme (gwAddress));
+        }
+    }
+  else if (!homeEnb)
+    {
+      m_mme->AddEnb (cellId, enbAddress, enbApp->GetS1apSapEnb ());
+      enbApp->SetS1apSapMme (m_mme->GetS1apSapMme ());
+    }
+  else
+    {
+      // the MME reaches the HeNB through the femto gateway
+      m_femtoGw->AddEnb (cellId, enbAddress, enbApp->GetS1apSapEnb ());
+      m_mme->AddEnb (cellId, enbAddress, m_femtoGw->GetS1apSapEnb ());
+      enbApp->SetS1apSapMme (m_femtoGw->GetS1apSapMme ());
+    }
+  if (!homeEnb)
+    {
+      m_sgwPgwApp->AddEnb (cellId, enbAddress, sgwAddress);
+    }
+  else
+    {
+      // for the SGW, the S1-U endpoint of a HeNB is the femto gateway
+      m_femtoGwApp->AddEnb (cellId, enbAddress);
+      m_sgwPgwApp->AddEnb (cellId, m_femtoGwS1uAddress, m_sgwFemtoGwS1uAddress);
+    }
+}
+
+
+void
+EpcHelper::InstallFemtoGwBackhaul ()
+{
+  if (m_femtoGwBackhaulInstalled)
+    {
+      return;
+    }
+  NS_LOG_FUNCTION (this);
+  PointToPointHelper p2ph;
+  p2ph.SetDeviceAttribute ("DataRate", DataRateValue (m_femtoGwBackhaulLinkDataRate));
+  p2ph.SetDeviceAttribute ("Mtu", UintegerValue (m_s1uLinkMtu));
+  p2ph.SetChannelAttribute ("Delay", TimeValue (m_femtoGwBackhaulLinkDelay));
+  NetDeviceContainer gwSgwDevices = p2ph.Install (m_sgwPgw2, m_sgwPgw);
+  m_s1uIpv4AddressHelper.NewNetwork ();
+  Ipv4InterfaceContainer gwSgwIpIfaces = m_s1uIpv4AddressHelper.Assign (gwSgwDevices);
+  m_femtoGwS1uAddress = gwSgwIpIfaces.GetAddress (0);
+  m_sgwFemtoGwS1uAddress = gwSgwIpIfaces.GetAddress (1);
+  m_femtoGwApp->SetSgwS1uAddress (m_sgwFemtoGwS1uAddress);
+  if (m_s1apSerialized)
+    {
+      // the femto gateway relays the S1-AP messages between its HeNBs
+      // and the MME over the backhaul link
+      m_femtoGwS1apTransport = InstallS1apTransport (m_sgwPgw2);
+      m_femtoGwS1apTransport->SetS1apSapMme (m_femtoGw->GetS1apSapMme ());
+      m_femtoGwS1apTransport->SetS1apSapEnb (m_femtoGw->GetS1apSapEnb ());
+      m_femtoGw->SetS1apSapMme (m_femtoGwS1apTransport->GetS1apSapMme (m_sgwFemtoGwS1uAddress));
+    }
+  if (m_s1uDirect)
+    {
+      EpcS1uDirectSocket::Link (m_femtoGwS1uSocket, m_femtoGwS1uAddress, m_sgwPgwS1uSocket, m_sgwFemtoGwS1uAddress, m_femtoGwBackhaulLinkDelay);
+    }
+  m_femtoGwBackhaulInstalled = true;
+}
+
+Ptr<EpcS1apTransport>
+EpcHelper::InstallS1apTransport (Ptr<Node> node)
+{
+  NS_LOG_FUNCTION (this << node);
+  Ptr<Socket> s1apSocket = Socket::CreateSocket (node, TypeId::LookupByName ("ns3::UdpSocketFactory"));
+  int retval = s1apSocket->Bind (InetSocketAddress (Ipv4Address::GetAny (), m_s1apUdpPort));
+  NS_ASSERT (retval == 0);
+  Ptr<EpcS1apTransport> transport = CreateObject<EpcS1apTransport> (s1apSocket, m_s1apUdpPort);
+  node->AggregateObject (transport);
+  return transport;
 }
 
 
@@ -346,6 +496,10 @@ EpcHelper::AddX2Interface (Ptr<Node> enb1, Ptr<Node> enb2)
 
   enb1X2->AddX2Interface (enb1CellId, enb1X2Address, enb2CellId, enb2X2Address);
   enb2X2->AddX2Interface (enb2CellId, enb2X2Address, enb1CellId, enb1X2Address);
+
+  // data forwarding over X2-U
+  enb1->GetApplication (0)->GetObject<EpcEnbApplication> ()->AddX2uNeighbour (enb2CellId, enb2X2Address);
+  enb2->GetApplication (0)->GetObject<EpcEnbApplication> ()->AddX2uNeighbour (enb1CellId, enb1X2Address);
 }
 
 
@@ -353,6 +507,10 @@ void
 EpcHelper::AddUe (Ptr<NetDevice> ueDevice, uint64_t imsi)
 {
   NS_LOG_FUNCTION (this << imsi << ueDevice );
+  if (ueDevice->GetNode ()->GetRole () == Node::UNSPECIFIED)
+    {
+      ueDevice->GetNode ()->SetRole (Node::UE);
+    }
   
   m_mme->AddUe (imsi);
   m_sgwPgwApp->AddUe (imsi);
@@ -392,6 +550,12 @@ EpcHelper::GetPgwNode ()
   return m_sgwPgw;
 }
 
+Ptr<FemtoGW>
+EpcHelper::GetFemtoGw ()
+{
+  return m_femtoGw;
+}
+
 
 Ipv4InterfaceContainer 
 EpcHelper::AssignUeIpv4Address (NetDeviceContainer ueDevices)
@@ -408,5 +572,17 @@ EpcHelper::GetUeDefaultGatewayAddress ()
   return m_sgwPgw->GetObject<Ipv4> ()->GetAddress (1, 0).GetLocal ();
 }
 
+Ptr<HandoverLatencyStats>
+EpcHelper::EnableHandoverLatencyStats ()
+{
+  NS_LOG_FUNCTION (this);
+  if (m_handoverLatencyStats == 0)
+    {
+      m_handoverLatencyStats = CreateObject<HandoverLatencyStats> ();
+      m_handoverLatencyStats->Install (m_mme);
+    }
+  return m_handoverLatencyStats;
+}
+
 
 } // namespace ns3
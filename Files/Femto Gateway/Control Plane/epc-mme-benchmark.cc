@@ -0,0 +1,89 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+// Measures the number of path switches per second processed by the
+// EpcMme when many UEs are attached. The SGW and the eNBs are stubs
+// which answer immediately, so that only the MME is measured.
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include <ns3/epc-mme.h>
+#include <ns3/epc-s1ap-sap.h>
+#include <ns3/epc-s11-sap.h>
+#include <ns3/epc-benchmark-stubs.h>
+#include <ns3/system-wall-clock-ms.h>
+
+using namespace ns3;
+
+int main (int argc, char *argv[])
+{
+  uint32_t nUes = 100000;
+  uint32_t nRounds = 10;
+  uint32_t nBearersPerUe = 1;
+  CommandLine cmd;
+  cmd.AddValue ("nUes", "Number of attached UEs", nUes);
+  cmd.AddValue ("nRounds", "Number of handovers of each UE", nRounds);
+  cmd.AddValue ("nBearersPerUe", "Number of EPS bearers of each UE", nBearersPerUe);
+  cmd.Parse (argc, argv);
+
+  Ptr<EpcMme> mme = CreateObject<EpcMme> ();
+  BenchmarkSgw sgw;
+  sgw.m_mme = mme->GetS11SapMme ();
+  mme->SetS11SapSgw (&sgw);
+  BenchmarkEnb enb1;
+  BenchmarkEnb enb2;
+  mme->AddEnb (1, Ipv4Address ("10.0.0.1"), &enb1);
+  mme->AddEnb (2, Ipv4Address ("10.0.0.2"), &enb2);
+
+  SystemWallClockMs clock;
+  clock.Start ();
+  for (uint64_t imsi = 1; imsi <= nUes; ++imsi)
+    {
+      mme->AddUe (imsi);
+      for (uint32_t b = 0; b < nBearersPerUe; ++b)
+        {
+          mme->AddBearer (imsi, Create<EpcTft> (), EpsBearer (EpsBearer::NGBR_VIDEO_TCP_DEFAULT));
+        }
+    }
+  int64_t attachMs = clock.End ();
+
+  EpcS1apSapMme* s1apSapMme = mme->GetS1apSapMme ();
+  EpcS1apSapMme::ErabSwitchedInDownlinkList erabToBeSwitchedInDownlinkList;
+  clock.Start ();
+  for (uint32_t round = 0; round < nRounds; ++round)
+    {
+      uint16_t targetCellId = 1 + (round % 2);
+      for (uint64_t imsi = 1; imsi <= nUes; ++imsi)
+        {
+          s1apSapMme->PathSwitchRequest (imsi & 0xffff, imsi, targetCellId, erabToBeSwitchedInDownlinkList);
+        }
+    }
+  int64_t pathSwitchMs = clock.End ();
+
+  uint64_t nPathSwitches = (uint64_t) nUes * nRounds;
+  NS_ABORT_IF (enb1.m_nAcks + enb2.m_nAcks != nPathSwitches);
+  std::cout << "UEs: " << nUes << std::endl;
+  std::cout << "context setup time [ms]: " << attachMs << std::endl;
+  std::cout << "path switches: " << nPathSwitches << std::endl;
+  std::cout << "path switch time [ms]: " << pathSwitchMs << std::endl;
+  std::cout << "path switches per second: "
+            << (pathSwitchMs > 0 ? nPathSwitches * 1000.0 / pathSwitchMs : 0) << std::endl;
+
+  mme->Dispose ();
+  Simulator::Destroy ();
+  return 0;
+}
@@ -20,6 +20,10 @@
 
 #include <ns3/fatal-error.h>
 #include <ns3/log.h>
+#include <ns3/simulator.h>
+#include <ns3/trace-source-accessor.h>
+
+#include <algorithm>
 
 #include "epc-s1ap-sap.h"
 #include "epc-s11-sap.h"
@@ -36,7 +40,12 @@ namespace ns3 {
 NS_OBJECT_ENSURE_REGISTERED (EpcMme);
 
 EpcMme::EpcMme ()
-  : m_s11SapSgw (0)
+  : m_ueTable (16),
+    m_nUes (0),
+    m_s11SapSgw (0),
+    m_nPathSwitchRounds (0),
+    m_nDeferredPathSwitches (0),
+    m_maxPathSwitchRoundSize (0)
 {
   NS_LOG_FUNCTION (this);
   m_s1apSapMme = new MemberEpcS1apSapMme<EpcMme> (this);
@@ -53,6 +62,7 @@ void
 EpcMme::DoDispose ()
 {
   NS_LOG_FUNCTION (this);
+  m_pathSwitchDeferralEvent.Cancel ();
   delete m_s1apSapMme;
   delete m_s11SapMme;
 }
@@ -63,6 +73,26 @@ EpcMme::GetTypeId (void)
   static TypeId tid = TypeId ("ns3::EpcMme")
     .SetParent<Object> ()
     .AddConstructor<EpcMme> ()
+    .AddAttribute ("PathSwitchDeferralWindow",
+                   "Time during which path switch requests are deferred, so that their "
+                   "Modify Bearer Requests reach the SGW back to back and their acknowledges "
+                   "are grouped by eNB. The SGW still gets one request per UE. Zero to send "
+                   "each request as it arrives.",
+                   TimeValue (Seconds (0)),
+                   MakeTimeAccessor (&EpcMme::m_pathSwitchDeferralWindow),
+                   MakeTimeChecker ())
+    .AddTraceSource ("PathSwitchRound",
+                     "A round of deferred path switches is sent to the SGW; the argument is the size of the round",
+                     MakeTraceSourceAccessor (&EpcMme::m_pathSwitchRoundTrace))
+    .AddTraceSource ("PathSwitchRequest",
+                     "A Path Switch Request is received: IMSI, source and target cell IDs",
+                     MakeTraceSourceAccessor (&EpcMme::m_pathSwitchRequestTrace))
+    .AddTraceSource ("ModifyBearerRequest",
+                     "The Modify Bearer Request of a path switch is sent to the SGW: IMSI and target cell ID",
+                     MakeTraceSourceAccessor (&EpcMme::m_modifyBearerRequestTrace))
+    .AddTraceSource ("ModifyBearerResponse",
+                     "The Modify Bearer Response of a path switch is received from the SGW: IMSI",
+                     MakeTraceSourceAccessor (&EpcMme::m_modifyBearerResponseTrace))
     ;
   return tid;
 }
@@ -86,25 +116,80 @@ EpcMme::GetS11SapMme ()
 }
 
 void 
-EpcMme::AddEnb (uint16_t gci, Ipv4Address enbS1uAddr, EpcS1apSapEnb* enbS1apSap)//, EpcS1apSapGW* gwS1apSap)
+EpcMme::AddEnb (uint16_t gci, Ipv4Address enbS1uAddr, EpcS1apSapEnb* enbS1apSap)
 {
   NS_LOG_FUNCTION (this << gci << enbS1uAddr);
-  Ptr<EnbInfo> enbInfo = Create<EnbInfo> ();
+  if (gci >= m_enbTable.size ())
+    {
+      EnbInfo none;
+      none.gci = 0;
+      none.s1apSapEnb = 0;
+      m_enbTable.resize (gci + 1, none);
+    }
+  EnbInfo* enbInfo = &m_enbTable[gci];
   enbInfo->gci = gci;
   enbInfo->s1uAddr = enbS1uAddr;
   enbInfo->s1apSapEnb = enbS1apSap;
- // enbInfo->s1apSapGW = gwS1apSap; 
-  m_enbInfoMap[gci] = enbInfo;
+}
+
+EpcMme::EnbInfo*
+EpcMme::FindEnbInfo (uint16_t gci)
+{
+  NS_ASSERT_MSG ((gci < m_enbTable.size ()) && (m_enbTable[gci].s1apSapEnb != 0), "could not find any eNB with CellId " << gci);
+  return &m_enbTable[gci];
+}
+
+uint32_t
+EpcMme::GetUeSlot (uint64_t imsi) const
+{
+  // Fibonacci hashing, then linear probing; the table is never full
+  uint32_t mask = m_ueTable.size () - 1;
+  uint32_t slot = (uint32_t) ((imsi * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+  while ((m_ueTable[slot].imsi != 0) && (m_ueTable[slot].imsi != imsi))
+    {
+      slot = (slot + 1) & mask;
+    }
+  return slot;
+}
+
+EpcMme::UeInfo*
+EpcMme::FindUeInfo (uint64_t imsi)
+{
+  UeInfo* ueInfo = &m_ueTable[GetUeSlot (imsi)];
+  return (ueInfo->imsi == imsi) ? ueInfo : 0;
 }
 
 void 
 EpcMme::AddUe (uint64_t imsi)
 {
   NS_LOG_FUNCTION (this << imsi);
-  Ptr<UeInfo> ueInfo = Create<UeInfo> ();
+  NS_ASSERT_MSG (imsi != 0, "IMSI 0 is reserved");
+  if (2 * (m_nUes + 1) > m_ueTable.size ())
+    {
+      // double the table and re-insert all the contexts
+      std::vector<UeInfo> oldTable (2 * m_ueTable.size ());
+      oldTable.swap (m_ueTable);
+      for (uint32_t i = 0; i < oldTable.size (); ++i)
+        {
+          if (oldTable[i].imsi != 0)
+            {
+              // the bearers are moved, not copied
+              std::vector<BearerInfo> bearers;
+              bearers.swap (oldTable[i].bearersToBeActivated);
+              UeInfo& ueInfo = m_ueTable[GetUeSlot (oldTable[i].imsi)];
+              ueInfo = oldTable[i];
+              ueInfo.bearersToBeActivated.swap (bearers);
+            }
+        }
+    }
+  UeInfo* ueInfo = &m_ueTable[GetUeSlot (imsi)];
+  if (ueInfo->imsi != imsi)
+    {
+      ++m_nUes;
+    }
+  *ueInfo = UeInfo ();
   ueInfo->imsi = imsi;
   ueInfo->mmeUeS1Id = imsi;
-  m_ueInfoMap[imsi] = ueInfo;
   ueInfo->bearerCounter = 0;
 }
 
@@ -112,14 +197,14 @@ void
 EpcMme::AddBearer (uint64_t imsi, Ptr<EpcTft> tft, EpsBearer bearer)
 {
   NS_LOG_FUNCTION (this << imsi);
-  std::map<uint64_t, Ptr<UeInfo> >::iterator it = m_ueInfoMap.find (imsi);
-  NS_ASSERT_MSG (it != m_ueInfoMap.end (), "could not find any UE with IMSI " << imsi);
-  NS_ASSERT_MSG (it->second->bearerCounter < 11, "too many bearers already! " << it->second->bearerCounter);
+  UeInfo* ueInfo = FindUeInfo (imsi);
+  NS_ASSERT_MSG (ueInfo != 0, "could not find any UE with IMSI " << imsi);
+  NS_ASSERT_MSG (ueInfo->bearerCounter < MAX_BEARERS_PER_UE, "too many bearers already! " << ueInfo->bearerCounter);
   BearerInfo bearerInfo;
-  bearerInfo.bearerId = ++(it->second->bearerCounter);
+  bearerInfo.bearerId = ++(ueInfo->bearerCounter);
   bearerInfo.tft = tft;
   bearerInfo.bearer = bearer;  
-  it->second->bearersToBeActivated.push_back (bearerInfo);
+  ueInfo->bearersToBeActivated.push_back (bearerInfo);
 }
 
 
@@ -129,14 +214,14 @@ void
 EpcMme::DoInitialUeMessage (uint64_t mmeUeS1Id, uint16_t enbUeS1Id, uint64_t imsi, uint16_t gci)
 {
   NS_LOG_FUNCTION (this << mmeUeS1Id << enbUeS1Id << imsi << gci);
-  std::map<uint64_t, Ptr<UeInfo> >::iterator it = m_ueInfoMap.find (imsi);
-  NS_ASSERT_MSG (it != m_ueInfoMap.end (), "could not find any UE with IMSI " << imsi);
-  it->second->cellId = gci;
+  UeInfo* ueInfo = FindUeInfo (imsi);
+  NS_ASSERT_MSG (ueInfo != 0, "could not find any UE with IMSI " << imsi);
+  ueInfo->cellId = gci;
   EpcS11SapSgw::CreateSessionRequestMessage msg;
   msg.imsi = imsi;
   msg. uli.gci = gci;
-  for (std::list<BearerInfo>::iterator bit = it->second->bearersToBeActivated.begin ();
-       bit != it->second->bearersToBeActivated.end ();
+  for (std::vector<BearerInfo>::const_iterator bit = ueInfo->bearersToBeActivated.begin ();
+       bit != ueInfo->bearersToBeActivated.end ();
        ++bit)
     {
       EpcS11SapSgw::BearerContextToBeCreated bearerContext;
@@ -149,28 +234,66 @@ EpcMme::DoInitialUeMessage (uint64_t mmeUeS1Id, uint16_t enbUeS1Id, uint64_t ims
 }
 
 void 
-EpcMme::DoInitialContextSetupResponse (uint64_t mmeUeS1Id, uint16_t enbUeS1Id, std::list<EpcS1apSapMme::ErabSetupItem> erabSetupList)
+EpcMme::DoInitialContextSetupResponse (uint64_t mmeUeS1Id, uint16_t enbUeS1Id, const EpcS1apSapMme::ErabSetupList &erabSetupList)
 {
   NS_LOG_FUNCTION (this << mmeUeS1Id << enbUeS1Id);
   NS_FATAL_ERROR ("unimplemented");
 }
 
 void 
-EpcMme::DoPathSwitchRequest (uint64_t enbUeS1Id, uint64_t mmeUeS1Id, uint16_t gci, std::list<EpcS1apSapMme::ErabSwitchedInDownlinkItem> erabToBeSwitchedInDownlinkList)
+EpcMme::DoPathSwitchRequest (uint64_t enbUeS1Id, uint64_t mmeUeS1Id, uint16_t gci, const EpcS1apSapMme::ErabSwitchedInDownlinkList &erabToBeSwitchedInDownlinkList)
 {
   NS_LOG_FUNCTION (this << mmeUeS1Id << enbUeS1Id << gci);
 
   uint64_t imsi = mmeUeS1Id; 
-  std::map<uint64_t, Ptr<UeInfo> >::iterator it = m_ueInfoMap.find (imsi);
-  NS_ASSERT_MSG (it != m_ueInfoMap.end (), "could not find any UE with IMSI " << imsi);
-  NS_LOG_INFO ("IMSI " << imsi << " old eNB: " << it->second->cellId << ", new eNB: " << gci);
-  it->second->cellId = gci;
-  it->second->enbUeS1Id = enbUeS1Id;
+  UeInfo* ueInfo = FindUeInfo (imsi);
+  NS_ASSERT_MSG (ueInfo != 0, "could not find any UE with IMSI " << imsi);
+  NS_LOG_INFO ("IMSI " << imsi << " old eNB: " << ueInfo->cellId << ", new eNB: " << gci);
+  m_pathSwitchRequestTrace (imsi, ueInfo->cellId, gci);
+  ueInfo->cellId = gci;
+  ueInfo->enbUeS1Id = enbUeS1Id;
+
+  if (!m_pathSwitchDeferralWindow.IsZero ())
+    {
+      if (ueInfo->pathSwitchPending)
+        {
+          // a newer handover of a UE waiting for the window: its
+          // request will be sent with the latest target eNB
+          NS_LOG_LOGIC ("IMSI " << imsi << " already has a pending path switch");
+          for (std::vector<PendingPathSwitch>::iterator it = m_pendingPathSwitches.begin ();
+               it != m_pendingPathSwitches.end ();
+               ++it)
+            {
+              if (it->imsi == imsi)
+                {
+                  it->cellId = gci;
+                  return;
+                }
+            }
+          NS_FATAL_ERROR ("no pending path switch for IMSI " << imsi);
+        }
+      // if the request of an earlier handover has already been sent,
+      // the SGW must be told about the new eNB too: this one is
+      // deferred again, and only the last one is acknowledged
+      ueInfo->pathSwitchPending = true;
+      ++ueInfo->nDeferredPathSwitches;
+      PendingPathSwitch pending;
+      pending.imsi = imsi;
+      pending.cellId = gci;
+      pending.arrivalTime = Simulator::Now ();
+      m_pendingPathSwitches.push_back (pending);
+      if (!m_pathSwitchDeferralEvent.IsRunning ())
+        {
+          m_pathSwitchDeferralEvent = Simulator::Schedule (m_pathSwitchDeferralWindow, &EpcMme::SendDeferredPathSwitches, this);
+        }
+      return;
+    }
 
   EpcS11SapSgw::ModifyBearerRequestMessage msg;
   msg.teid = imsi; // trick to avoid the need for allocating TEIDs on the S11 interface
   msg.uli.gci = gci;
   // bearer modification is not supported for now
+  m_modifyBearerRequestTrace (imsi, gci);
   m_s11SapSgw->ModifyBearerRequest (msg);
 }
 
@@ -182,7 +305,7 @@ EpcMme::DoCreateSessionResponse (EpcS11SapMme::CreateSessionResponseMessage msg)
 {
   NS_LOG_FUNCTION (this << msg.teid);
   uint64_t imsi = msg.teid;
-  std::list<EpcS1apSapEnb::ErabToBeSetupItem> erabToBeSetupList;
+  EpcS1apSapEnb::ErabToBeSetupList erabToBeSetupList;
   for (std::list<EpcS11SapMme::BearerContextCreated>::iterator bit = msg.bearerContextsCreated.begin ();
        bit != msg.bearerContextsCreated.end ();
        ++bit)
@@ -194,17 +317,98 @@ EpcMme::DoCreateSessionResponse (EpcS11SapMme::CreateSessionResponseMessage msg)
       erab.sgwTeid = bit->sgwFteid.teid;      
       erabToBeSetupList.push_back (erab);
     }
-  std::map<uint64_t, Ptr<UeInfo> >::iterator it = m_ueInfoMap.find (imsi);
-  NS_ASSERT_MSG (it != m_ueInfoMap.end (), "could not find any UE with IMSI " << imsi);
-  uint16_t cellId = it->second->cellId;
-  uint16_t enbUeS1Id = it->second->enbUeS1Id;
-  uint64_t mmeUeS1Id = it->second->mmeUeS1Id;
-  std::map<uint16_t, Ptr<EnbInfo> >::iterator jt = m_enbInfoMap.find (cellId);
-  NS_ASSERT_MSG (jt != m_enbInfoMap.end (), "could not find any eNB with CellId " << cellId);
-  jt->second->s1apSapEnb->InitialContextSetupRequest (mmeUeS1Id, enbUeS1Id, erabToBeSetupList);
-//  jt->second->s1apSapGW->InitialContextSetupRequest (mmeUeS1Id, enbUeS1Id, erabToBeSetupList);
+  UeInfo* ueInfo = FindUeInfo (imsi);
+  NS_ASSERT_MSG (ueInfo != 0, "could not find any UE with IMSI " << imsi);
+  uint16_t cellId = ueInfo->cellId;
+  uint16_t enbUeS1Id = ueInfo->enbUeS1Id;
+  uint64_t mmeUeS1Id = ueInfo->mmeUeS1Id;
+  FindEnbInfo (cellId)->s1apSapEnb->InitialContextSetupRequest (mmeUeS1Id, enbUeS1Id, erabToBeSetupList);
+}
+
+
+bool
+EpcMme::ComparePendingPathSwitchCellId (const PendingPathSwitch &a, const PendingPathSwitch &b)
+{
+  return a.cellId < b.cellId;
+}
+
+void 
+EpcMme::SendDeferredPathSwitches ()
+{
+  NS_LOG_FUNCTION (this << m_pendingPathSwitches.size ());
+  std::vector<PendingPathSwitch> deferred;
+  deferred.swap (m_pendingPathSwitches);
+  // the acknowledges will be sent in this order, one eNB after the other
+  std::stable_sort (deferred.begin (), deferred.end (), ComparePendingPathSwitchCellId);
+
+  uint32_t size = deferred.size ();
+  ++m_nPathSwitchRounds;
+  m_nDeferredPathSwitches += size;
+  m_maxPathSwitchRoundSize = std::max (m_maxPathSwitchRoundSize, size);
+  m_pathSwitchRoundTrace (size);
+
+  m_pathSwitchRoundsInFlight.push_back (PathSwitchRound ());
+  PathSwitchRound& inFlight = m_pathSwitchRoundsInFlight.back ();
+  for (std::vector<PendingPathSwitch>::const_iterator it = deferred.begin (); it != deferred.end (); ++it)
+    {
+      Time delay = Simulator::Now () - it->arrivalTime;
+      m_totalPathSwitchDeferral += delay;
+      m_maxPathSwitchDeferral = Max (m_maxPathSwitchDeferral, delay);
+      inFlight.imsis.push_back (it->imsi);
+      inFlight.outstanding.insert (it->imsi);
+      FindUeInfo (it->imsi)->pathSwitchPending = false;
+    }
+  for (std::vector<PendingPathSwitch>::const_iterator it = deferred.begin (); it != deferred.end (); ++it)
+    {
+      EpcS11SapSgw::ModifyBearerRequestMessage msg;
+      msg.teid = it->imsi; // trick to avoid the need for allocating TEIDs on the S11 interface
+      msg.uli.gci = it->cellId;
+      m_modifyBearerRequestTrace (it->imsi, msg.uli.gci);
+      m_s11SapSgw->ModifyBearerRequest (msg);
+    }
+}
+
+void 
+EpcMme::SendPathSwitchRequestAcknowledge (uint64_t imsi)
+{
+  UeInfo* ueInfo = FindUeInfo (imsi);
+  NS_ASSERT_MSG (ueInfo != 0, "could not find any UE with IMSI " << imsi);
+  uint64_t enbUeS1Id = ueInfo->enbUeS1Id;
+  uint64_t mmeUeS1Id = ueInfo->mmeUeS1Id;
+  uint16_t cgi = ueInfo->cellId;
+  EpcS1apSapEnb::ErabSwitchedInUplinkList erabToBeSwitchedInUplinkList; // unused for now
+  FindEnbInfo (cgi)->s1apSapEnb->PathSwitchRequestAcknowledge (enbUeS1Id, mmeUeS1Id, cgi, erabToBeSwitchedInUplinkList);
+}
+
+uint64_t
+EpcMme::GetNPathSwitchRounds () const
+{
+  return m_nPathSwitchRounds;
 }
 
+double
+EpcMme::GetMeanPathSwitchRoundSize () const
+{
+  return (m_nPathSwitchRounds > 0) ? (double) m_nDeferredPathSwitches / m_nPathSwitchRounds : 0;
+}
+
+uint32_t
+EpcMme::GetMaxPathSwitchRoundSize () const
+{
+  return m_maxPathSwitchRoundSize;
+}
+
+Time
+EpcMme::GetMeanPathSwitchDeferral () const
+{
+  return (m_nDeferredPathSwitches > 0) ? NanoSeconds (m_totalPathSwitchDeferral.GetNanoSeconds () / (int64_t) m_nDeferredPathSwitches) : Seconds (0);
+}
+
+Time
+EpcMme::GetMaxPathSwitchDeferral () const
+{
+  return m_maxPathSwitchDeferral;
+}
 
 void 
 EpcMme::DoModifyBearerResponse (EpcS11SapMme::ModifyBearerResponseMessage msg)
@@ -212,16 +416,40 @@ EpcMme::DoModifyBearerResponse (EpcS11SapMme::ModifyBearerResponseMessage msg)
   NS_LOG_FUNCTION (this << msg.teid);
   NS_ASSERT (msg.cause == EpcS11SapMme::ModifyBearerResponseMessage::REQUEST_ACCEPTED);
   uint64_t imsi = msg.teid;
-  std::map<uint64_t, Ptr<UeInfo> >::iterator it = m_ueInfoMap.find (imsi);
-  NS_ASSERT_MSG (it != m_ueInfoMap.end (), "could not find any UE with IMSI " << imsi);
-  uint64_t enbUeS1Id = it->second->enbUeS1Id;
-  uint64_t mmeUeS1Id = it->second->mmeUeS1Id;
-  uint16_t cgi = it->second->cellId;
-  std::list<EpcS1apSapEnb::ErabSwitchedInUplinkItem> erabToBeSwitchedInUplinkList; // unused for now
-  std::map<uint16_t, Ptr<EnbInfo> >::iterator jt = m_enbInfoMap.find (it->second->cellId);
-  NS_ASSERT_MSG (jt != m_enbInfoMap.end (), "could not find any eNB with CellId " << it->second->cellId);
-  jt->second->s1apSapEnb->PathSwitchRequestAcknowledge (enbUeS1Id, mmeUeS1Id, cgi, erabToBeSwitchedInUplinkList);
-//  jt->second->s1apSapGW->PathSwitchRequestAcknowledge (enbUeS1Id, mmeUeS1Id, cgi, erabToBeSwitchedInUplinkList);
+  UeInfo* ueInfo = FindUeInfo (imsi);
+  NS_ASSERT_MSG (ueInfo != 0, "could not find any UE with IMSI " << imsi);
+  m_modifyBearerResponseTrace (imsi);
+  // the SGW answers the requests of a UE in order: the response is
+  // for the oldest round in flight with the UE
+  for (std::list<PathSwitchRound>::iterator roundIt = m_pathSwitchRoundsInFlight.begin ();
+       roundIt != m_pathSwitchRoundsInFlight.end ();
+       ++roundIt)
+    {
+      if (roundIt->outstanding.erase (imsi) == 0)
+        {
+          continue;
+        }
+      if (roundIt->outstanding.empty ())
+        {
+          // the whole round has been answered: acknowledge its path
+          // switches, grouped by target eNB, but for the UEs with a
+          // newer one, which will be acknowledged with its own round
+          std::vector<uint64_t> imsis;
+          imsis.swap (roundIt->imsis);
+          m_pathSwitchRoundsInFlight.erase (roundIt);
+          for (std::vector<uint64_t>::const_iterator it = imsis.begin (); it != imsis.end (); ++it)
+            {
+              UeInfo* roundUeInfo = FindUeInfo (*it);
+              NS_ASSERT (roundUeInfo->nDeferredPathSwitches > 0);
+              if (--roundUeInfo->nDeferredPathSwitches == 0)
+                {
+                  SendPathSwitchRequestAcknowledge (*it);
+                }
+            }
+        }
+      return;
+    }
+  SendPathSwitchRequestAcknowledge (imsi);
 }
 
 } // namespace ns3
@@ -22,11 +22,15 @@
 #define EPC_MME_H
 
 #include <ns3/object.h>
+#include <ns3/nstime.h>
+#include <ns3/event-id.h>
+#include <ns3/traced-callback.h>
 #include <ns3/epc-s1ap-sap.h>
 #include <ns3/epc-s11-sap.h>
 
-#include <map>
 #include <list>
+#include <vector>
+#include <set>
 
 namespace ns3 {
 
@@ -36,6 +40,17 @@ class NetDevice;
 /**
  * \brief This object implements the MME functionality.
  *
+ * If PathSwitchDeferralWindow is not zero, the path switch requests are
+ * deferred instead of being forwarded to the SGW as they arrive. The
+ * requests received within the window form a round, whose Modify
+ * Bearer Requests are sent back to back, one per UE, when it expires.
+ * The S11 signalling is the same as without the window. The requests
+ * only reach the SGW at the same time, and the Path Switch Request
+ * Acknowledges of a round are sent grouped by target eNB once the SGW
+ * has answered all of them. A newer handover of a UE whose request is
+ * still waiting for the window replaces it. If the request has already
+ * been sent, the new one goes in the next round, and only the last one
+ * is acknowledged.
  */
 class EpcMme : public Object
 {
@@ -87,7 +102,7 @@ public:
    * \param imsi the unique identifier of the UE
    * \param enbS1apSap the ENB side of the S1-AP SAP 
    */
-  void AddEnb (uint16_t egci, Ipv4Address enbS1UAddr, EpcS1apSapEnb* enbS1apSap);//, EpcS1apSapGW* gwS1apSap); 
+  void AddEnb (uint16_t egci, Ipv4Address enbS1UAddr, EpcS1apSapEnb* enbS1apSap);
   
   /** 
    * Add a new UE to the MME. This is the equivalent of storing the UE
@@ -108,20 +123,58 @@ public:
    */
   void AddBearer (uint64_t imsi, Ptr<EpcTft> tft, EpsBearer bearer);
 
+  /** 
+   * \return the number of rounds of deferred path switches sent to the SGW
+   */
+  uint64_t GetNPathSwitchRounds () const;
+
+  /** 
+   * \return the mean number of path switches per round
+   */
+  double GetMeanPathSwitchRoundSize () const;
+
+  /** 
+   * \return the largest number of path switches in a round
+   */
+  uint32_t GetMaxPathSwitchRoundSize () const;
+
+  /** 
+   * \return the mean time spent by a path switch request waiting for its round to be sent
+   */
+  Time GetMeanPathSwitchDeferral () const;
+
+  /** 
+   * \return the longest time spent by a path switch request waiting for its round to be sent
+   */
+  Time GetMaxPathSwitchDeferral () const;
+
   EpcS1apSapMme* m_s1apSapMme;
 
 private:
 
   // S1-AP SAP MME forwarded methods
   void DoInitialUeMessage (uint64_t mmeUeS1Id, uint16_t enbUeS1Id, uint64_t imsi, uint16_t ecgi);
-  void DoInitialContextSetupResponse (uint64_t mmeUeS1Id, uint16_t enbUeS1Id, std::list<EpcS1apSapMme::ErabSetupItem> erabSetupList);
-  void DoPathSwitchRequest (uint64_t enbUeS1Id, uint64_t mmeUeS1Id, uint16_t cgi, std::list<EpcS1apSapMme::ErabSwitchedInDownlinkItem> erabToBeSwitchedInDownlinkList);
+  void DoInitialContextSetupResponse (uint64_t mmeUeS1Id, uint16_t enbUeS1Id, const EpcS1apSapMme::ErabSetupList &erabSetupList);
+  void DoPathSwitchRequest (uint64_t enbUeS1Id, uint64_t mmeUeS1Id, uint16_t cgi, const EpcS1apSapMme::ErabSwitchedInDownlinkList &erabToBeSwitchedInDownlinkList);
 
 
   // S11 SAP MME forwarded methods
   void DoCreateSessionResponse (EpcS11SapMme::CreateSessionResponseMessage msg);
   void DoModifyBearerResponse (EpcS11SapMme::ModifyBearerResponseMessage msg);
 
+  /** 
+   * Send the Modify Bearer Requests of the path switches collected
+   * during the deferral window
+   */
+  void SendDeferredPathSwitches ();
+
+  /** 
+   * Send the Path Switch Request Acknowledge of a UE to its current eNB
+   * 
+   * \param imsi the IMSI of the UE
+   */
+  void SendPathSwitchRequestAcknowledge (uint64_t imsi);
+
   /**
    * Hold info on an EPS bearer to be activated
    * 
@@ -132,44 +185,74 @@ private:
     EpsBearer bearer;
     uint8_t bearerId;
   };
+
+  /**
+   * maximum number of EPS bearers per UE
+   */
+  static const uint16_t MAX_BEARERS_PER_UE = 11;
   
   /**
-   * Hold info on a UE
+   * Hold info on a UE. The context of a UE is one slot of m_ueTable;
+   * its bearers are kept out of line, so that the empty slots and the
+   * UEs with few bearers stay small.
    * 
    */
-  struct UeInfo : public SimpleRefCount<UeInfo>
+  struct UeInfo
   {
+    uint64_t imsi;         ///< 0 for an empty slot
     uint64_t mmeUeS1Id;
     uint16_t enbUeS1Id;
-    uint64_t imsi;
     uint16_t cellId;
-    std::list<BearerInfo> bearersToBeActivated;
     uint16_t bearerCounter;
+    bool pathSwitchPending;  ///< true while a path switch of the UE waits for the deferral window
+    uint16_t nDeferredPathSwitches;  ///< deferred path switches of the UE not yet answered by the SGW
+    std::vector<BearerInfo> bearersToBeActivated;
   };
 
+  /** 
+   * \param imsi the IMSI of the UE
+   * \return the context of the UE, or 0 if the UE is not known; the
+   * pointer is invalidated by the next call to AddUe
+   */
+  UeInfo* FindUeInfo (uint64_t imsi);
+
+  /** 
+   * \param imsi the IMSI of the UE
+   * \return the slot of m_ueTable where the context of the UE is, or
+   * the empty slot where it would be inserted
+   */
+  uint32_t GetUeSlot (uint64_t imsi) const;
+
   /**
-   * UeInfo stored by IMSI
+   * UeInfo stored by IMSI in an open-addressing hash table with linear
+   * probing, whose size is a power of 2 and which is at most half full
    * 
    */  
-  std::map<uint64_t, Ptr<UeInfo> > m_ueInfoMap;
+  std::vector<UeInfo> m_ueTable;
+  uint32_t m_nUes;
 
   /**
    * Hold info on a ENB
    * 
    */
-  struct EnbInfo : public SimpleRefCount<EnbInfo>
+  struct EnbInfo
   {
     uint16_t gci;
     Ipv4Address s1uAddr;
-    EpcS1apSapEnb* s1apSapEnb;
-//	EpcS1apSapGW*  s1apSapGW;
+    EpcS1apSapEnb* s1apSapEnb;     ///< 0 if no eNB has this ECGI
   };
 
+  /** 
+   * \param gci the ECGI of the eNB
+   * \return the info of the eNB, which must exist
+   */
+  EnbInfo* FindEnbInfo (uint16_t gci);
+
   /**
-   * EnbInfo stored by EGCI
+   * EnbInfo indexed by EGCI
    * 
    */
-  std::map<uint16_t, Ptr<EnbInfo> > m_enbInfoMap;
+  std::vector<EnbInfo> m_enbTable;
 
 
   
@@ -177,6 +260,56 @@ private:
 
   EpcS11SapMme* m_s11SapMme;
   EpcS11SapSgw* m_s11SapSgw;
+
+  /**
+   * A path switch request waiting for the deferral window to expire
+   */
+  struct PendingPathSwitch
+  {
+    uint64_t imsi;
+    uint16_t cellId;
+    Time arrivalTime;
+  };
+
+  static bool ComparePendingPathSwitchCellId (const PendingPathSwitch &a, const PendingPathSwitch &b);
+
+  Time m_pathSwitchDeferralWindow;
+  EventId m_pathSwitchDeferralEvent;
+  std::vector<PendingPathSwitch> m_pendingPathSwitches;
+  /**
+   * A round of deferred path switches sent to the SGW
+   */
+  struct PathSwitchRound
+  {
+    std::vector<uint64_t> imsis;   ///< sorted by target eNB
+    std::set<uint64_t> outstanding;   ///< the UEs whose Modify Bearer Response is missing
+  };
+
+  /**
+   * the rounds sent to the SGW and not yet answered, oldest first
+   */
+  std::list<PathSwitchRound> m_pathSwitchRoundsInFlight;
+
+  uint64_t m_nPathSwitchRounds;
+  uint64_t m_nDeferredPathSwitches;
+  uint32_t m_maxPathSwitchRoundSize;
+  Time m_totalPathSwitchDeferral;
+  Time m_maxPathSwitchDeferral;
+
+  /**
+   * trace fired when a round is sent, with the number of path switches in the round
+   */
+  TracedCallback<uint32_t> m_pathSwitchRoundTrace;
+
+  /**
+   * traces fired when a Path Switch Request is received, with the IMSI
+   * and the source and target cell IDs, when the Modify Bearer Request
+   * of a UE is sent to the SGW, with the IMSI and the target cell ID,
+   * and when its response is received, with the IMSI
+   */
+  TracedCallback<uint64_t, uint16_t, uint16_t> m_pathSwitchRequestTrace;
+  TracedCallback<uint64_t, uint16_t> m_modifyBearerRequestTrace;
+  TracedCallback<uint64_t> m_modifyBearerResponseTrace;
   
 };
 
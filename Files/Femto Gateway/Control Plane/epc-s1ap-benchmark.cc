@@ -0,0 +1,140 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+// Counts the heap allocations of the S1-AP signalling of the attach
+// and of the handover of nUes UEs with nBearersPerUe bearers each,
+// going through the EpcMme. The SGW and the eNBs are stubs which
+// answer immediately. An attach is the Initial UE Message, the Create
+// Session Request and Response on S11 and the Initial Context Setup
+// Request; a handover is the Path Switch Request, the Modify Bearer
+// Request and Response on S11 and the Path Switch Request Acknowledge.
+// The S11 messages still carry their bearer contexts in std::lists,
+// whose allocations are included.
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include <ns3/epc-mme.h>
+#include <ns3/epc-s1ap-sap.h>
+#include <ns3/epc-s11-sap.h>
+#include <ns3/epc-benchmark-stubs.h>
+#include <ns3/system-wall-clock-ms.h>
+
+#include <cstdlib>
+#include <new>
+
+using namespace ns3;
+
+static uint64_t g_nAllocations = 0;
+
+void*
+operator new (std::size_t size) throw (std::bad_alloc)
+{
+  ++g_nAllocations;
+  void* p = std::malloc (size > 0 ? size : 1);
+  if (p == 0)
+    {
+      throw std::bad_alloc ();
+    }
+  return p;
+}
+
+void
+operator delete (void* p) throw ()
+{
+  std::free (p);
+}
+
+int main (int argc, char *argv[])
+{
+  uint32_t nUes = 10000;
+  uint32_t nRounds = 10;
+  uint32_t nBearersPerUe = 2;
+  CommandLine cmd;
+  cmd.AddValue ("nUes", "Number of UEs", nUes);
+  cmd.AddValue ("nRounds", "Number of handovers of each UE", nRounds);
+  cmd.AddValue ("nBearersPerUe", "Number of EPS bearers of each UE (at most 11)", nBearersPerUe);
+  cmd.Parse (argc, argv);
+  NS_ABORT_MSG_IF (nUes < 1, "nUes must be at least 1");
+  NS_ABORT_MSG_IF (nBearersPerUe < 1 || nBearersPerUe > 11, "nBearersPerUe must be between 1 and 11");
+
+  Ptr<EpcMme> mme = CreateObject<EpcMme> ();
+  BenchmarkSgw sgw;
+  sgw.m_mme = mme->GetS11SapMme ();
+  mme->SetS11SapSgw (&sgw);
+  BenchmarkEnb enb1;
+  BenchmarkEnb enb2;
+  mme->AddEnb (1, Ipv4Address ("10.0.0.5"), &enb1);
+  mme->AddEnb (2, Ipv4Address ("10.0.0.9"), &enb2);
+  for (uint64_t imsi = 1; imsi <= nUes; ++imsi)
+    {
+      mme->AddUe (imsi);
+      for (uint32_t b = 0; b < nBearersPerUe; ++b)
+        {
+          mme->AddBearer (imsi, Create<EpcTft> (), EpsBearer (EpsBearer::NGBR_VIDEO_TCP_DEFAULT));
+        }
+    }
+  EpcS1apSapMme* s1apSapMme = mme->GetS1apSapMme ();
+
+  SystemWallClockMs clock;
+  clock.Start ();
+  uint64_t nAllocations = g_nAllocations;
+  for (uint64_t imsi = 1; imsi <= nUes; ++imsi)
+    {
+      s1apSapMme->InitialUeMessage (imsi, imsi & 0xffff, imsi, 1);
+    }
+  uint64_t attachAllocations = g_nAllocations - nAllocations;
+  int64_t attachMs = clock.End ();
+  NS_ABORT_IF (enb1.m_nErabs != (uint64_t) nUes * nBearersPerUe);
+
+  clock.Start ();
+  nAllocations = g_nAllocations;
+  for (uint32_t round = 0; round < nRounds; ++round)
+    {
+      uint16_t targetCellId = 2 - (round % 2);
+      Ipv4Address enbAddress = (targetCellId == 1) ? Ipv4Address ("10.0.0.5") : Ipv4Address ("10.0.0.9");
+      for (uint64_t imsi = 1; imsi <= nUes; ++imsi)
+        {
+          EpcS1apSapMme::ErabSwitchedInDownlinkList erabToBeSwitchedInDownlinkList;
+          for (uint32_t b = 1; b <= nBearersPerUe; ++b)
+            {
+              EpcS1apSapMme::ErabSwitchedInDownlinkItem erab;
+              erab.erabId = b;
+              erab.enbTransportLayerAddress = enbAddress;
+              erab.enbTeid = (imsi - 1) * EpcS1apSapMme::ErabSwitchedInDownlinkList::MAX_ERABS + b;
+              erabToBeSwitchedInDownlinkList.push_back (erab);
+            }
+          s1apSapMme->PathSwitchRequest (imsi & 0xffff, imsi, targetCellId, erabToBeSwitchedInDownlinkList);
+        }
+    }
+  uint64_t handoverAllocations = g_nAllocations - nAllocations;
+  int64_t handoverMs = clock.End ();
+
+  uint64_t nHandovers = (uint64_t) nUes * nRounds;
+  NS_ABORT_IF (enb1.m_nAcks + enb2.m_nAcks != nHandovers);
+  std::cout << "UEs: " << nUes << ", bearers per UE: " << nBearersPerUe << std::endl;
+  std::cout << "attach allocations: " << attachAllocations
+            << " (" << (double) attachAllocations / nUes << " per UE)" << std::endl;
+  std::cout << "attach time [ms]: " << attachMs << std::endl;
+  std::cout << "handovers: " << nHandovers << std::endl;
+  std::cout << "handover allocations: " << handoverAllocations
+            << " (" << (double) handoverAllocations / nHandovers << " per handover)" << std::endl;
+  std::cout << "handover time [ms]: " << handoverMs << std::endl;
+
+  mme->Dispose ();
+  Simulator::Destroy ();
+  return 0;
+}
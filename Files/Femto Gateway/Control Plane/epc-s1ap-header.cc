@@ -0,0 +1,407 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#include "epc-s1ap-header.h"
+#include "ns3/assert.h"
+#include "ns3/log.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("EpcS1apHeader");
+
+NS_OBJECT_ENSURE_REGISTERED (EpcS1apHeader);
+
+// message type, MME UE S1AP ID, eNB UE S1AP ID, cell ID, number of E-RABs
+static const uint32_t FIXED_SIZE = 1 + 8 + 8 + 2 + 1;
+static const uint32_t IMSI_SIZE = 8;
+// E-RAB ID, QCI, GBR and MBR in both directions, ARP, address, TEID
+static const uint32_t ERAB_TO_BE_SETUP_ITEM_SIZE = 1 + 1 + 4 * 8 + 3 + 4 + 4;
+// E-RAB ID, address, TEID
+static const uint32_t ERAB_ITEM_SIZE = 1 + 4 + 4;
+
+TypeId
+EpcS1apHeader::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::EpcS1apHeader")
+    .SetParent<Header> ()
+    .AddConstructor<EpcS1apHeader> ()
+  ;
+  return tid;
+}
+
+TypeId
+EpcS1apHeader::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+EpcS1apHeader::EpcS1apHeader ()
+  : m_messageType (INITIAL_UE_MESSAGE),
+    m_mmeUeS1Id (0),
+    m_enbUeS1Id (0),
+    m_imsi (0),
+    m_cellId (0)
+{
+}
+
+EpcS1apHeader::~EpcS1apHeader ()
+{
+}
+
+std::string
+EpcS1apHeader::GetMessageTypeName (MessageType_t messageType)
+{
+  switch (messageType)
+    {
+    case INITIAL_UE_MESSAGE:
+      return "InitialUeMessage";
+    case INITIAL_CONTEXT_SETUP_REQUEST:
+      return "InitialContextSetupRequest";
+    case INITIAL_CONTEXT_SETUP_RESPONSE:
+      return "InitialContextSetupResponse";
+    case PATH_SWITCH_REQUEST:
+      return "PathSwitchRequest";
+    case PATH_SWITCH_REQUEST_ACKNOWLEDGE:
+      return "PathSwitchRequestAcknowledge";
+    default:
+      NS_FATAL_ERROR ("unknown S1-AP message type " << (uint32_t) messageType);
+      return "";
+    }
+}
+
+bool
+EpcS1apHeader::IsForMme (MessageType_t messageType)
+{
+  return messageType == INITIAL_UE_MESSAGE
+         || messageType == INITIAL_CONTEXT_SETUP_RESPONSE
+         || messageType == PATH_SWITCH_REQUEST;
+}
+
+uint32_t
+EpcS1apHeader::GetNErabs () const
+{
+  switch (m_messageType)
+    {
+    case INITIAL_CONTEXT_SETUP_REQUEST:
+      return m_erabToBeSetupList.size ();
+    case INITIAL_CONTEXT_SETUP_RESPONSE:
+      return m_erabSetupList.size ();
+    case PATH_SWITCH_REQUEST:
+      return m_erabSwitchedInDownlinkList.size ();
+    case PATH_SWITCH_REQUEST_ACKNOWLEDGE:
+      return m_erabSwitchedInUplinkList.size ();
+    default:
+      return 0;
+    }
+}
+
+uint32_t
+EpcS1apHeader::GetSerializedSize (void) const
+{
+  uint32_t size = FIXED_SIZE;
+  if (m_messageType == INITIAL_UE_MESSAGE)
+    {
+      size += IMSI_SIZE;
+    }
+  if (m_messageType == INITIAL_CONTEXT_SETUP_REQUEST)
+    {
+      size += GetNErabs () * ERAB_TO_BE_SETUP_ITEM_SIZE;
+    }
+  else
+    {
+      size += GetNErabs () * ERAB_ITEM_SIZE;
+    }
+  return size;
+}
+
+void
+EpcS1apHeader::Serialize (Buffer::Iterator start) const
+{
+  Buffer::Iterator i = start;
+  i.WriteU8 (m_messageType);
+  i.WriteHtonU64 (m_mmeUeS1Id);
+  i.WriteHtonU64 (m_enbUeS1Id);
+  i.WriteHtonU16 (m_cellId);
+  i.WriteU8 (GetNErabs ());
+  switch (m_messageType)
+    {
+    case INITIAL_UE_MESSAGE:
+      i.WriteHtonU64 (m_imsi);
+      break;
+
+    case INITIAL_CONTEXT_SETUP_REQUEST:
+      for (EpcS1apSapEnb::ErabToBeSetupList::const_iterator it = m_erabToBeSetupList.begin ();
+           it != m_erabToBeSetupList.end ();
+           ++it)
+        {
+          const EpsBearer &bearer = it->erabLevelQosParameters;
+          i.WriteU8 (it->erabId);
+          i.WriteU8 (bearer.qci);
+          i.WriteHtonU64 (bearer.gbrQosInfo.gbrDl);
+          i.WriteHtonU64 (bearer.gbrQosInfo.gbrUl);
+          i.WriteHtonU64 (bearer.gbrQosInfo.mbrDl);
+          i.WriteHtonU64 (bearer.gbrQosInfo.mbrUl);
+          i.WriteU8 (bearer.arp.priorityLevel);
+          i.WriteU8 (bearer.arp.preemptionCapability);
+          i.WriteU8 (bearer.arp.preemptionVulnerability);
+          i.WriteHtonU32 (it->transportLayerAddress.Get ());
+          i.WriteHtonU32 (it->sgwTeid);
+        }
+      break;
+
+    case INITIAL_CONTEXT_SETUP_RESPONSE:
+      for (EpcS1apSapMme::ErabSetupList::const_iterator it = m_erabSetupList.begin ();
+           it != m_erabSetupList.end ();
+           ++it)
+        {
+          i.WriteU8 (it->erabId);
+          i.WriteHtonU32 (it->enbTransportLayerAddress.Get ());
+          i.WriteHtonU32 (it->enbTeid);
+        }
+      break;
+
+    case PATH_SWITCH_REQUEST:
+      for (EpcS1apSapMme::ErabSwitchedInDownlinkList::const_iterator it = m_erabSwitchedInDownlinkList.begin ();
+           it != m_erabSwitchedInDownlinkList.end ();
+           ++it)
+        {
+          i.WriteU8 (it->erabId);
+          i.WriteHtonU32 (it->enbTransportLayerAddress.Get ());
+          i.WriteHtonU32 (it->enbTeid);
+        }
+      break;
+
+    case PATH_SWITCH_REQUEST_ACKNOWLEDGE:
+      for (EpcS1apSapEnb::ErabSwitchedInUplinkList::const_iterator it = m_erabSwitchedInUplinkList.begin ();
+           it != m_erabSwitchedInUplinkList.end ();
+           ++it)
+        {
+          i.WriteU8 (it->erabId);
+          i.WriteHtonU32 (it->transportLayerAddress.Get ());
+          i.WriteHtonU32 (it->enbTeid);
+        }
+      break;
+
+    default:
+      NS_FATAL_ERROR ("unknown S1-AP message type " << (uint32_t) m_messageType);
+      break;
+    }
+}
+
+uint32_t
+EpcS1apHeader::Deserialize (Buffer::Iterator start)
+{
+  Buffer::Iterator i = start;
+  uint8_t messageType = i.ReadU8 ();
+  NS_ASSERT_MSG (messageType < N_MESSAGE_TYPES, "unknown S1-AP message type " << (uint32_t) messageType);
+  m_messageType = (MessageType_t) messageType;
+  m_mmeUeS1Id = i.ReadNtohU64 ();
+  m_enbUeS1Id = i.ReadNtohU64 ();
+  m_cellId = i.ReadNtohU16 ();
+  uint8_t nErabs = i.ReadU8 ();
+  m_imsi = 0;
+  m_erabToBeSetupList.clear ();
+  m_erabSetupList.clear ();
+  m_erabSwitchedInDownlinkList.clear ();
+  m_erabSwitchedInUplinkList.clear ();
+  switch (m_messageType)
+    {
+    case INITIAL_UE_MESSAGE:
+      m_imsi = i.ReadNtohU64 ();
+      break;
+
+    case INITIAL_CONTEXT_SETUP_REQUEST:
+      for (uint8_t n = 0; n < nErabs; ++n)
+        {
+          EpcS1apSapEnb::ErabToBeSetupItem erab;
+          erab.erabId = i.ReadU8 ();
+          EpsBearer &bearer = erab.erabLevelQosParameters;
+          bearer.qci = (EpsBearer::Qci) i.ReadU8 ();
+          bearer.gbrQosInfo.gbrDl = i.ReadNtohU64 ();
+          bearer.gbrQosInfo.gbrUl = i.ReadNtohU64 ();
+          bearer.gbrQosInfo.mbrDl = i.ReadNtohU64 ();
+          bearer.gbrQosInfo.mbrUl = i.ReadNtohU64 ();
+          bearer.arp.priorityLevel = i.ReadU8 ();
+          bearer.arp.preemptionCapability = i.ReadU8 ();
+          bearer.arp.preemptionVulnerability = i.ReadU8 ();
+          erab.transportLayerAddress = Ipv4Address (i.ReadNtohU32 ());
+          erab.sgwTeid = i.ReadNtohU32 ();
+          m_erabToBeSetupList.push_back (erab);
+        }
+      break;
+
+    case INITIAL_CONTEXT_SETUP_RESPONSE:
+      for (uint8_t n = 0; n < nErabs; ++n)
+        {
+          EpcS1apSapMme::ErabSetupItem erab;
+          erab.erabId = i.ReadU8 ();
+          erab.enbTransportLayerAddress = Ipv4Address (i.ReadNtohU32 ());
+          erab.enbTeid = i.ReadNtohU32 ();
+          m_erabSetupList.push_back (erab);
+        }
+      break;
+
+    case PATH_SWITCH_REQUEST:
+      for (uint8_t n = 0; n < nErabs; ++n)
+        {
+          EpcS1apSapMme::ErabSwitchedInDownlinkItem erab;
+          erab.erabId = i.ReadU8 ();
+          erab.enbTransportLayerAddress = Ipv4Address (i.ReadNtohU32 ());
+          erab.enbTeid = i.ReadNtohU32 ();
+          m_erabSwitchedInDownlinkList.push_back (erab);
+        }
+      break;
+
+    case PATH_SWITCH_REQUEST_ACKNOWLEDGE:
+      for (uint8_t n = 0; n < nErabs; ++n)
+        {
+          EpcS1apSapEnb::ErabSwitchedInUplinkItem erab;
+          erab.erabId = i.ReadU8 ();
+          erab.transportLayerAddress = Ipv4Address (i.ReadNtohU32 ());
+          erab.enbTeid = i.ReadNtohU32 ();
+          m_erabSwitchedInUplinkList.push_back (erab);
+        }
+      break;
+
+    default:
+      break;
+    }
+  return GetSerializedSize ();
+}
+
+void
+EpcS1apHeader::Print (std::ostream &os) const
+{
+  os << GetMessageTypeName (m_messageType)
+     << " mmeUeS1Id=" << m_mmeUeS1Id
+     << " enbUeS1Id=" << m_enbUeS1Id
+     << " cellId=" << m_cellId;
+  if (m_messageType == INITIAL_UE_MESSAGE)
+    {
+      os << " imsi=" << m_imsi;
+    }
+  os << " nErabs=" << GetNErabs ();
+}
+
+EpcS1apHeader::MessageType_t
+EpcS1apHeader::GetMessageType () const
+{
+  return m_messageType;
+}
+
+void
+EpcS1apHeader::SetMessageType (MessageType_t messageType)
+{
+  m_messageType = messageType;
+}
+
+uint64_t
+EpcS1apHeader::GetMmeUeS1Id () const
+{
+  return m_mmeUeS1Id;
+}
+
+void
+EpcS1apHeader::SetMmeUeS1Id (uint64_t mmeUeS1Id)
+{
+  m_mmeUeS1Id = mmeUeS1Id;
+}
+
+uint64_t
+EpcS1apHeader::GetEnbUeS1Id () const
+{
+  return m_enbUeS1Id;
+}
+
+void
+EpcS1apHeader::SetEnbUeS1Id (uint64_t enbUeS1Id)
+{
+  m_enbUeS1Id = enbUeS1Id;
+}
+
+uint64_t
+EpcS1apHeader::GetImsi () const
+{
+  return m_imsi;
+}
+
+void
+EpcS1apHeader::SetImsi (uint64_t imsi)
+{
+  m_imsi = imsi;
+}
+
+uint16_t
+EpcS1apHeader::GetCellId () const
+{
+  return m_cellId;
+}
+
+void
+EpcS1apHeader::SetCellId (uint16_t cellId)
+{
+  m_cellId = cellId;
+}
+
+const EpcS1apSapEnb::ErabToBeSetupList&
+EpcS1apHeader::GetErabToBeSetupList () const
+{
+  return m_erabToBeSetupList;
+}
+
+void
+EpcS1apHeader::SetErabToBeSetupList (const EpcS1apSapEnb::ErabToBeSetupList &erabToBeSetupList)
+{
+  m_erabToBeSetupList = erabToBeSetupList;
+}
+
+const EpcS1apSapMme::ErabSetupList&
+EpcS1apHeader::GetErabSetupList () const
+{
+  return m_erabSetupList;
+}
+
+void
+EpcS1apHeader::SetErabSetupList (const EpcS1apSapMme::ErabSetupList &erabSetupList)
+{
+  m_erabSetupList = erabSetupList;
+}
+
+const EpcS1apSapMme::ErabSwitchedInDownlinkList&
+EpcS1apHeader::GetErabSwitchedInDownlinkList () const
+{
+  return m_erabSwitchedInDownlinkList;
+}
+
+void
+EpcS1apHeader::SetErabSwitchedInDownlinkList (const EpcS1apSapMme::ErabSwitchedInDownlinkList &erabSwitchedInDownlinkList)
+{
+  m_erabSwitchedInDownlinkList = erabSwitchedInDownlinkList;
+}
+
+const EpcS1apSapEnb::ErabSwitchedInUplinkList&
+EpcS1apHeader::GetErabSwitchedInUplinkList () const
+{
+  return m_erabSwitchedInUplinkList;
+}
+
+void
+EpcS1apHeader::SetErabSwitchedInUplinkList (const EpcS1apSapEnb::ErabSwitchedInUplinkList &erabSwitchedInUplinkList)
+{
+  m_erabSwitchedInUplinkList = erabSwitchedInUplinkList;
+}
+
+} // namespace ns3
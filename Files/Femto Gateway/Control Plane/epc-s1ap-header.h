@@ -0,0 +1,116 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#ifndef EPC_S1AP_HEADER_H
+#define EPC_S1AP_HEADER_H
+
+#include <ns3/header.h>
+#include <ns3/epc-s1ap-sap.h>
+
+#include <string>
+
+namespace ns3 {
+
+/**
+ * \ingroup lte
+ *
+ * Header of an S1-AP message, carrying all the parameters of one call
+ * of the EpcS1apSapMme or of the EpcS1apSapEnb. It is not the ASN.1
+ * PER encoding of 3GPP TS 36.413, but it has the same information,
+ * with fixed size fields: the identifiers of the UE, the cell, the
+ * IMSI of the Initial UE Message and the list of E-RAB items of the
+ * message type.
+ */
+class EpcS1apHeader : public Header
+{
+public:
+  /**
+   * S1-AP message types
+   */
+  enum MessageType_t
+  {
+    INITIAL_UE_MESSAGE = 0,
+    INITIAL_CONTEXT_SETUP_REQUEST,
+    INITIAL_CONTEXT_SETUP_RESPONSE,
+    PATH_SWITCH_REQUEST,
+    PATH_SWITCH_REQUEST_ACKNOWLEDGE,
+    N_MESSAGE_TYPES
+  };
+
+  EpcS1apHeader ();
+  virtual ~EpcS1apHeader ();
+
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+  virtual uint32_t GetSerializedSize (void) const;
+  virtual void Serialize (Buffer::Iterator start) const;
+  virtual uint32_t Deserialize (Buffer::Iterator start);
+  virtual void Print (std::ostream &os) const;
+
+  /**
+   * \param messageType an S1-AP message type
+   * \return the name of the message type
+   */
+  static std::string GetMessageTypeName (MessageType_t messageType);
+
+  /**
+   * \param messageType an S1-AP message type
+   * \return true if the message is sent by the eNB to the MME
+   */
+  static bool IsForMme (MessageType_t messageType);
+
+  MessageType_t GetMessageType () const;
+  void SetMessageType (MessageType_t messageType);
+  uint64_t GetMmeUeS1Id () const;
+  void SetMmeUeS1Id (uint64_t mmeUeS1Id);
+  uint64_t GetEnbUeS1Id () const;
+  void SetEnbUeS1Id (uint64_t enbUeS1Id);
+  uint64_t GetImsi () const;
+  void SetImsi (uint64_t imsi);
+  uint16_t GetCellId () const;
+  void SetCellId (uint16_t cellId);
+
+  const EpcS1apSapEnb::ErabToBeSetupList& GetErabToBeSetupList () const;
+  void SetErabToBeSetupList (const EpcS1apSapEnb::ErabToBeSetupList &erabToBeSetupList);
+  const EpcS1apSapMme::ErabSetupList& GetErabSetupList () const;
+  void SetErabSetupList (const EpcS1apSapMme::ErabSetupList &erabSetupList);
+  const EpcS1apSapMme::ErabSwitchedInDownlinkList& GetErabSwitchedInDownlinkList () const;
+  void SetErabSwitchedInDownlinkList (const EpcS1apSapMme::ErabSwitchedInDownlinkList &erabSwitchedInDownlinkList);
+  const EpcS1apSapEnb::ErabSwitchedInUplinkList& GetErabSwitchedInUplinkList () const;
+  void SetErabSwitchedInUplinkList (const EpcS1apSapEnb::ErabSwitchedInUplinkList &erabSwitchedInUplinkList);
+
+private:
+  /**
+   * \return the number of E-RAB items of the message type
+   */
+  uint32_t GetNErabs () const;
+
+  MessageType_t m_messageType;
+  uint64_t m_mmeUeS1Id;
+  uint64_t m_enbUeS1Id;
+  uint64_t m_imsi;
+  uint16_t m_cellId;
+
+  // only the list of the message type is serialized
+  EpcS1apSapEnb::ErabToBeSetupList m_erabToBeSetupList;
+  EpcS1apSapMme::ErabSetupList m_erabSetupList;
+  EpcS1apSapMme::ErabSwitchedInDownlinkList m_erabSwitchedInDownlinkList;
+  EpcS1apSapEnb::ErabSwitchedInUplinkList m_erabSwitchedInUplinkList;
+};
+
+} // namespace ns3
+
+#endif // EPC_S1AP_HEADER_H
@@ -26,11 +26,82 @@
 #include <ns3/object.h>
 #include <ns3/eps-bearer.h>
 #include <ns3/epc-tft.h>
-#include <list>
+#include <ns3/assert.h>
 
 
 namespace ns3 {
 
+/**
+ * \ingroup lte
+ *
+ * List of the E-RAB items of an S1-AP message. A UE has at most 11
+ * E-RABs, so the items are stored inline: building, copying and
+ * passing a list does not allocate memory. It has the subset of the
+ * std::list interface used by the S1-AP entities.
+ */
+template <class T>
+class EpcS1apErabList
+{
+public:
+  /**
+   * maximum number of E-RABs of a UE
+   */
+  static const uint32_t MAX_ERABS = 11;
+
+  typedef T* iterator;
+  typedef const T* const_iterator;
+
+  EpcS1apErabList ()
+    : m_size (0)
+  {
+  }
+
+  void push_back (const T &item)
+  {
+    NS_ASSERT_MSG (m_size < MAX_ERABS, "too many E-RABs");
+    m_items[m_size++] = item;
+  }
+
+  void clear ()
+  {
+    m_size = 0;
+  }
+
+  uint32_t size () const
+  {
+    return m_size;
+  }
+
+  bool empty () const
+  {
+    return m_size == 0;
+  }
+
+  iterator begin ()
+  {
+    return m_items;
+  }
+
+  iterator end ()
+  {
+    return m_items + m_size;
+  }
+
+  const_iterator begin () const
+  {
+    return m_items;
+  }
+
+  const_iterator end () const
+  {
+    return m_items + m_size;
+  }
+
+private:
+  T m_items[MAX_ERABS];
+  uint32_t m_size;
+};
+
 class EpcS1apSap
 {
 public:
@@ -71,6 +142,8 @@ public:
     uint32_t    enbTeid;    
   };
 
+  typedef EpcS1apErabList<ErabSetupItem> ErabSetupList;
+
   /** 
    * INITIAL CONTEXT SETUP RESPONSE message,  see 3GPP TS 36.413 9.1.4.2 
    * 
@@ -79,7 +152,7 @@ public:
    * \param ecgi in practice, the cell Id
    * 
    */
-  virtual void InitialContextSetupResponse (uint64_t mmeUeS1Id, uint16_t enbUeS1Id, std::list<ErabSetupItem> erabSetupList) = 0;
+  virtual void InitialContextSetupResponse (uint64_t mmeUeS1Id, uint16_t enbUeS1Id, const ErabSetupList &erabSetupList) = 0;
 
 
   /**
@@ -93,21 +166,15 @@ public:
     uint32_t    enbTeid;    
   };
 
+  typedef EpcS1apErabList<ErabSwitchedInDownlinkItem> ErabSwitchedInDownlinkList;
+
   /**
    * PATH SWITCH REQUEST message, see 3GPP TS 36.413 9.1.5.8
    * 
    */
-  virtual void PathSwitchRequest (uint64_t enbUeS1Id, uint64_t mmeUeS1Id, uint16_t gci, std::list<ErabSwitchedInDownlinkItem> erabToBeSwitchedInDownlinkList) = 0;
+  virtual void PathSwitchRequest (uint64_t enbUeS1Id, uint64_t mmeUeS1Id, uint16_t gci, const ErabSwitchedInDownlinkList &erabToBeSwitchedInDownlinkList) = 0;
 };
 
-class EpcS1apSapGW : public EpcS1apSap
-{
-    virtual void InitialUeMessage (uint64_t mmeUeS1Id, uint16_t enbUeS1Id, uint64_t imsi, uint16_t ecgi) = 0;
-    virtual void PathSwitchRequest (uint64_t enbUeS1Id, uint64_t mmeUeS1Id, uint16_t gci, std::list<ErabSwitchedInDownlinkItem> erabToBeSwitchedInDownlinkList) = 0;     
-    virtual void InitialContextSetupRequest (uint64_t mmeUeS1Id, uint16_t enbUeS1Id, std::list<ErabToBeSetupItem> erabToBeSetupList);
-    virtual void PathSwitchRequestAcknowledge (uint64_t enbUeS1Id, uint64_t mmeUeS1Id, uint16_t cgi, std::list<ErabSwitchedInUplinkItem> erabToBeSwitchedInUplinkList);
-}
-
 /**
  * \ingroup lte
  *
@@ -127,6 +194,8 @@ public:
     uint32_t    sgwTeid;    
   };
 
+  typedef EpcS1apErabList<ErabToBeSetupItem> ErabToBeSetupList;
+
   /** 
    * 
    * 
@@ -135,7 +204,7 @@ public:
    * \param ecgi in practice, the cell Id
    * 
    */
-  virtual void InitialContextSetupRequest (uint64_t mmeUeS1Id, uint16_t enbUeS1Id, std::list<ErabToBeSetupItem> erabToBeSetupList) = 0;
+  virtual void InitialContextSetupRequest (uint64_t mmeUeS1Id, uint16_t enbUeS1Id, const ErabToBeSetupList &erabToBeSetupList) = 0;
 
 
   /**
@@ -149,11 +218,13 @@ public:
     uint32_t    enbTeid;    
   };
 
+  typedef EpcS1apErabList<ErabSwitchedInUplinkItem> ErabSwitchedInUplinkList;
+
   /**
    * PATH SWITCH REQUEST ACKNOWLEDGE message, see 3GPP TS 36.413 9.1.5.9
    * 
    */
-  virtual void PathSwitchRequestAcknowledge (uint64_t enbUeS1Id, uint64_t mmeUeS1Id, uint16_t cgi, std::list<ErabSwitchedInUplinkItem> erabToBeSwitchedInUplinkList) = 0;
+  virtual void PathSwitchRequestAcknowledge (uint64_t enbUeS1Id, uint64_t mmeUeS1Id, uint16_t cgi, const ErabSwitchedInUplinkList &erabToBeSwitchedInUplinkList) = 0;
 
 
 };
@@ -172,8 +243,8 @@ public:
 
   // inherited from EpcS1apSapMme
   virtual void InitialUeMessage (uint64_t mmeUeS1Id, uint16_t enbUeS1Id, uint64_t imsi, uint16_t ecgi);
-  virtual void InitialContextSetupResponse (uint64_t mmeUeS1Id, uint16_t enbUeS1Id, std::list<ErabSetupItem> erabSetupList);
-  virtual void PathSwitchRequest (uint64_t enbUeS1Id, uint64_t mmeUeS1Id, uint16_t cgi, std::list<ErabSwitchedInDownlinkItem> erabToBeSwitchedInDownlinkList);
+  virtual void InitialContextSetupResponse (uint64_t mmeUeS1Id, uint16_t enbUeS1Id, const ErabSetupList &erabSetupList);
+  virtual void PathSwitchRequest (uint64_t enbUeS1Id, uint64_t mmeUeS1Id, uint16_t cgi, const ErabSwitchedInDownlinkList &erabToBeSwitchedInDownlinkList);
 
 private:
   MemberEpcS1apSapMme ();
@@ -198,58 +269,17 @@ void MemberEpcS1apSapMme<C>::InitialUeMessage (uint64_t mmeUeS1Id, uint16_t enbU
 }
 
 template <class C>
-void MemberEpcS1apSapMme<C>::InitialContextSetupResponse (uint64_t mmeUeS1Id, uint16_t enbUeS1Id, std::list<ErabSetupItem> erabSetupList)
+void MemberEpcS1apSapMme<C>::InitialContextSetupResponse (uint64_t mmeUeS1Id, uint16_t enbUeS1Id, const ErabSetupList &erabSetupList)
 {
   m_owner->DoInitialContextSetupResponse (mmeUeS1Id, enbUeS1Id, erabSetupList);
 }
 
 template <class C>
-void MemberEpcS1apSapMme<C>::PathSwitchRequest (uint64_t enbUeS1Id, uint64_t mmeUeS1Id, uint16_t cgi, std::list<ErabSwitchedInDownlinkItem> erabToBeSwitchedInDownlinkList)
-{
-  m_owner->DoPathSwitchRequest (enbUeS1Id, mmeUeS1Id, cgi, erabToBeSwitchedInDownlinkList);
-}
-
-
-template <class C>
-class MemberEpcS1apSapGW : public EpcS1apSapGW
-{
-public:
-  MemberEpcS1apSapGW (C* owner);
-
-  // inherited from EpcS1apSapMme
-  virtual void InitialUeMessage (uint64_t mmeUeS1Id, uint16_t enbUeS1Id, uint64_t imsi, uint16_t ecgi);
-  virtual void PathSwitchRequest (uint64_t enbUeS1Id, uint64_t mmeUeS1Id, uint16_t cgi, std::list<ErabSwitchedInDownlinkItem> erabToBeSwitchedInDownlinkList);
-  virtual void InitialContextSetupRequest (uint64_t mmeUeS1Id, uint16_t enbUeS1Id, std::list<ErabToBeSetupItem> erabToBeSetupList);
-  virtual void PathSwitchRequestAcknowledge (uint64_t enbUeS1Id, uint64_t mmeUeS1Id, uint16_t cgi, std::list<ErabSwitchedInUplinkItem> erabToBeSwitchedInUplinkList);
-
-private:
-  MemberEpcS1apSapGW ();
-  C* m_owner;
-};
-
-template <class C>
-void MemberEpcS1apSapGW<C>::PathSwitchRequest (uint64_t enbUeS1Id, uint64_t mmeUeS1Id, uint16_t cgi, std::list<ErabSwitchedInDownlinkItem> erabToBeSwitchedInDownlinkList)
+void MemberEpcS1apSapMme<C>::PathSwitchRequest (uint64_t enbUeS1Id, uint64_t mmeUeS1Id, uint16_t cgi, const ErabSwitchedInDownlinkList &erabToBeSwitchedInDownlinkList)
 {
   m_owner->DoPathSwitchRequest (enbUeS1Id, mmeUeS1Id, cgi, erabToBeSwitchedInDownlinkList);
 }
 
-template <class C>
-void MemberEpcS1apSapGW<C>::InitialUeMessage (uint64_t mmeUeS1Id, uint16_t enbUeS1Id, uint64_t imsi, uint16_t ecgi)
-{
-  m_owner->DoInitialUeMessage (mmeUeS1Id, enbUeS1Id, imsi, ecgi);
-}
-
-template <class C>
-void MemberEpcS1apSapGW<C>::InitialContextSetupRequest (uint64_t mmeUeS1Id, uint16_t enbUeS1Id, std::list<ErabToBeSetupItem> erabToBeSetupList)
-{
-  m_owner->DoInitialContextSetupRequest (mmeUeS1Id, enbUeS1Id, erabToBeSetupList);
-}
-
-template <class C>
-void MemberEpcS1apSapGW<C>::PathSwitchRequestAcknowledge (uint64_t enbUeS1Id, uint64_t mmeUeS1Id, uint16_t cgi, std::list<ErabSwitchedInUplinkItem> erabToBeSwitchedInUplinkList)
-{
-  m_owner->DoPathSwitchRequestAcknowledge (enbUeS1Id, mmeUeS1Id, cgi, erabToBeSwitchedInUplinkList);
-}
 
 /**
  * Template for the implementation of the EpcS1apSapEnb as a member
@@ -263,8 +293,8 @@ public:
   MemberEpcS1apSapEnb (C* owner);
 
   // inherited from EpcS1apSapEnb
-  virtual void InitialContextSetupRequest (uint64_t mmeUeS1Id, uint16_t enbUeS1Id, std::list<ErabToBeSetupItem> erabToBeSetupList);
-  virtual void PathSwitchRequestAcknowledge (uint64_t enbUeS1Id, uint64_t mmeUeS1Id, uint16_t cgi, std::list<ErabSwitchedInUplinkItem> erabToBeSwitchedInUplinkList);
+  virtual void InitialContextSetupRequest (uint64_t mmeUeS1Id, uint16_t enbUeS1Id, const ErabToBeSetupList &erabToBeSetupList);
+  virtual void PathSwitchRequestAcknowledge (uint64_t enbUeS1Id, uint64_t mmeUeS1Id, uint16_t cgi, const ErabSwitchedInUplinkList &erabToBeSwitchedInUplinkList);
 
 private:
   MemberEpcS1apSapEnb ();
@@ -283,13 +313,13 @@ MemberEpcS1apSapEnb<C>::MemberEpcS1apSapEnb ()
 }
 
 template <class C>
-void MemberEpcS1apSapEnb<C>::InitialContextSetupRequest (uint64_t mmeUeS1Id, uint16_t enbUeS1Id, std::list<ErabToBeSetupItem> erabToBeSetupList)
+void MemberEpcS1apSapEnb<C>::InitialContextSetupRequest (uint64_t mmeUeS1Id, uint16_t enbUeS1Id, const ErabToBeSetupList &erabToBeSetupList)
 {
   m_owner->DoInitialContextSetupRequest (mmeUeS1Id, enbUeS1Id, erabToBeSetupList);
 }
 
 template <class C>
-void MemberEpcS1apSapEnb<C>::PathSwitchRequestAcknowledge (uint64_t enbUeS1Id, uint64_t mmeUeS1Id, uint16_t cgi, std::list<ErabSwitchedInUplinkItem> erabToBeSwitchedInUplinkList)
+void MemberEpcS1apSapEnb<C>::PathSwitchRequestAcknowledge (uint64_t enbUeS1Id, uint64_t mmeUeS1Id, uint16_t cgi, const ErabSwitchedInUplinkList &erabToBeSwitchedInUplinkList)
 {
   m_owner->DoPathSwitchRequestAcknowledge (enbUeS1Id, mmeUeS1Id, cgi, erabToBeSwitchedInUplinkList);
 }
@@ -0,0 +1,312 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#include "epc-s1ap-transport.h"
+#include "ns3/log.h"
+#include "ns3/packet.h"
+#include "ns3/inet-socket-address.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("EpcS1apTransport");
+
+NS_OBJECT_ENSURE_REGISTERED (EpcS1apTransport);
+
+
+RemoteEpcS1apSapMme::RemoteEpcS1apSapMme (EpcS1apTransport* transport, Ipv4Address peerAddress)
+  : m_transport (transport),
+    m_peerAddress (peerAddress)
+{
+}
+
+RemoteEpcS1apSapMme::RemoteEpcS1apSapMme ()
+{
+}
+
+void
+RemoteEpcS1apSapMme::InitialUeMessage (uint64_t mmeUeS1Id, uint16_t enbUeS1Id, uint64_t imsi, uint16_t ecgi)
+{
+  EpcS1apHeader header;
+  header.SetMessageType (EpcS1apHeader::INITIAL_UE_MESSAGE);
+  header.SetMmeUeS1Id (mmeUeS1Id);
+  header.SetEnbUeS1Id (enbUeS1Id);
+  header.SetImsi (imsi);
+  header.SetCellId (ecgi);
+  m_transport->Send (header, m_peerAddress);
+}
+
+void
+RemoteEpcS1apSapMme::InitialContextSetupResponse (uint64_t mmeUeS1Id, uint16_t enbUeS1Id, const ErabSetupList &erabSetupList)
+{
+  EpcS1apHeader header;
+  header.SetMessageType (EpcS1apHeader::INITIAL_CONTEXT_SETUP_RESPONSE);
+  header.SetMmeUeS1Id (mmeUeS1Id);
+  header.SetEnbUeS1Id (enbUeS1Id);
+  header.SetErabSetupList (erabSetupList);
+  m_transport->Send (header, m_peerAddress);
+}
+
+void
+RemoteEpcS1apSapMme::PathSwitchRequest (uint64_t enbUeS1Id, uint64_t mmeUeS1Id, uint16_t cgi, const ErabSwitchedInDownlinkList &erabToBeSwitchedInDownlinkList)
+{
+  EpcS1apHeader header;
+  header.SetMessageType (EpcS1apHeader::PATH_SWITCH_REQUEST);
+  header.SetMmeUeS1Id (mmeUeS1Id);
+  header.SetEnbUeS1Id (enbUeS1Id);
+  header.SetCellId (cgi);
+  header.SetErabSwitchedInDownlinkList (erabToBeSwitchedInDownlinkList);
+  m_transport->Send (header, m_peerAddress);
+}
+
+
+RemoteEpcS1apSapEnb::RemoteEpcS1apSapEnb (EpcS1apTransport* transport, Ipv4Address peerAddress)
+  : m_transport (transport),
+    m_peerAddress (peerAddress)
+{
+}
+
+RemoteEpcS1apSapEnb::RemoteEpcS1apSapEnb ()
+{
+}
+
+void
+RemoteEpcS1apSapEnb::InitialContextSetupRequest (uint64_t mmeUeS1Id, uint16_t enbUeS1Id, const ErabToBeSetupList &erabToBeSetupList)
+{
+  EpcS1apHeader header;
+  header.SetMessageType (EpcS1apHeader::INITIAL_CONTEXT_SETUP_REQUEST);
+  header.SetMmeUeS1Id (mmeUeS1Id);
+  header.SetEnbUeS1Id (enbUeS1Id);
+  header.SetErabToBeSetupList (erabToBeSetupList);
+  m_transport->Send (header, m_peerAddress);
+}
+
+void
+RemoteEpcS1apSapEnb::PathSwitchRequestAcknowledge (uint64_t enbUeS1Id, uint64_t mmeUeS1Id, uint16_t cgi, const ErabSwitchedInUplinkList &erabToBeSwitchedInUplinkList)
+{
+  EpcS1apHeader header;
+  header.SetMessageType (EpcS1apHeader::PATH_SWITCH_REQUEST_ACKNOWLEDGE);
+  header.SetMmeUeS1Id (mmeUeS1Id);
+  header.SetEnbUeS1Id (enbUeS1Id);
+  header.SetCellId (cgi);
+  header.SetErabSwitchedInUplinkList (erabToBeSwitchedInUplinkList);
+  m_transport->Send (header, m_peerAddress);
+}
+
+
+TypeId
+EpcS1apTransport::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::EpcS1apTransport")
+    .SetParent<Object> ()
+    .AddTraceSource ("Tx",
+                     "An S1-AP message is sent: message type and size in bytes",
+                     MakeTraceSourceAccessor (&EpcS1apTransport::m_txTrace))
+    .AddTraceSource ("Rx",
+                     "An S1-AP message is received: message type and size in bytes",
+                     MakeTraceSourceAccessor (&EpcS1apTransport::m_rxTrace))
+  ;
+  return tid;
+}
+
+EpcS1apTransport::EpcS1apTransport (Ptr<Socket> socket, uint16_t port)
+  : m_s1apSocket (socket),
+    m_s1apUdpPort (port),
+    m_s1apSapMme (0),
+    m_s1apSapEnb (0)
+{
+  NS_LOG_FUNCTION (this << socket << port);
+  for (uint32_t i = 0; i < EpcS1apHeader::N_MESSAGE_TYPES; ++i)
+    {
+      m_nTxMessages[i] = 0;
+      m_txBytes[i] = 0;
+      m_nRxMessages[i] = 0;
+      m_rxBytes[i] = 0;
+    }
+  m_s1apSocket->SetRecvCallback (MakeCallback (&EpcS1apTransport::RecvFromS1apSocket, this));
+}
+
+EpcS1apTransport::~EpcS1apTransport ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+EpcS1apTransport::DoDispose ()
+{
+  NS_LOG_FUNCTION (this);
+  for (std::map<Ipv4Address, RemoteEpcS1apSapMme*>::iterator it = m_remoteS1apSapMmeMap.begin ();
+       it != m_remoteS1apSapMmeMap.end ();
+       ++it)
+    {
+      delete it->second;
+    }
+  m_remoteS1apSapMmeMap.clear ();
+  for (std::map<Ipv4Address, RemoteEpcS1apSapEnb*>::iterator it = m_remoteS1apSapEnbMap.begin ();
+       it != m_remoteS1apSapEnbMap.end ();
+       ++it)
+    {
+      delete it->second;
+    }
+  m_remoteS1apSapEnbMap.clear ();
+  m_s1apSocket = 0;
+  m_s1apSapMme = 0;
+  m_s1apSapEnb = 0;
+}
+
+void
+EpcS1apTransport::SetS1apSapMme (EpcS1apSapMme * s)
+{
+  m_s1apSapMme = s;
+}
+
+void
+EpcS1apTransport::SetS1apSapEnb (EpcS1apSapEnb * s)
+{
+  m_s1apSapEnb = s;
+}
+
+EpcS1apSapMme*
+EpcS1apTransport::GetS1apSapMme (Ipv4Address peerAddress)
+{
+  std::map<Ipv4Address, RemoteEpcS1apSapMme*>::iterator it = m_remoteS1apSapMmeMap.find (peerAddress);
+  if (it == m_remoteS1apSapMmeMap.end ())
+    {
+      it = m_remoteS1apSapMmeMap.insert (std::make_pair (peerAddress, new RemoteEpcS1apSapMme (this, peerAddress))).first;
+    }
+  return it->second;
+}
+
+EpcS1apSapEnb*
+EpcS1apTransport::GetS1apSapEnb (Ipv4Address peerAddress)
+{
+  std::map<Ipv4Address, RemoteEpcS1apSapEnb*>::iterator it = m_remoteS1apSapEnbMap.find (peerAddress);
+  if (it == m_remoteS1apSapEnbMap.end ())
+    {
+      it = m_remoteS1apSapEnbMap.insert (std::make_pair (peerAddress, new RemoteEpcS1apSapEnb (this, peerAddress))).first;
+    }
+  return it->second;
+}
+
+uint64_t
+EpcS1apTransport::GetNTxMessages (EpcS1apHeader::MessageType_t messageType) const
+{
+  NS_ASSERT (messageType < EpcS1apHeader::N_MESSAGE_TYPES);
+  return m_nTxMessages[messageType];
+}
+
+uint64_t
+EpcS1apTransport::GetTxBytes (EpcS1apHeader::MessageType_t messageType) const
+{
+  NS_ASSERT (messageType < EpcS1apHeader::N_MESSAGE_TYPES);
+  return m_txBytes[messageType];
+}
+
+uint64_t
+EpcS1apTransport::GetNRxMessages (EpcS1apHeader::MessageType_t messageType) const
+{
+  NS_ASSERT (messageType < EpcS1apHeader::N_MESSAGE_TYPES);
+  return m_nRxMessages[messageType];
+}
+
+uint64_t
+EpcS1apTransport::GetRxBytes (EpcS1apHeader::MessageType_t messageType) const
+{
+  NS_ASSERT (messageType < EpcS1apHeader::N_MESSAGE_TYPES);
+  return m_rxBytes[messageType];
+}
+
+void
+EpcS1apTransport::Print (std::ostream &os) const
+{
+  for (uint32_t i = 0; i < EpcS1apHeader::N_MESSAGE_TYPES; ++i)
+    {
+      os << EpcS1apHeader::GetMessageTypeName ((EpcS1apHeader::MessageType_t) i)
+         << ": tx " << m_nTxMessages[i] << " (" << m_txBytes[i] << " bytes)"
+         << ", rx " << m_nRxMessages[i] << " (" << m_rxBytes[i] << " bytes)"
+         << std::endl;
+    }
+}
+
+void
+EpcS1apTransport::Send (const EpcS1apHeader &header, Ipv4Address peerAddress)
+{
+  NS_LOG_FUNCTION (this << peerAddress);
+  Ptr<Packet> packet = Create<Packet> ();
+  packet->AddHeader (header);
+  uint32_t size = packet->GetSize ();
+  EpcS1apHeader::MessageType_t messageType = header.GetMessageType ();
+  NS_LOG_LOGIC ("sending " << EpcS1apHeader::GetMessageTypeName (messageType) << " (" << size << " bytes) to " << peerAddress);
+  ++m_nTxMessages[messageType];
+  m_txBytes[messageType] += size;
+  m_txTrace (messageType, size);
+  m_s1apSocket->SendTo (packet, 0, InetSocketAddress (peerAddress, m_s1apUdpPort));
+}
+
+void
+EpcS1apTransport::RecvFromS1apSocket (Ptr<Socket> socket)
+{
+  NS_LOG_FUNCTION (this << socket);
+  NS_ASSERT (socket == m_s1apSocket);
+  Ptr<Packet> packet;
+  while ((packet = socket->Recv ()) != 0)
+    {
+      uint32_t size = packet->GetSize ();
+      EpcS1apHeader header;
+      packet->RemoveHeader (header);
+      EpcS1apHeader::MessageType_t messageType = header.GetMessageType ();
+      NS_LOG_LOGIC ("received " << EpcS1apHeader::GetMessageTypeName (messageType) << " (" << size << " bytes)");
+      ++m_nRxMessages[messageType];
+      m_rxBytes[messageType] += size;
+      m_rxTrace (messageType, size);
+      if (EpcS1apHeader::IsForMme (messageType))
+        {
+          NS_ASSERT_MSG (m_s1apSapMme != 0, "S1-AP message for the MME received by a node without MME side");
+        }
+      else
+        {
+          NS_ASSERT_MSG (m_s1apSapEnb != 0, "S1-AP message for the eNB received by a node without eNB side");
+        }
+
+      switch (messageType)
+        {
+        case EpcS1apHeader::INITIAL_UE_MESSAGE:
+          m_s1apSapMme->InitialUeMessage (header.GetMmeUeS1Id (), header.GetEnbUeS1Id (), header.GetImsi (), header.GetCellId ());
+          break;
+
+        case EpcS1apHeader::INITIAL_CONTEXT_SETUP_RESPONSE:
+          m_s1apSapMme->InitialContextSetupResponse (header.GetMmeUeS1Id (), header.GetEnbUeS1Id (), header.GetErabSetupList ());
+          break;
+
+        case EpcS1apHeader::PATH_SWITCH_REQUEST:
+          m_s1apSapMme->PathSwitchRequest (header.GetEnbUeS1Id (), header.GetMmeUeS1Id (), header.GetCellId (), header.GetErabSwitchedInDownlinkList ());
+          break;
+
+        case EpcS1apHeader::INITIAL_CONTEXT_SETUP_REQUEST:
+          m_s1apSapEnb->InitialContextSetupRequest (header.GetMmeUeS1Id (), header.GetEnbUeS1Id (), header.GetErabToBeSetupList ());
+          break;
+
+        case EpcS1apHeader::PATH_SWITCH_REQUEST_ACKNOWLEDGE:
+          m_s1apSapEnb->PathSwitchRequestAcknowledge (header.GetEnbUeS1Id (), header.GetMmeUeS1Id (), header.GetCellId (), header.GetErabSwitchedInUplinkList ());
+          break;
+
+        default:
+          NS_FATAL_ERROR ("unknown S1-AP message type " << (uint32_t) messageType);
+          break;
+        }
+    }
+}
+
+} // namespace ns3
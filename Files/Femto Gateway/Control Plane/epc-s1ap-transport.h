@@ -0,0 +1,224 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#ifndef EPC_S1AP_TRANSPORT_H
+#define EPC_S1AP_TRANSPORT_H
+
+#include <ns3/object.h>
+#include <ns3/ptr.h>
+#include <ns3/socket.h>
+#include <ns3/ipv4-address.h>
+#include <ns3/traced-callback.h>
+#include <ns3/epc-s1ap-sap.h>
+#include <ns3/epc-s1ap-header.h>
+
+#include <map>
+#include <ostream>
+
+namespace ns3 {
+
+class EpcS1apTransport;
+
+/**
+ * \ingroup lte
+ *
+ * MME side of the S1-AP SAP of a remote node: each call is sent as an
+ * S1-AP message to the peer by the EpcS1apTransport which owns it.
+ */
+class RemoteEpcS1apSapMme : public EpcS1apSapMme
+{
+public:
+  RemoteEpcS1apSapMme (EpcS1apTransport* transport, Ipv4Address peerAddress);
+
+  // inherited from EpcS1apSapMme
+  virtual void InitialUeMessage (uint64_t mmeUeS1Id, uint16_t enbUeS1Id, uint64_t imsi, uint16_t ecgi);
+  virtual void InitialContextSetupResponse (uint64_t mmeUeS1Id, uint16_t enbUeS1Id, const ErabSetupList &erabSetupList);
+  virtual void PathSwitchRequest (uint64_t enbUeS1Id, uint64_t mmeUeS1Id, uint16_t cgi, const ErabSwitchedInDownlinkList &erabToBeSwitchedInDownlinkList);
+
+private:
+  RemoteEpcS1apSapMme ();
+  EpcS1apTransport* m_transport;
+  Ipv4Address m_peerAddress;
+};
+
+/**
+ * \ingroup lte
+ *
+ * eNB side of the S1-AP SAP of a remote node: each call is sent as an
+ * S1-AP message to the peer by the EpcS1apTransport which owns it.
+ */
+class RemoteEpcS1apSapEnb : public EpcS1apSapEnb
+{
+public:
+  RemoteEpcS1apSapEnb (EpcS1apTransport* transport, Ipv4Address peerAddress);
+
+  // inherited from EpcS1apSapEnb
+  virtual void InitialContextSetupRequest (uint64_t mmeUeS1Id, uint16_t enbUeS1Id, const ErabToBeSetupList &erabToBeSetupList);
+  virtual void PathSwitchRequestAcknowledge (uint64_t enbUeS1Id, uint64_t mmeUeS1Id, uint16_t cgi, const ErabSwitchedInUplinkList &erabToBeSwitchedInUplinkList);
+
+private:
+  RemoteEpcS1apSapEnb ();
+  EpcS1apTransport* m_transport;
+  Ipv4Address m_peerAddress;
+};
+
+
+/**
+ * \ingroup lte
+ *
+ * S1-AP endpoint of a node (eNB, femto gateway or the node of the
+ * MME). It replaces the direct calls between the S1-AP entities with
+ * S1-AP messages (EpcS1apHeader) sent over UDP: the local entities are
+ * given the SAPs of the remote ones returned by GetS1apSapMme and
+ * GetS1apSapEnb, whose calls are serialized and sent to the peer, and
+ * the messages received are delivered to the local SAPs. The messages
+ * for the MME are delivered to the local MME side SAP, the others to
+ * the local eNB side SAP; the femto gateway has both.
+ *
+ * ns-3 has no SCTP, so the messages are UDP datagrams; over the
+ * point-to-point S1 links they are neither lost nor reordered.
+ */
+class EpcS1apTransport : public Object
+{
+  friend class RemoteEpcS1apSapMme;
+  friend class RemoteEpcS1apSapEnb;
+
+public:
+  /**
+   * Constructor
+   *
+   * \param socket the UDP socket of the node, bound to the S1-AP port
+   * \param port the S1-AP port of the peers
+   */
+  EpcS1apTransport (Ptr<Socket> socket, uint16_t port);
+
+  /**
+   * Destructor
+   */
+  virtual ~EpcS1apTransport ();
+
+  // inherited from Object
+  static TypeId GetTypeId (void);
+protected:
+  virtual void DoDispose ();
+
+public:
+  /**
+   * Set the local MME side of the S1-AP SAP, to which the messages for
+   * the MME are delivered
+   *
+   * \param s the MME side of the S1-AP SAP of the MME or of the femto gateway
+   */
+  void SetS1apSapMme (EpcS1apSapMme * s);
+
+  /**
+   * Set the local eNB side of the S1-AP SAP, to which the messages for
+   * the eNB are delivered
+   *
+   * \param s the eNB side of the S1-AP SAP of the eNB or of the femto gateway
+   */
+  void SetS1apSapEnb (EpcS1apSapEnb * s);
+
+  /**
+   * \param peerAddress the address of the node of the MME (or of the
+   * femto gateway)
+   * \return the MME side of the S1-AP SAP of the peer, whose calls are
+   * sent to it
+   */
+  EpcS1apSapMme* GetS1apSapMme (Ipv4Address peerAddress);
+
+  /**
+   * \param peerAddress the address of an eNB (or of the femto gateway)
+   * \return the eNB side of the S1-AP SAP of the peer, whose calls are
+   * sent to it
+   */
+  EpcS1apSapEnb* GetS1apSapEnb (Ipv4Address peerAddress);
+
+  /**
+   * \param messageType an S1-AP message type
+   * \return the number of messages of this type sent by the node
+   */
+  uint64_t GetNTxMessages (EpcS1apHeader::MessageType_t messageType) const;
+
+  /**
+   * \param messageType an S1-AP message type
+   * \return the bytes of S1-AP messages of this type sent by the node
+   */
+  uint64_t GetTxBytes (EpcS1apHeader::MessageType_t messageType) const;
+
+  /**
+   * \param messageType an S1-AP message type
+   * \return the number of messages of this type received by the node
+   */
+  uint64_t GetNRxMessages (EpcS1apHeader::MessageType_t messageType) const;
+
+  /**
+   * \param messageType an S1-AP message type
+   * \return the bytes of S1-AP messages of this type received by the node
+   */
+  uint64_t GetRxBytes (EpcS1apHeader::MessageType_t messageType) const;
+
+  /**
+   * Print the messages and bytes sent and received, per message type
+   *
+   * \param os the output stream
+   */
+  void Print (std::ostream &os) const;
+
+  /**
+   * Method to be assigned to the recv callback of the S1-AP socket
+   *
+   * \param socket pointer to the S1-AP socket
+   */
+  void RecvFromS1apSocket (Ptr<Socket> socket);
+
+private:
+  /**
+   * Send an S1-AP message
+   *
+   * \param header the message
+   * \param peerAddress the address of the node it is sent to
+   */
+  void Send (const EpcS1apHeader &header, Ipv4Address peerAddress);
+
+  Ptr<Socket> m_s1apSocket;
+  uint16_t m_s1apUdpPort;
+
+  EpcS1apSapMme* m_s1apSapMme;
+  EpcS1apSapEnb* m_s1apSapEnb;
+
+  /**
+   * SAPs of the peers, by address
+   */
+  std::map<Ipv4Address, RemoteEpcS1apSapMme*> m_remoteS1apSapMmeMap;
+  std::map<Ipv4Address, RemoteEpcS1apSapEnb*> m_remoteS1apSapEnbMap;
+
+  uint64_t m_nTxMessages[EpcS1apHeader::N_MESSAGE_TYPES];
+  uint64_t m_txBytes[EpcS1apHeader::N_MESSAGE_TYPES];
+  uint64_t m_nRxMessages[EpcS1apHeader::N_MESSAGE_TYPES];
+  uint64_t m_rxBytes[EpcS1apHeader::N_MESSAGE_TYPES];
+
+  /**
+   * The `Tx` and `Rx` trace sources, fired when an S1-AP message is
+   * sent or received. Exporting the message type and its size in bytes.
+   */
+  TracedCallback<uint8_t, uint32_t> m_txTrace;
+  TracedCallback<uint8_t, uint32_t> m_rxTrace;
+};
+
+} // namespace ns3
+
+#endif // EPC_S1AP_TRANSPORT_H
@@ -0,0 +1,253 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#include "epc-s1u-direct-socket.h"
+#include "ns3/log.h"
+#include "ns3/node.h"
+#include "ns3/simulator.h"
+#include "ns3/inet-socket-address.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("EpcS1uDirectSocket");
+
+NS_OBJECT_ENSURE_REGISTERED (EpcS1uDirectSocket);
+
+
+TypeId
+EpcS1uDirectSocket::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::EpcS1uDirectSocket")
+    .SetParent<Socket> ()
+    ;
+  return tid;
+}
+
+EpcS1uDirectSocket::EpcS1uDirectSocket (Ptr<Socket> udpSocket)
+  : m_rxAvailable (0),
+    m_udpSocket (udpSocket)
+{
+  NS_LOG_FUNCTION (this << udpSocket);
+  m_udpSocket->SetRecvCallback (MakeCallback (&EpcS1uDirectSocket::RecvFromUdpSocket, this));
+}
+
+EpcS1uDirectSocket::~EpcS1uDirectSocket ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+EpcS1uDirectSocket::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  // the linked sockets point to each other
+  m_peers.clear ();
+  m_rxQueue.clear ();
+  m_udpSocket = 0;
+  Socket::DoDispose ();
+}
+
+void
+EpcS1uDirectSocket::Link (Ptr<EpcS1uDirectSocket> a, Ipv4Address aAddress,
+                          Ptr<EpcS1uDirectSocket> b, Ipv4Address bAddress,
+                          Time delay)
+{
+  NS_LOG_FUNCTION (a << aAddress << b << bAddress << delay);
+  NS_ASSERT_MSG (a->m_peers.find (bAddress) == a->m_peers.end (), "already linked to " << bAddress);
+  NS_ASSERT_MSG (b->m_peers.find (aAddress) == b->m_peers.end (), "already linked to " << aAddress);
+  Address aSockName;
+  a->GetSockName (aSockName);
+  Address bSockName;
+  b->GetSockName (bSockName);
+  Peer peerOfA;
+  peerOfA.socket = b;
+  peerOfA.localAddress = InetSocketAddress (aAddress, InetSocketAddress::ConvertFrom (aSockName).GetPort ());
+  peerOfA.delay = delay;
+  a->m_peers[bAddress] = peerOfA;
+  Peer peerOfB;
+  peerOfB.socket = a;
+  peerOfB.localAddress = InetSocketAddress (bAddress, InetSocketAddress::ConvertFrom (bSockName).GetPort ());
+  peerOfB.delay = delay;
+  b->m_peers[aAddress] = peerOfB;
+}
+
+enum Socket::SocketErrno
+EpcS1uDirectSocket::GetErrno (void) const
+{
+  return m_udpSocket->GetErrno ();
+}
+
+enum Socket::SocketType
+EpcS1uDirectSocket::GetSocketType (void) const
+{
+  return m_udpSocket->GetSocketType ();
+}
+
+Ptr<Node>
+EpcS1uDirectSocket::GetNode (void) const
+{
+  return m_udpSocket->GetNode ();
+}
+
+int
+EpcS1uDirectSocket::Bind (const Address &address)
+{
+  return m_udpSocket->Bind (address);
+}
+
+int
+EpcS1uDirectSocket::Bind (void)
+{
+  return m_udpSocket->Bind ();
+}
+
+int
+EpcS1uDirectSocket::Bind6 (void)
+{
+  // S1-U is IPv4 only
+  return -1;
+}
+
+int
+EpcS1uDirectSocket::Close (void)
+{
+  return m_udpSocket->Close ();
+}
+
+int
+EpcS1uDirectSocket::ShutdownSend (void)
+{
+  return m_udpSocket->ShutdownSend ();
+}
+
+int
+EpcS1uDirectSocket::ShutdownRecv (void)
+{
+  return m_udpSocket->ShutdownRecv ();
+}
+
+int
+EpcS1uDirectSocket::Connect (const Address &address)
+{
+  return m_udpSocket->Connect (address);
+}
+
+int
+EpcS1uDirectSocket::Listen (void)
+{
+  return m_udpSocket->Listen ();
+}
+
+uint32_t
+EpcS1uDirectSocket::GetTxAvailable (void) const
+{
+  return m_udpSocket->GetTxAvailable ();
+}
+
+int
+EpcS1uDirectSocket::Send (Ptr<Packet> p, uint32_t flags)
+{
+  return m_udpSocket->Send (p, flags);
+}
+
+int
+EpcS1uDirectSocket::SendTo (Ptr<Packet> p, uint32_t flags, const Address &toAddress)
+{
+  NS_LOG_FUNCTION (this << p << flags << toAddress);
+  if (InetSocketAddress::IsMatchingType (toAddress))
+    {
+      std::map<Ipv4Address, Peer>::iterator it = m_peers.find (InetSocketAddress::ConvertFrom (toAddress).GetIpv4 ());
+      if (it != m_peers.end ())
+        {
+          uint32_t size = p->GetSize ();
+          Simulator::ScheduleWithContext (it->second.socket->GetNode ()->GetId (), it->second.delay,
+                                          &EpcS1uDirectSocket::Deliver, it->second.socket, p, it->second.localAddress);
+          NotifyDataSent (size);
+          return size;
+        }
+    }
+  return m_udpSocket->SendTo (p, flags, toAddress);
+}
+
+uint32_t
+EpcS1uDirectSocket::GetRxAvailable (void) const
+{
+  return m_rxAvailable;
+}
+
+Ptr<Packet>
+EpcS1uDirectSocket::Recv (uint32_t maxSize, uint32_t flags)
+{
+  Address fromAddress;
+  return RecvFrom (maxSize, flags, fromAddress);
+}
+
+Ptr<Packet>
+EpcS1uDirectSocket::RecvFrom (uint32_t maxSize, uint32_t flags, Address &fromAddress)
+{
+  NS_LOG_FUNCTION (this << maxSize << flags);
+  if (m_rxQueue.empty () || m_rxQueue.front ().first->GetSize () > maxSize)
+    {
+      return 0;
+    }
+  Ptr<Packet> p = m_rxQueue.front ().first;
+  fromAddress = m_rxQueue.front ().second;
+  m_rxQueue.pop_front ();
+  m_rxAvailable -= p->GetSize ();
+  return p;
+}
+
+int
+EpcS1uDirectSocket::GetSockName (Address &address) const
+{
+  return m_udpSocket->GetSockName (address);
+}
+
+bool
+EpcS1uDirectSocket::SetAllowBroadcast (bool allowBroadcast)
+{
+  return m_udpSocket->SetAllowBroadcast (allowBroadcast);
+}
+
+bool
+EpcS1uDirectSocket::GetAllowBroadcast () const
+{
+  return m_udpSocket->GetAllowBroadcast ();
+}
+
+void
+EpcS1uDirectSocket::Deliver (Ptr<Packet> packet, Address from)
+{
+  NS_LOG_FUNCTION (this << packet << from);
+  m_rxQueue.push_back (std::make_pair (packet, from));
+  m_rxAvailable += packet->GetSize ();
+  NotifyDataRecv ();
+}
+
+void
+EpcS1uDirectSocket::RecvFromUdpSocket (Ptr<Socket> socket)
+{
+  NS_LOG_FUNCTION (this << socket);
+  NS_ASSERT (socket == m_udpSocket);
+  Address from;
+  Ptr<Packet> packet;
+  while ((packet = m_udpSocket->RecvFrom (from)) != 0)
+    {
+      Deliver (packet, from);
+    }
+}
+
+} // namespace ns3
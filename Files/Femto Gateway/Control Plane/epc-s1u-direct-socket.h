@@ -0,0 +1,137 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#ifndef EPC_S1U_DIRECT_SOCKET_H
+#define EPC_S1U_DIRECT_SOCKET_H
+
+#include <ns3/socket.h>
+#include <ns3/ipv4-address.h>
+#include <ns3/nstime.h>
+
+#include <map>
+#include <deque>
+
+namespace ns3 {
+
+/**
+ * \ingroup lte
+ *
+ * S1-U socket which can skip the UDP/IP stack. It wraps the UDP socket
+ * of an S1-U endpoint (eNB, SGW or femto gateway). The GTP-U packets
+ * sent to a peer which has been linked with Link are handed to the
+ * socket of the peer after the delay of the link, without going
+ * through UDP, IP and the point-to-point link; the data rate and the
+ * MTU of the link are not modelled. The packets sent to any other
+ * address go through the UDP socket, and the packets received by the
+ * UDP socket are received as usual.
+ */
+class EpcS1uDirectSocket : public Socket
+{
+public:
+  static TypeId GetTypeId (void);
+
+  /**
+   * Constructor
+   *
+   * \param udpSocket the UDP socket of the endpoint, already bound to
+   * the GTP-U port
+   */
+  EpcS1uDirectSocket (Ptr<Socket> udpSocket);
+
+  virtual ~EpcS1uDirectSocket ();
+
+  /**
+   * Link two S1-U endpoints, so that the GTP-U packets between them
+   * skip the UDP/IP stack
+   *
+   * \param a the socket of the first endpoint
+   * \param aAddress the address of the first endpoint on the link
+   * \param b the socket of the second endpoint
+   * \param bAddress the address of the second endpoint on the link
+   * \param delay the delay of the link
+   */
+  static void Link (Ptr<EpcS1uDirectSocket> a, Ipv4Address aAddress,
+                    Ptr<EpcS1uDirectSocket> b, Ipv4Address bAddress,
+                    Time delay);
+
+  // inherited from Socket
+  virtual enum SocketErrno GetErrno (void) const;
+  virtual enum SocketType GetSocketType (void) const;
+  virtual Ptr<Node> GetNode (void) const;
+  virtual int Bind (const Address &address);
+  virtual int Bind (void);
+  virtual int Bind6 (void);
+  virtual int Close (void);
+  virtual int ShutdownSend (void);
+  virtual int ShutdownRecv (void);
+  virtual int Connect (const Address &address);
+  virtual int Listen (void);
+  virtual uint32_t GetTxAvailable (void) const;
+  virtual int Send (Ptr<Packet> p, uint32_t flags);
+  virtual int SendTo (Ptr<Packet> p, uint32_t flags, const Address &toAddress);
+  virtual uint32_t GetRxAvailable (void) const;
+  virtual Ptr<Packet> Recv (uint32_t maxSize, uint32_t flags);
+  virtual Ptr<Packet> RecvFrom (uint32_t maxSize, uint32_t flags, Address &fromAddress);
+  virtual int GetSockName (Address &address) const;
+  virtual bool SetAllowBroadcast (bool allowBroadcast);
+  virtual bool GetAllowBroadcast () const;
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  /**
+   * Receive a packet sent by a linked peer
+   *
+   * \param packet the GTP-U packet
+   * \param from the socket address of the peer
+   */
+  void Deliver (Ptr<Packet> packet, Address from);
+
+  /**
+   * Method to be assigned to the recv callback of the UDP socket
+   *
+   * \param socket pointer to the UDP socket
+   */
+  void RecvFromUdpSocket (Ptr<Socket> socket);
+
+  /**
+   * A linked peer
+   */
+  struct Peer
+  {
+    Ptr<EpcS1uDirectSocket> socket;
+    Address localAddress;   ///< socket address of this endpoint, as seen by the peer
+    Time delay;
+  };
+
+  /**
+   * the linked peers, by address
+   */
+  std::map<Ipv4Address, Peer> m_peers;
+
+  /**
+   * the packets received and not read yet, with the address of the sender
+   */
+  std::deque<std::pair<Ptr<Packet>, Address> > m_rxQueue;
+  uint32_t m_rxAvailable;
+
+  Ptr<Socket> m_udpSocket;
+};
+
+} // namespace ns3
+
+#endif // EPC_S1U_DIRECT_SOCKET_H
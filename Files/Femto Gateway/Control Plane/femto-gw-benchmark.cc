@@ -0,0 +1,255 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+// Compares the handovers between the HeNBs of a femto gateway with and
+// without local path switching. The HeNBs and the SGW are stubs; every
+// S1-AP message between a HeNB and the gateway takes accessDelay,
+// every S1-AP message between the gateway and the MME takes
+// backhaulDelay, and the SGW answers after s11Delay. The interruption
+// time of a handover is the time from the Path Switch Request sent by
+// the target HeNB to the acknowledge it receives.
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include <ns3/epc-mme.h>
+#include <ns3/FemtoGW.h>
+#include <ns3/epc-femto-gw-application.h>
+#include <ns3/epc-s1ap-sap.h>
+#include <ns3/epc-s11-sap.h>
+#include <ns3/epc-benchmark-stubs.h>
+
+#include <map>
+
+using namespace ns3;
+
+/**
+ * Delivers the S1-AP messages to the MME side of a SAP after a delay
+ */
+class DelayedS1apSapMme : public EpcS1apSapMme
+{
+public:
+  DelayedS1apSapMme (EpcS1apSapMme* target, Time delay)
+    : m_target (target),
+      m_delay (delay),
+      m_nMessages (0)
+  {
+  }
+  virtual void InitialUeMessage (uint64_t mmeUeS1Id, uint16_t enbUeS1Id, uint64_t imsi, uint16_t ecgi)
+  {
+    ++m_nMessages;
+    Simulator::Schedule (m_delay, &EpcS1apSapMme::InitialUeMessage, m_target, mmeUeS1Id, enbUeS1Id, imsi, ecgi);
+  }
+  virtual void InitialContextSetupResponse (uint64_t mmeUeS1Id, uint16_t enbUeS1Id, const ErabSetupList &erabSetupList)
+  {
+    ++m_nMessages;
+    Simulator::Schedule (m_delay, &EpcS1apSapMme::InitialContextSetupResponse, m_target, mmeUeS1Id, enbUeS1Id, erabSetupList);
+  }
+  virtual void PathSwitchRequest (uint64_t enbUeS1Id, uint64_t mmeUeS1Id, uint16_t gci, const ErabSwitchedInDownlinkList &erabToBeSwitchedInDownlinkList)
+  {
+    ++m_nMessages;
+    Simulator::Schedule (m_delay, &EpcS1apSapMme::PathSwitchRequest, m_target, enbUeS1Id, mmeUeS1Id, gci, erabToBeSwitchedInDownlinkList);
+  }
+  EpcS1apSapMme* m_target;
+  Time m_delay;
+  uint64_t m_nMessages;
+};
+
+/**
+ * Delivers the S1-AP messages to the eNB side of a SAP after a delay
+ */
+class DelayedS1apSapEnb : public EpcS1apSapEnb
+{
+public:
+  DelayedS1apSapEnb (EpcS1apSapEnb* target, Time delay)
+    : m_target (target),
+      m_delay (delay),
+      m_nMessages (0)
+  {
+  }
+  virtual void InitialContextSetupRequest (uint64_t mmeUeS1Id, uint16_t enbUeS1Id, const ErabToBeSetupList &erabToBeSetupList)
+  {
+    ++m_nMessages;
+    Simulator::Schedule (m_delay, &EpcS1apSapEnb::InitialContextSetupRequest, m_target, mmeUeS1Id, enbUeS1Id, erabToBeSetupList);
+  }
+  virtual void PathSwitchRequestAcknowledge (uint64_t enbUeS1Id, uint64_t mmeUeS1Id, uint16_t cgi, const ErabSwitchedInUplinkList &erabToBeSwitchedInUplinkList)
+  {
+    ++m_nMessages;
+    Simulator::Schedule (m_delay, &EpcS1apSapEnb::PathSwitchRequestAcknowledge, m_target, enbUeS1Id, mmeUeS1Id, cgi, erabToBeSwitchedInUplinkList);
+  }
+  EpcS1apSapEnb* m_target;
+  Time m_delay;
+  uint64_t m_nMessages;
+};
+
+struct HandoverStats
+{
+  HandoverStats ()
+    : nHandovers (0)
+  {
+  }
+  std::map<uint64_t, Time> pathSwitchTime;
+  uint64_t nHandovers;
+  Time totalInterruption;
+  Time maxInterruption;
+};
+
+/**
+ * HeNB stub which measures the interruption time of the handovers
+ */
+class BenchmarkHenb : public BenchmarkEnb
+{
+public:
+  BenchmarkHenb (HandoverStats* stats)
+    : m_stats (stats)
+  {
+  }
+  virtual void PathSwitchRequestAcknowledge (uint64_t enbUeS1Id, uint64_t mmeUeS1Id, uint16_t cgi, const ErabSwitchedInUplinkList &erabToBeSwitchedInUplinkList)
+  {
+    BenchmarkEnb::PathSwitchRequestAcknowledge (enbUeS1Id, mmeUeS1Id, cgi, erabToBeSwitchedInUplinkList);
+    Time interruption = Simulator::Now () - m_stats->pathSwitchTime[mmeUeS1Id];
+    ++m_stats->nHandovers;
+    m_stats->totalInterruption += interruption;
+    m_stats->maxInterruption = Max (m_stats->maxInterruption, interruption);
+  }
+  HandoverStats* m_stats;
+};
+
+static void
+SendPathSwitchRequest (EpcS1apSapMme* s1apSapMme, HandoverStats* stats, uint64_t imsi, uint16_t targetCellId)
+{
+  stats->pathSwitchTime[imsi] = Simulator::Now ();
+  EpcS1apSapMme::ErabSwitchedInDownlinkList erabToBeSwitchedInDownlinkList;
+  EpcS1apSapMme::ErabSwitchedInDownlinkItem erab;
+  erab.erabId = 1;
+  erab.enbTransportLayerAddress = Ipv4Address ("10.0.1.1");
+  erab.enbTeid = BenchmarkSgw::GetTeid (imsi, 1);
+  erabToBeSwitchedInDownlinkList.push_back (erab);
+  s1apSapMme->PathSwitchRequest (imsi & 0xffff, imsi, targetCellId, erabToBeSwitchedInDownlinkList);
+}
+
+static void
+RunScenario (bool localPathSwitch, uint32_t nUes, uint32_t nHenbs, uint32_t nRounds,
+             Time accessDelay, Time backhaulDelay, Time s11Delay)
+{
+  HandoverStats stats;
+
+  Ptr<EpcMme> mme = CreateObject<EpcMme> ();
+  Ptr<FemtoGW> gw = CreateObject<FemtoGW> ();
+  gw->SetAttribute ("LocalPathSwitch", BooleanValue (localPathSwitch));
+
+  // data plane of the gateway, only used to re-point the tunnels
+  Ptr<Node> gwNode = CreateObject<Node> ();
+  InternetStackHelper internet;
+  internet.Install (gwNode);
+  Ptr<Socket> gwS1uSocket = Socket::CreateSocket (gwNode, TypeId::LookupByName ("ns3::UdpSocketFactory"));
+  Ptr<EpcFemtoGwApplication> gwApp = CreateObject<EpcFemtoGwApplication> (gwS1uSocket);
+  gwNode->AddApplication (gwApp);
+  gw->SetFemtoGwApplication (gwApp);
+
+  BenchmarkSgw sgw (s11Delay);
+  sgw.m_mme = gw->GetS11SapMme ();
+  mme->SetS11SapSgw (&sgw);
+  gw->SetS11SapSgw (&sgw);
+  gw->SetS11SapMme (mme->GetS11SapMme ());
+
+  DelayedS1apSapMme gwToMme (mme->GetS1apSapMme (), backhaulDelay);
+  DelayedS1apSapEnb mmeToGw (gw->GetS1apSapEnb (), backhaulDelay);
+  DelayedS1apSapMme henbToGw (gw->GetS1apSapMme (), accessDelay);
+  gw->SetS1apSapMme (&gwToMme);
+
+  std::vector<BenchmarkHenb*> henbs;
+  std::vector<DelayedS1apSapEnb*> gwToHenbs;
+  for (uint16_t cellId = 1; cellId <= nHenbs; ++cellId)
+    {
+      Ipv4Address henbAddress ((uint32_t) (0x0a000100 + cellId));
+      henbs.push_back (new BenchmarkHenb (&stats));
+      gwToHenbs.push_back (new DelayedS1apSapEnb (henbs.back (), accessDelay));
+      gw->AddEnb (cellId, henbAddress, gwToHenbs.back ());
+      gwApp->AddEnb (cellId, henbAddress);
+      mme->AddEnb (cellId, henbAddress, &mmeToGw);
+    }
+
+  // every UE attaches at its own HeNB, then hands over to the next one
+  // once per round
+  for (uint64_t imsi = 1; imsi <= nUes; ++imsi)
+    {
+      mme->AddUe (imsi);
+      mme->AddBearer (imsi, Create<EpcTft> (), EpsBearer (EpsBearer::NGBR_VIDEO_TCP_DEFAULT));
+      uint16_t cellId = 1 + (imsi % nHenbs);
+      Simulator::Schedule (MicroSeconds (imsi), &EpcS1apSapMme::InitialUeMessage, &henbToGw, imsi, imsi & 0xffff, imsi, cellId);
+      for (uint32_t round = 1; round <= nRounds; ++round)
+        {
+          uint16_t targetCellId = 1 + ((imsi + round) % nHenbs);
+          Simulator::Schedule (Seconds (round) + MicroSeconds (imsi), &SendPathSwitchRequest, &henbToGw, &stats, imsi, targetCellId);
+        }
+    }
+
+  Simulator::Run ();
+
+  uint64_t nAttached = 0;
+  for (uint32_t i = 0; i < nHenbs; ++i)
+    {
+      nAttached += henbs[i]->m_nContextSetups;
+    }
+  NS_ABORT_IF (nAttached != nUes);
+  NS_ABORT_IF (stats.nHandovers != (uint64_t) nUes * nRounds);
+
+  std::cout << "local path switch: " << (localPathSwitch ? "on" : "off") << std::endl;
+  std::cout << "  handovers: " << stats.nHandovers << std::endl;
+  std::cout << "  path switches completed by the gateway: " << gw->GetNLocalPathSwitches () << std::endl;
+  std::cout << "  mean interruption [ms]: "
+            << stats.totalInterruption.GetSeconds () * 1000.0 / stats.nHandovers << std::endl;
+  std::cout << "  max interruption [ms]: " << stats.maxInterruption.GetSeconds () * 1000.0 << std::endl;
+  std::cout << "  S1-AP messages to/from the MME: " << gwToMme.m_nMessages + mmeToGw.m_nMessages << std::endl;
+  std::cout << "  Modify Bearer Requests to the SGW: " << sgw.m_nModifyBearerRequests << std::endl;
+
+  for (uint32_t i = 0; i < nHenbs; ++i)
+    {
+      delete gwToHenbs[i];
+      delete henbs[i];
+    }
+  gw->Dispose ();
+  mme->Dispose ();
+  Simulator::Destroy ();
+}
+
+int main (int argc, char *argv[])
+{
+  uint32_t nUes = 1000;
+  uint32_t nHenbs = 20;
+  uint32_t nRounds = 5;
+  double accessDelayMs = 2;
+  double backhaulDelayMs = 10;
+  double s11DelayMs = 5;
+  CommandLine cmd;
+  cmd.AddValue ("nUes", "Number of UEs", nUes);
+  cmd.AddValue ("nHenbs", "Number of HeNBs of the gateway", nHenbs);
+  cmd.AddValue ("nRounds", "Number of handovers of each UE", nRounds);
+  cmd.AddValue ("accessDelay", "One-way S1-AP delay between a HeNB and the gateway [ms]", accessDelayMs);
+  cmd.AddValue ("backhaulDelay", "One-way S1-AP delay between the gateway and the MME [ms]", backhaulDelayMs);
+  cmd.AddValue ("s11Delay", "Response time of the SGW [ms]", s11DelayMs);
+  cmd.Parse (argc, argv);
+  NS_ABORT_MSG_IF (nHenbs < 2, "at least two HeNBs are needed");
+
+  Time accessDelay = Seconds (accessDelayMs / 1000.0);
+  Time backhaulDelay = Seconds (backhaulDelayMs / 1000.0);
+  Time s11Delay = Seconds (s11DelayMs / 1000.0);
+  RunScenario (false, nUes, nHenbs, nRounds, accessDelay, backhaulDelay, s11Delay);
+  RunScenario (true, nUes, nHenbs, nRounds, accessDelay, backhaulDelay, s11Delay);
+  return 0;
+}
@@ -0,0 +1,357 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#include "handover-latency-stats.h"
+#include "epc-mme.h"
+#include "ns3/log.h"
+#include "ns3/fatal-error.h"
+#include "ns3/config.h"
+#include "ns3/simulator.h"
+#include "ns3/trace-source-accessor.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("HandoverLatencyStats");
+
+NS_OBJECT_ENSURE_REGISTERED (HandoverLatencyStats);
+
+
+HandoverLatencyStats::HandoverLatencyStats ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+HandoverLatencyStats::~HandoverLatencyStats ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+TypeId
+HandoverLatencyStats::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::HandoverLatencyStats")
+    .SetParent<Object> ()
+    .AddConstructor<HandoverLatencyStats> ()
+    .AddAttribute ("BinWidth",
+                   "Width of the bins of the latency histograms",
+                   TimeValue (MilliSeconds (1)),
+                   MakeTimeAccessor (&HandoverLatencyStats::m_binWidth),
+                   MakeTimeChecker ())
+    .AddTraceSource ("Stage",
+                     "A handover reaches a stage",
+                     MakeTraceSourceAccessor (&HandoverLatencyStats::m_stageTrace))
+    ;
+  return tid;
+}
+
+void
+HandoverLatencyStats::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_handoverMap.clear ();
+  m_newUeContextTimeMap.clear ();
+}
+
+std::string
+HandoverLatencyStats::GetStageName (Stage_t stage)
+{
+  switch (stage)
+    {
+    case HANDOVER_DECISION:
+      return "HandoverDecision";
+    case X2_HANDOVER_REQUEST:
+      return "X2HandoverRequest";
+    case RRC_RECONFIGURATION:
+      return "RrcReconfiguration";
+    case RANDOM_ACCESS:
+      return "RandomAccess";
+    case RRC_RECONFIGURATION_COMPLETE:
+      return "RrcReconfigurationComplete";
+    case PATH_SWITCH_REQUEST:
+      return "PathSwitchRequest";
+    case MME_PATH_SWITCH_REQUEST:
+      return "MmePathSwitchRequest";
+    case MODIFY_BEARER_REQUEST:
+      return "ModifyBearerRequest";
+    case MODIFY_BEARER_RESPONSE:
+      return "ModifyBearerResponse";
+    case PATH_SWITCH_REQUEST_ACK:
+      return "PathSwitchRequestAck";
+    default:
+      NS_FATAL_ERROR ("invalid stage " << stage);
+      return "";
+    }
+}
+
+void
+HandoverLatencyStats::Install (Ptr<EpcMme> mme)
+{
+  NS_LOG_FUNCTION (this << mme);
+  Config::ConnectWithoutContext ("/NodeList/*/DeviceList/*/LteEnbRrc/HandoverStart",
+                                 MakeCallback (&HandoverLatencyStats::HandoverStartEnb, this));
+  Config::ConnectWithoutContext ("/NodeList/*/DeviceList/*/LteEnbRrc/NewUeContext",
+                                 MakeCallback (&HandoverLatencyStats::NewUeContextEnb, this));
+  Config::ConnectWithoutContext ("/NodeList/*/DeviceList/*/LteUeRrc/HandoverStart",
+                                 MakeCallback (&HandoverLatencyStats::HandoverStartUe, this));
+  Config::ConnectWithoutContext ("/NodeList/*/DeviceList/*/LteUeRrc/RandomAccessSuccessful",
+                                 MakeCallback (&HandoverLatencyStats::RandomAccessSuccessfulUe, this));
+  Config::ConnectWithoutContext ("/NodeList/*/DeviceList/*/LteEnbRrc/HandoverEndOk",
+                                 MakeCallback (&HandoverLatencyStats::HandoverEndOkEnb, this));
+  Config::ConnectWithoutContext ("/NodeList/*/ApplicationList/*/$ns3::EpcEnbApplication/PathSwitchRequest",
+                                 MakeCallback (&HandoverLatencyStats::PathSwitchRequestEnb, this));
+  Config::ConnectWithoutContext ("/NodeList/*/ApplicationList/*/$ns3::EpcEnbApplication/PathSwitchRequestAcknowledge",
+                                 MakeCallback (&HandoverLatencyStats::PathSwitchRequestAckEnb, this));
+  mme->TraceConnectWithoutContext ("PathSwitchRequest",
+                                   MakeCallback (&HandoverLatencyStats::PathSwitchRequestMme, this));
+  mme->TraceConnectWithoutContext ("ModifyBearerRequest",
+                                   MakeCallback (&HandoverLatencyStats::ModifyBearerRequestMme, this));
+  mme->TraceConnectWithoutContext ("ModifyBearerResponse",
+                                   MakeCallback (&HandoverLatencyStats::ModifyBearerResponseMme, this));
+}
+
+HandoverLatencyStats::HandoverInfo*
+HandoverLatencyStats::SetStageTime (uint64_t imsi, Stage_t stage)
+{
+  std::map<uint64_t, HandoverInfo>::iterator it = m_handoverMap.find (imsi);
+  if (it == m_handoverMap.end ())
+    {
+      return 0;
+    }
+  HandoverInfo& handover = it->second;
+  if (handover.stageTime[stage].IsStrictlyNegative ())
+    {
+      handover.stageTime[stage] = Simulator::Now ();
+      m_stageTrace (imsi, handover.sourceCellId, handover.targetCellId, stage);
+    }
+  return &handover;
+}
+
+void
+HandoverLatencyStats::ResolveX2HandoverRequest (HandoverInfo& handover, uint16_t cellId, uint16_t rnti)
+{
+  std::map<std::pair<uint16_t, uint16_t>, Time>::iterator it = m_newUeContextTimeMap.find (std::make_pair (cellId, rnti));
+  if (it != m_newUeContextTimeMap.end ())
+    {
+      if (handover.stageTime[X2_HANDOVER_REQUEST].IsStrictlyNegative ())
+        {
+          handover.stageTime[X2_HANDOVER_REQUEST] = it->second;
+        }
+      m_newUeContextTimeMap.erase (it);
+    }
+}
+
+void
+HandoverLatencyStats::HandoverStartEnb (uint64_t imsi, uint16_t cellId, uint16_t rnti, uint16_t targetCellId)
+{
+  NS_LOG_FUNCTION (this << imsi << cellId << rnti << targetCellId);
+  // a new handover of the UE replaces the one in progress, if any
+  HandoverInfo& handover = m_handoverMap[imsi];
+  handover.sourceCellId = cellId;
+  handover.targetCellId = targetCellId;
+  for (uint32_t i = 0; i < N_STAGES; ++i)
+    {
+      handover.stageTime[i] = Seconds (-1);
+    }
+  SetStageTime (imsi, HANDOVER_DECISION);
+}
+
+void
+HandoverLatencyStats::NewUeContextEnb (uint16_t cellId, uint16_t rnti)
+{
+  NS_LOG_FUNCTION (this << cellId << rnti);
+  // the IMSI of the UE is not known yet: the context is matched with a
+  // handover by its RNTI, once the UE has accessed the target cell
+  for (std::map<uint64_t, HandoverInfo>::const_iterator it = m_handoverMap.begin ();
+       it != m_handoverMap.end ();
+       ++it)
+    {
+      if (it->second.targetCellId == cellId)
+        {
+          m_newUeContextTimeMap[std::make_pair (cellId, rnti)] = Simulator::Now ();
+          return;
+        }
+    }
+}
+
+void
+HandoverLatencyStats::HandoverStartUe (uint64_t imsi, uint16_t cellId, uint16_t rnti, uint16_t targetCellId)
+{
+  NS_LOG_FUNCTION (this << imsi << cellId << rnti << targetCellId);
+  SetStageTime (imsi, RRC_RECONFIGURATION);
+}
+
+void
+HandoverLatencyStats::RandomAccessSuccessfulUe (uint64_t imsi, uint16_t cellId, uint16_t rnti)
+{
+  NS_LOG_FUNCTION (this << imsi << cellId << rnti);
+  std::map<uint64_t, HandoverInfo>::iterator it = m_handoverMap.find (imsi);
+  if (it == m_handoverMap.end () || it->second.targetCellId != cellId)
+    {
+      // not the access to the target cell of a handover
+      return;
+    }
+  ResolveX2HandoverRequest (it->second, cellId, rnti);
+  SetStageTime (imsi, RANDOM_ACCESS);
+}
+
+void
+HandoverLatencyStats::HandoverEndOkEnb (uint64_t imsi, uint16_t cellId, uint16_t rnti)
+{
+  NS_LOG_FUNCTION (this << imsi << cellId << rnti);
+  HandoverInfo* handover = SetStageTime (imsi, RRC_RECONFIGURATION_COMPLETE);
+  if (handover != 0)
+    {
+      ResolveX2HandoverRequest (*handover, cellId, rnti);
+    }
+}
+
+void
+HandoverLatencyStats::PathSwitchRequestEnb (uint64_t imsi, uint16_t cellId, uint16_t rnti)
+{
+  NS_LOG_FUNCTION (this << imsi << cellId << rnti);
+  SetStageTime (imsi, PATH_SWITCH_REQUEST);
+}
+
+void
+HandoverLatencyStats::PathSwitchRequestMme (uint64_t imsi, uint16_t sourceCellId, uint16_t targetCellId)
+{
+  NS_LOG_FUNCTION (this << imsi << sourceCellId << targetCellId);
+  SetStageTime (imsi, MME_PATH_SWITCH_REQUEST);
+}
+
+void
+HandoverLatencyStats::ModifyBearerRequestMme (uint64_t imsi, uint16_t cellId)
+{
+  NS_LOG_FUNCTION (this << imsi << cellId);
+  SetStageTime (imsi, MODIFY_BEARER_REQUEST);
+}
+
+void
+HandoverLatencyStats::ModifyBearerResponseMme (uint64_t imsi)
+{
+  NS_LOG_FUNCTION (this << imsi);
+  SetStageTime (imsi, MODIFY_BEARER_RESPONSE);
+}
+
+void
+HandoverLatencyStats::PathSwitchRequestAckEnb (uint64_t imsi, uint16_t cellId, uint16_t rnti)
+{
+  NS_LOG_FUNCTION (this << imsi << cellId << rnti);
+  HandoverInfo* handover = SetStageTime (imsi, PATH_SWITCH_REQUEST_ACK);
+  if (handover == 0)
+    {
+      return;
+    }
+  CellPairStats& stats = m_cellPairStatsMap[std::make_pair (handover->sourceCellId, handover->targetCellId)];
+  // a stage which has not been seen is skipped: its latency is
+  // counted in the next stage
+  Time previous = handover->stageTime[HANDOVER_DECISION];
+  for (uint32_t i = HANDOVER_DECISION + 1; i < N_STAGES; ++i)
+    {
+      if (!handover->stageTime[i].IsStrictlyNegative ())
+        {
+          AddSample (stats.stage[i], handover->stageTime[i] - previous);
+          previous = handover->stageTime[i];
+        }
+    }
+  AddSample (stats.stage[HANDOVER_DECISION], handover->stageTime[PATH_SWITCH_REQUEST_ACK] - handover->stageTime[HANDOVER_DECISION]);
+  m_handoverMap.erase (imsi);
+}
+
+void
+HandoverLatencyStats::AddSample (Histogram& histogram, Time latency)
+{
+  uint32_t bin = latency.GetNanoSeconds () / m_binWidth.GetNanoSeconds ();
+  if (bin >= histogram.bins.size ())
+    {
+      histogram.bins.resize (bin + 1, 0);
+    }
+  ++histogram.bins[bin];
+  if (histogram.count == 0)
+    {
+      histogram.min = latency;
+      histogram.max = latency;
+    }
+  else
+    {
+      histogram.min = Min (histogram.min, latency);
+      histogram.max = Max (histogram.max, latency);
+    }
+  ++histogram.count;
+  histogram.sum += latency;
+}
+
+uint32_t
+HandoverLatencyStats::GetNHandovers (uint16_t sourceCellId, uint16_t targetCellId) const
+{
+  std::map<std::pair<uint16_t, uint16_t>, CellPairStats>::const_iterator it = m_cellPairStatsMap.find (std::make_pair (sourceCellId, targetCellId));
+  return (it != m_cellPairStatsMap.end ()) ? it->second.stage[HANDOVER_DECISION].count : 0;
+}
+
+Time
+HandoverLatencyStats::GetMeanLatency (uint16_t sourceCellId, uint16_t targetCellId, Stage_t stage) const
+{
+  NS_ASSERT (stage > HANDOVER_DECISION && stage < N_STAGES);
+  std::map<std::pair<uint16_t, uint16_t>, CellPairStats>::const_iterator it = m_cellPairStatsMap.find (std::make_pair (sourceCellId, targetCellId));
+  if (it == m_cellPairStatsMap.end () || it->second.stage[stage].count == 0)
+    {
+      return Seconds (0);
+    }
+  const Histogram& histogram = it->second.stage[stage];
+  return NanoSeconds (histogram.sum.GetNanoSeconds () / (int64_t) histogram.count);
+}
+
+void
+HandoverLatencyStats::PrintHistogram (std::ostream &os, const std::string &name, const Histogram& histogram) const
+{
+  os << "  " << name << ": ";
+  if (histogram.count == 0)
+    {
+      os << "-" << std::endl;
+      return;
+    }
+  os << "mean " << (histogram.sum.GetSeconds () * 1000 / histogram.count) << " ms"
+     << ", min " << histogram.min.GetSeconds () * 1000 << " ms"
+     << ", max " << histogram.max.GetSeconds () * 1000 << " ms"
+     << ", histogram";
+  for (uint32_t bin = 0; bin < histogram.bins.size (); ++bin)
+    {
+      if (histogram.bins[bin] > 0)
+        {
+          os << " [" << m_binWidth.GetSeconds () * 1000 * bin << " ms: " << histogram.bins[bin] << "]";
+        }
+    }
+  os << std::endl;
+}
+
+void
+HandoverLatencyStats::Print (std::ostream &os) const
+{
+  for (std::map<std::pair<uint16_t, uint16_t>, CellPairStats>::const_iterator it = m_cellPairStatsMap.begin ();
+       it != m_cellPairStatsMap.end ();
+       ++it)
+    {
+      os << "Handovers from CellId " << it->first.first << " to CellId " << it->first.second
+         << ": " << it->second.stage[HANDOVER_DECISION].count << std::endl;
+      for (uint32_t i = HANDOVER_DECISION + 1; i < N_STAGES; ++i)
+        {
+          PrintHistogram (os, GetStageName ((Stage_t) i), it->second.stage[i]);
+        }
+      PrintHistogram (os, "Total", it->second.stage[HANDOVER_DECISION]);
+    }
+}
+
+} // namespace ns3
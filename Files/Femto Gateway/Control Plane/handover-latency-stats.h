@@ -0,0 +1,222 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#ifndef HANDOVER_LATENCY_STATS_H
+#define HANDOVER_LATENCY_STATS_H
+
+#include <ns3/object.h>
+#include <ns3/nstime.h>
+#include <ns3/traced-callback.h>
+
+#include <map>
+#include <vector>
+#include <ostream>
+#include <string>
+
+namespace ns3 {
+
+class EpcMme;
+
+/**
+ * \ingroup lte
+ *
+ * Breakdown of the latency of the X2 handovers. The time of each
+ * stage of a handover is taken from the trace sources of the RRC of
+ * the eNBs and of the UEs, of the EpcEnbApplication and of the
+ * EpcMme, and the time between consecutive stages is collected in one
+ * histogram per stage and per (source cell, target cell) pair when
+ * the handover completes.
+ *
+ * The stages are, in order: the handover decision of the source eNB,
+ * which sends the X2 Handover Request; the admission of the UE by the
+ * target eNB; the RRC Connection Reconfiguration received by the UE
+ * once the source eNB has the X2 Handover Request Acknowledge; the
+ * random access of the UE to the target cell; the RRC Connection
+ * Reconfiguration Complete received by the target eNB; the Path
+ * Switch Request sent by the target eNB and received by the MME; the
+ * Modify Bearer Request sent by the MME to the SGW and its response;
+ * the Path Switch Request Acknowledge received by the target eNB.
+ */
+class HandoverLatencyStats : public Object
+{
+public:
+  /**
+   * stages of a handover
+   */
+  enum Stage_t
+  {
+    HANDOVER_DECISION = 0,
+    X2_HANDOVER_REQUEST,
+    RRC_RECONFIGURATION,
+    RANDOM_ACCESS,
+    RRC_RECONFIGURATION_COMPLETE,
+    PATH_SWITCH_REQUEST,
+    MME_PATH_SWITCH_REQUEST,
+    MODIFY_BEARER_REQUEST,
+    MODIFY_BEARER_RESPONSE,
+    PATH_SWITCH_REQUEST_ACK,
+    N_STAGES
+  };
+
+  HandoverLatencyStats ();
+  virtual ~HandoverLatencyStats ();
+
+  // inherited from Object
+  static TypeId GetTypeId (void);
+
+  /**
+   * \param stage a stage of a handover
+   * \return the name of the stage
+   */
+  static std::string GetStageName (Stage_t stage);
+
+  /**
+   * Connect to the trace sources of all the eNBs and UEs which exist
+   * at the time of the call, and to the ones of the MME
+   *
+   * \param mme the MME of the EPC
+   */
+  void Install (Ptr<EpcMme> mme);
+
+  /**
+   * \param sourceCellId the cell ID of the source eNB
+   * \param targetCellId the cell ID of the target eNB
+   * \return the number of handovers completed from sourceCellId to targetCellId
+   */
+  uint32_t GetNHandovers (uint16_t sourceCellId, uint16_t targetCellId) const;
+
+  /**
+   * \param sourceCellId the cell ID of the source eNB
+   * \param targetCellId the cell ID of the target eNB
+   * \param stage any stage but HANDOVER_DECISION
+   * \return the mean time from the previous stage to stage, for the
+   * handovers completed from sourceCellId to targetCellId
+   */
+  Time GetMeanLatency (uint16_t sourceCellId, uint16_t targetCellId, Stage_t stage) const;
+
+  /**
+   * Print, for each cell pair, the number of handovers and, for each
+   * stage, the mean, minimum and maximum time from the previous stage
+   * and the non-empty bins of its histogram; the total is the time from
+   * the decision to the Path Switch Request Acknowledge
+   *
+   * \param os the output stream
+   */
+  void Print (std::ostream &os) const;
+
+  // trace sinks
+  void HandoverStartEnb (uint64_t imsi, uint16_t cellId, uint16_t rnti, uint16_t targetCellId);
+  void NewUeContextEnb (uint16_t cellId, uint16_t rnti);
+  void HandoverStartUe (uint64_t imsi, uint16_t cellId, uint16_t rnti, uint16_t targetCellId);
+  void RandomAccessSuccessfulUe (uint64_t imsi, uint16_t cellId, uint16_t rnti);
+  void HandoverEndOkEnb (uint64_t imsi, uint16_t cellId, uint16_t rnti);
+  void PathSwitchRequestEnb (uint64_t imsi, uint16_t cellId, uint16_t rnti);
+  void PathSwitchRequestMme (uint64_t imsi, uint16_t sourceCellId, uint16_t targetCellId);
+  void ModifyBearerRequestMme (uint64_t imsi, uint16_t cellId);
+  void ModifyBearerResponseMme (uint64_t imsi);
+  void PathSwitchRequestAckEnb (uint64_t imsi, uint16_t cellId, uint16_t rnti);
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  /**
+   * histogram of the latency of a stage, with bins of fixed width
+   */
+  struct Histogram
+  {
+    Histogram () : count (0) {}
+    std::vector<uint32_t> bins;
+    uint32_t count;
+    Time sum;
+    Time min;
+    Time max;
+  };
+
+  /**
+   * Add a sample to a histogram
+   *
+   * \param histogram the histogram
+   * \param latency the sample
+   */
+  void AddSample (Histogram& histogram, Time latency);
+
+  /**
+   * Print a histogram on one line
+   */
+  void PrintHistogram (std::ostream &os, const std::string &name, const Histogram& histogram) const;
+
+  /**
+   * handover in progress of a UE
+   */
+  struct HandoverInfo
+  {
+    uint16_t sourceCellId;
+    uint16_t targetCellId;
+    Time stageTime[N_STAGES];   ///< negative while the stage has not been reached
+  };
+
+  /**
+   * Record the time of a stage of the handover in progress of a UE
+   *
+   * \param imsi the IMSI of the UE
+   * \param stage the stage
+   * \return the handover of the UE, or 0 if it has no handover in progress
+   */
+  HandoverInfo* SetStageTime (uint64_t imsi, Stage_t stage);
+
+  /**
+   * Take the time at which the target eNB has admitted the UE, if it
+   * is known
+   */
+  void ResolveX2HandoverRequest (HandoverInfo& handover, uint16_t cellId, uint16_t rnti);
+
+  /**
+   * handovers in progress, by IMSI
+   */
+  std::map<uint64_t, HandoverInfo> m_handoverMap;
+
+  /**
+   * time of creation of the UE contexts of the target eNBs, by cell ID
+   * and RNTI, until the RNTI of the UE in the target cell is known
+   */
+  std::map<std::pair<uint16_t, uint16_t>, Time> m_newUeContextTimeMap;
+
+  /**
+   * latency of the handovers of a cell pair
+   */
+  struct CellPairStats
+  {
+    Histogram stage[N_STAGES];   ///< stage 0 holds the total
+  };
+
+  /**
+   * statistics by (source cell ID, target cell ID)
+   */
+  std::map<std::pair<uint16_t, uint16_t>, CellPairStats> m_cellPairStatsMap;
+
+  Time m_binWidth;
+
+  /**
+   * The `Stage` trace source, fired when a handover reaches a stage.
+   * Exporting the IMSI, the source and target cell IDs and the stage.
+   */
+  TracedCallback<uint64_t, uint16_t, uint16_t, uint8_t> m_stageTrace;
+};
+
+} // namespace ns3
+
+#endif // HANDOVER_LATENCY_STATS_H
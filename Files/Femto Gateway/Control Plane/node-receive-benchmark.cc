@@ -0,0 +1,200 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+// Measures the packets per second received by an eNB node with
+// nX2Neighbours X2 interfaces, so that the protocol handler dispatch of
+// Node::ReceiveFromDevice is measured with as many devices and
+// handlers as an eNB in a dense deployment has. The eNB has a radio
+// device with a packet socket, as the LTE socket of the EpcEnbApplication,
+// an S1-U device and one device per X2 interface, all of them
+// SimpleNetDevices without delay. The radio packets go to the packet
+// socket, the X2 packets, sent by the last neighbour, go through IPv4
+// to a UDP socket.
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include <ns3/system-wall-clock-ms.h>
+
+using namespace ns3;
+
+static uint64_t g_nRadioPackets = 0;
+static uint64_t g_nX2Packets = 0;
+
+void
+RadioReceive (Ptr<Socket> socket)
+{
+  while (socket->Recv ())
+    {
+      ++g_nRadioPackets;
+    }
+}
+
+void
+X2Receive (Ptr<Socket> socket)
+{
+  while (socket->Recv ())
+    {
+      ++g_nX2Packets;
+    }
+}
+
+/**
+ * Send a burst of packets to the radio device of the eNB, and schedule
+ * the next burst
+ */
+void
+SendRadioBurst (Ptr<NetDevice> ueDevice, Address enbRadioAddress, uint32_t burstSize,
+                uint32_t packetSize, uint32_t nBurstsLeft)
+{
+  for (uint32_t i = 0; i < burstSize; ++i)
+    {
+      ueDevice->Send (Create<Packet> (packetSize), enbRadioAddress, Ipv4L3Protocol::PROT_NUMBER);
+    }
+  if (--nBurstsLeft > 0)
+    {
+      Simulator::Schedule (MicroSeconds (1), &SendRadioBurst, ueDevice, enbRadioAddress, burstSize, packetSize, nBurstsLeft);
+    }
+}
+
+/**
+ * Send a burst of UDP packets to the X2 address of the eNB, and
+ * schedule the next burst
+ */
+void
+SendX2Burst (Ptr<Socket> socket, Ipv4Address enbX2Address, uint32_t burstSize,
+             uint32_t packetSize, uint32_t nBurstsLeft)
+{
+  for (uint32_t i = 0; i < burstSize; ++i)
+    {
+      socket->SendTo (Create<Packet> (packetSize), 0, InetSocketAddress (enbX2Address, 2153));
+    }
+  if (--nBurstsLeft > 0)
+    {
+      Simulator::Schedule (MicroSeconds (1), &SendX2Burst, socket, enbX2Address, burstSize, packetSize, nBurstsLeft);
+    }
+}
+
+Ptr<SimpleNetDevice>
+AddSimpleDevice (Ptr<Node> node, Ptr<SimpleChannel> channel)
+{
+  Ptr<SimpleNetDevice> device = CreateObject<SimpleNetDevice> ();
+  device->SetAddress (Mac48Address::Allocate ());
+  device->SetChannel (channel);
+  node->AddDevice (device);
+  return device;
+}
+
+int main (int argc, char *argv[])
+{
+  uint32_t nX2Neighbours = 64;
+  uint32_t burstSize = 1000;
+  uint32_t nBursts = 100;
+  uint32_t packetSize = 100;
+  CommandLine cmd;
+  cmd.AddValue ("nX2Neighbours", "Number of X2 interfaces of the eNB", nX2Neighbours);
+  cmd.AddValue ("burstSize", "Number of packets sent in each burst", burstSize);
+  cmd.AddValue ("nBursts", "Number of bursts sent on each interface", nBursts);
+  cmd.AddValue ("packetSize", "Size of the packets [bytes]", packetSize);
+  cmd.Parse (argc, argv);
+  NS_ABORT_MSG_IF (nX2Neighbours < 1, "nX2Neighbours must be at least 1");
+
+  Ptr<Node> ue = CreateObject<Node> ();
+  Ptr<Node> enb = CreateObject<Node> ();
+  Ptr<Node> sgw = CreateObject<Node> ();
+  NodeContainer neighbours;
+  neighbours.Create (nX2Neighbours);
+  InternetStackHelper internet;
+  internet.Install (enb);
+  internet.Install (sgw);
+  internet.Install (neighbours);
+
+  // radio interface, with the packet socket of the EpcEnbApplication
+  Ptr<SimpleChannel> radioChannel = CreateObject<SimpleChannel> ();
+  Ptr<SimpleNetDevice> ueDevice = AddSimpleDevice (ue, radioChannel);
+  Ptr<SimpleNetDevice> enbRadioDevice = AddSimpleDevice (enb, radioChannel);
+  PacketSocketHelper packetSocket;
+  packetSocket.Install (enb);
+  Ptr<Socket> enbLteSocket = Socket::CreateSocket (enb, TypeId::LookupByName ("ns3::PacketSocketFactory"));
+  PacketSocketAddress enbLteSocketBindAddress;
+  enbLteSocketBindAddress.SetSingleDevice (enbRadioDevice->GetIfIndex ());
+  enbLteSocketBindAddress.SetProtocol (Ipv4L3Protocol::PROT_NUMBER);
+  NS_ABORT_IF (enbLteSocket->Bind (enbLteSocketBindAddress) != 0);
+  enbLteSocket->SetRecvCallback (MakeCallback (&RadioReceive));
+
+  // S1-U link
+  Ipv4AddressHelper addressHelper;
+  addressHelper.SetBase ("10.0.0.0", "255.255.255.252");
+  Ptr<SimpleChannel> s1uChannel = CreateObject<SimpleChannel> ();
+  NetDeviceContainer s1uDevices;
+  s1uDevices.Add (AddSimpleDevice (enb, s1uChannel));
+  s1uDevices.Add (AddSimpleDevice (sgw, s1uChannel));
+  addressHelper.Assign (s1uDevices);
+
+  // X2 links, one subnet each
+  addressHelper.SetBase ("12.0.0.0", "255.255.255.252");
+  Ipv4InterfaceContainer x2Interfaces;
+  for (uint32_t i = 0; i < nX2Neighbours; ++i)
+    {
+      Ptr<SimpleChannel> x2Channel = CreateObject<SimpleChannel> ();
+      NetDeviceContainer x2Devices;
+      x2Devices.Add (AddSimpleDevice (enb, x2Channel));
+      x2Devices.Add (AddSimpleDevice (neighbours.Get (i), x2Channel));
+      x2Interfaces = addressHelper.Assign (x2Devices);
+      addressHelper.NewNetwork ();
+    }
+  // the interfaces of the last X2 link
+  Ipv4Address enbX2Address = x2Interfaces.GetAddress (0);
+
+  Ptr<Socket> enbX2uSocket = Socket::CreateSocket (enb, TypeId::LookupByName ("ns3::UdpSocketFactory"));
+  NS_ABORT_IF (enbX2uSocket->Bind (InetSocketAddress (Ipv4Address::GetAny (), 2153)) != 0);
+  enbX2uSocket->SetRecvCallback (MakeCallback (&X2Receive));
+  Ptr<Socket> neighbourSocket = Socket::CreateSocket (neighbours.Get (nX2Neighbours - 1), TypeId::LookupByName ("ns3::UdpSocketFactory"));
+  NS_ABORT_IF (neighbourSocket->Bind () != 0);
+
+  std::cout << "X2 neighbours: " << nX2Neighbours << ", eNB devices: " << enb->GetNDevices () << std::endl;
+  uint64_t nPackets = (uint64_t) burstSize * nBursts;
+  SystemWallClockMs clock;
+
+  Simulator::Schedule (Seconds (0), &SendRadioBurst, ueDevice, enbRadioDevice->GetAddress (),
+                       burstSize, packetSize, nBursts);
+  clock.Start ();
+  Simulator::Run ();
+  int64_t radioMs = clock.End ();
+
+  // the first packet resolves the address of the eNB with ARP
+  Simulator::Schedule (Seconds (0), &SendX2Burst, neighbourSocket, enbX2Address, 1, packetSize, 1);
+  Simulator::Run ();
+  g_nX2Packets = 0;
+  Simulator::Schedule (Seconds (0), &SendX2Burst, neighbourSocket, enbX2Address, burstSize, packetSize, nBursts);
+  clock.Start ();
+  Simulator::Run ();
+  int64_t x2Ms = clock.End ();
+
+  NS_ABORT_MSG_IF (g_nRadioPackets != nPackets, "lost radio packets: " << nPackets - g_nRadioPackets);
+  NS_ABORT_MSG_IF (g_nX2Packets != nPackets, "lost X2 packets: " << nPackets - g_nX2Packets);
+  std::cout << "packets per interface: " << nPackets << std::endl;
+  std::cout << "radio time [ms]: " << radioMs << std::endl;
+  std::cout << "radio packets per second: "
+            << (radioMs > 0 ? nPackets * 1000.0 / radioMs : 0) << std::endl;
+  std::cout << "X2 time [ms]: " << x2Ms << std::endl;
+  std::cout << "X2 packets per second: "
+            << (x2Ms > 0 ? nPackets * 1000.0 / x2Ms : 0) << std::endl;
+
+  Simulator::Destroy ();
+  return 0;
+}
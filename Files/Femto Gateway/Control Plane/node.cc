@@ -30,6 +30,7 @@
 #include "ns3/assert.h"
 #include "ns3/global-value.h"
 #include "ns3/boolean.h"
+#include "ns3/enum.h"
 #include "ns3/simulator.h"
 
 NS_LOG_COMPONENT_DEFINE ("Node");
@@ -62,13 +63,24 @@ Node::GetTypeId (void)
                    UintegerValue (0),
                    MakeUintegerAccessor (&Node::m_id),
                    MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("Role", "The role of this Node in the radio access network.",
+                   EnumValue (Node::UNSPECIFIED),
+                   MakeEnumAccessor (&Node::m_role),
+                   MakeEnumChecker (Node::UNSPECIFIED, "Unspecified",
+                                    Node::MACRO_ENB, "MacroEnb",
+                                    Node::HOME_ENB, "HomeEnb",
+                                    Node::RELAY, "Relay",
+                                    Node::UE, "Ue",
+                                    Node::GATEWAY, "Gateway"))
   ;
   return tid;
 }
 
 Node::Node()
   : m_id (0),
-    m_sid (0)
+    m_sid (0),
+    m_role (UNSPECIFIED),
+    m_handlerIndexValid (false)
 {
   NS_LOG_FUNCTION (this);
   Construct ();
@@ -76,7 +88,9 @@ Node::Node()
 
 Node::Node(uint32_t sid)
   : m_id (0),
-    m_sid (sid)
+    m_sid (sid),
+    m_role (UNSPECIFIED),
+    m_handlerIndexValid (false)
 { 
   NS_LOG_FUNCTION (this << sid);
   Construct ();
@@ -87,7 +101,6 @@ Node::Construct (void)
 {
   NS_LOG_FUNCTION (this);
   m_id = NodeList::Add (this);
-  femto=false;   /*changed*/
 }
 
 Node::~Node ()
@@ -109,6 +122,27 @@ Node::GetSystemId (void) const
   return m_sid;
 }
 
+Node::Role
+Node::GetRole (void) const
+{
+  NS_LOG_FUNCTION (this);
+  return m_role;
+}
+
+void
+Node::SetRole (Role role)
+{
+  NS_LOG_FUNCTION (this << role);
+  m_role = role;
+}
+
+bool
+Node::IsStationary (void) const
+{
+  NS_LOG_FUNCTION (this);
+  return m_role == MACRO_ENB || m_role == HOME_ENB || m_role == GATEWAY;
+}
+
 uint32_t
 Node::AddDevice (Ptr<NetDevice> device)
 {
@@ -118,6 +152,8 @@ Node::AddDevice (Ptr<NetDevice> device)
   device->SetNode (this);
   device->SetIfIndex (index);
   device->SetReceiveCallback (MakeCallback (&Node::NonPromiscReceiveFromDevice, this));
+  // the handlers of all the devices apply to this one too
+  m_handlerIndexValid = false;
   Simulator::ScheduleWithContext (GetId (), Seconds (0.0), 
                                   &NetDevice::Start, device);
   NotifyDeviceAdded (device);
@@ -170,6 +206,9 @@ Node::DoDispose ()
   NS_LOG_FUNCTION (this);
   m_deviceAdditionListeners.clear ();
   m_handlers.clear ();
+  m_handlerIndex.clear ();
+  m_promiscHandlerIndex.clear ();
+  m_handlerIndexValid = false;
   for (std::vector<Ptr<NetDevice> >::iterator i = m_devices.begin ();
        i != m_devices.end (); i++)
     {
@@ -240,6 +279,7 @@ Node::RegisterProtocolHandler (ProtocolHandler handler,
     }
 
   m_handlers.push_back (entry);
+  m_handlerIndexValid = false;
 }
 
 void
@@ -252,11 +292,55 @@ Node::UnregisterProtocolHandler (ProtocolHandler handler)
       if (i->handler.IsEqual (handler))
         {
           m_handlers.erase (i);
+          m_handlerIndexValid = false;
           break;
         }
     }
 }
 
+void
+Node::BuildHandlerIndex (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_handlerIndex.assign (m_devices.size (), DeviceHandlerIndex ());
+  m_promiscHandlerIndex.assign (m_devices.size (), DeviceHandlerIndex ());
+  for (uint32_t ifIndex = 0; ifIndex < m_devices.size (); ++ifIndex)
+    {
+      Ptr<NetDevice> device = m_devices[ifIndex];
+      // first the protocols which have a handler of their own, so that
+      // the handlers of all the protocols can be added to their lists
+      for (ProtocolHandlerList::const_iterator i = m_handlers.begin ();
+           i != m_handlers.end (); i++)
+        {
+          if ((i->device == 0 || i->device == device) && i->protocol != 0)
+            {
+              HandlerIndex &index = i->promiscuous ? m_promiscHandlerIndex : m_handlerIndex;
+              index[ifIndex].protocolHandlers[i->protocol];
+            }
+        }
+      for (ProtocolHandlerList::const_iterator i = m_handlers.begin ();
+           i != m_handlers.end (); i++)
+        {
+          if (i->device == 0 || i->device == device)
+            {
+              DeviceHandlerIndex &deviceIndex = (i->promiscuous ? m_promiscHandlerIndex : m_handlerIndex)[ifIndex];
+              if (i->protocol != 0)
+                {
+                  deviceIndex.protocolHandlers[i->protocol].push_back (i->handler);
+                  continue;
+                }
+              deviceIndex.allProtocolHandlers.push_back (i->handler);
+              for (std::map<uint16_t, std::vector<ProtocolHandler> >::iterator j = deviceIndex.protocolHandlers.begin ();
+                   j != deviceIndex.protocolHandlers.end (); j++)
+                {
+                  j->second.push_back (i->handler);
+                }
+            }
+        }
+    }
+  m_handlerIndexValid = true;
+}
+
 bool
 Node::ChecksumEnabled (void)
 {
@@ -293,26 +377,25 @@ Node::ReceiveFromDevice (Ptr<NetDevice> device, Ptr<const Packet> packet, uint16
   NS_LOG_DEBUG ("Node " << GetId () << " ReceiveFromDevice:  dev "
                         << device->GetIfIndex () << " (type=" << device->GetInstanceTypeId ().GetName ()
                         << ") Packet UID " << packet->GetUid ());
-  bool found = false;
-
-  for (ProtocolHandlerList::iterator i = m_handlers.begin ();
-       i != m_handlers.end (); i++)
+  // the index is rebuilt here rather than in RegisterProtocolHandler,
+  // so that a handler may register or unregister handlers while the
+  // handlers of a packet are invoked
+  if (!m_handlerIndexValid)
     {
-      if (i->device == 0 ||
-          (i->device != 0 && i->device == device))
-        {
-          if (i->protocol == 0 || 
-              i->protocol == protocol)
-            {
-              if (promiscuous == i->promiscuous)
-                {
-                  i->handler (device, packet, protocol, from, to, packetType);
-                  found = true;
-                }
-            }
-        }
+      BuildHandlerIndex ();
+    }
+  uint32_t ifIndex = device->GetIfIndex ();
+  NS_ASSERT_MSG (ifIndex < m_devices.size () && m_devices[ifIndex] == device,
+                 "Received packet from a device which does not belong to node " << GetId ());
+  const DeviceHandlerIndex &deviceIndex = (promiscuous ? m_promiscHandlerIndex : m_handlerIndex)[ifIndex];
+  std::map<uint16_t, std::vector<ProtocolHandler> >::const_iterator it = deviceIndex.protocolHandlers.find (protocol);
+  const std::vector<ProtocolHandler> &handlers = (it != deviceIndex.protocolHandlers.end ()) ? it->second : deviceIndex.allProtocolHandlers;
+  for (std::vector<ProtocolHandler>::const_iterator i = handlers.begin ();
+       i != handlers.end (); i++)
+    {
+      (*i) (device, packet, protocol, from, to, packetType);
     }
-  return found;
+  return !handlers.empty ();
 }
 void 
 Node::RegisterDeviceAdditionListener (DeviceAdditionListener listener)
@@ -22,6 +22,7 @@
 #define NODE_H
 
 #include <vector>
+#include <map>
 
 #include "ns3/object.h"
 #include "ns3/callback.h"
@@ -49,6 +50,9 @@ class Address;
  *     through the Socket API.
  *   - a node Id: a unique per-node identifier.
  *   - a system Id: a unique Id used for parallel simulations.
+ *   - a role: what the node is in the radio access network (eNB,
+ *     HeNB, UE, ...), so that the helpers and the models can choose
+ *     the code paths which fit it.
  *
  * Every Node created is added to the NodeList automatically.
  */
@@ -57,6 +61,19 @@ class Node : public Object
 public:
   static TypeId GetTypeId (void);
 
+  /**
+   * Role of a node in the radio access network
+   */
+  enum Role
+  {
+    UNSPECIFIED = 0,  ///< no assumption is made on the node
+    MACRO_ENB,        ///< eNB connected directly to the EPC
+    HOME_ENB,         ///< HeNB, connected to the EPC through the femto gateway
+    RELAY,
+    UE,
+    GATEWAY           ///< SGW/PGW, femto gateway or other core network node
+  };
+
   Node();
   /**
    * \param systemId a unique integer used for parallel simulations.
@@ -79,6 +96,25 @@ public:
    */
   uint32_t GetSystemId (void) const;
 
+  /**
+   * \returns the role of this node
+   */
+  Role GetRole (void) const;
+
+  /**
+   * \param role the role of this node
+   *
+   * The role can also be set with the Role attribute, e.g. as a
+   * default before the nodes are created.
+   */
+  void SetRole (Role role);
+
+  /**
+   * \returns true if the role of this node implies a fixed position:
+   *          eNBs, HeNBs and gateways.
+   */
+  bool IsStationary (void) const;
+
   /**
    * \param device NetDevice to associate to this node.
    * \returns the index of the NetDevice into the Node's list of
@@ -193,7 +229,6 @@ public:
    * \returns true if checksums are enabled, false otherwise.
    */
   static bool ChecksumEnabled (void);
-  bool femto;  /*changed/added*/
 
 protected:
   /**
@@ -213,6 +248,11 @@ private:
 
   void Construct (void);
 
+  /**
+   * Rebuild m_handlerIndex and m_promiscHandlerIndex from m_handlers
+   */
+  void BuildHandlerIndex (void);
+
   struct ProtocolHandlerEntry {
     ProtocolHandler handler;
     Ptr<NetDevice> device;
@@ -222,11 +262,27 @@ private:
   typedef std::vector<struct Node::ProtocolHandlerEntry> ProtocolHandlerList;
   typedef std::vector<DeviceAdditionListener> DeviceAdditionListenerList;
 
+  /**
+   * The handlers to be invoked for the packets received by one device,
+   * in the order in which they were registered: the handlers of each
+   * protocol which has a handler of its own, and the handlers of all
+   * the protocols, invoked for the other protocols.
+   */
+  struct DeviceHandlerIndex {
+    std::map<uint16_t, std::vector<ProtocolHandler> > protocolHandlers;
+    std::vector<ProtocolHandler> allProtocolHandlers;
+  };
+  typedef std::vector<struct Node::DeviceHandlerIndex> HandlerIndex;
+
   uint32_t    m_id;         // Node id for this node
   uint32_t    m_sid;        // System id for this node
+  Role        m_role;       // Role of this node
   std::vector<Ptr<NetDevice> > m_devices;
   std::vector<Ptr<Application> > m_applications;
   ProtocolHandlerList m_handlers;
+  HandlerIndex m_handlerIndex;        // non-promiscuous handlers, by device ifIndex
+  HandlerIndex m_promiscHandlerIndex; // promiscuous handlers, by device ifIndex
+  bool m_handlerIndexValid;           // false when m_handlers or m_devices have changed since the last build
   DeviceAdditionListenerList m_deviceAdditionListeners;
 };
 
@@ -0,0 +1,257 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#include "epc-femto-gw-application.h"
+#include "ns3/log.h"
+#include "ns3/abort.h"
+#include "ns3/boolean.h"
+#include "ns3/inet-socket-address.h"
+
+#include "epc-gtpu-header-template.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("EpcFemtoGwApplication");
+
+NS_OBJECT_ENSURE_REGISTERED (EpcFemtoGwApplication);
+
+
+TypeId
+EpcFemtoGwApplication::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::EpcFemtoGwApplication")
+    .SetParent<Object> ()
+    .AddAttribute ("TranslateTeids",
+                   "If true, the gateway allocates its own TEIDs towards the HeNBs. "
+                   "The TEIDs of a UE are handed over over X2, so a UE with translated "
+                   "TEIDs cannot hand over to a cell outside the gateway: the femto "
+                   "gateway aborts the simulation if one does.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&EpcFemtoGwApplication::m_translateTeids),
+                   MakeBooleanChecker ())
+    ;
+  return tid;
+}
+
+void
+EpcFemtoGwApplication::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_s1uSocket = 0;
+}
+
+
+EpcFemtoGwApplication::EpcFemtoGwApplication (Ptr<Socket> s1uSocket)
+  : m_s1uSocket (s1uSocket),
+    m_gtpuUdpPort (2152), // fixed by the standard
+    m_teidCount (0x80000000)
+{
+  NS_LOG_FUNCTION (this << s1uSocket);
+  m_s1uSocket->SetRecvCallback (MakeCallback (&EpcFemtoGwApplication::RecvFromS1uSocket, this));
+}
+
+
+EpcFemtoGwApplication::~EpcFemtoGwApplication (void)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+EpcFemtoGwApplication::SetSgwS1uAddress (Ipv4Address sgwS1uAddress)
+{
+  m_sgwS1uAddress = sgwS1uAddress;
+}
+
+void
+EpcFemtoGwApplication::AddEnb (uint16_t cellId, Ipv4Address enbS1uAddress)
+{
+  NS_LOG_FUNCTION (this << cellId << enbS1uAddress);
+  m_enbAddrByCellId[cellId] = enbS1uAddress;
+}
+
+Ipv4Address
+EpcFemtoGwApplication::GetEnbAddr (uint16_t cellId) const
+{
+  std::map<uint16_t, Ipv4Address>::const_iterator it = m_enbAddrByCellId.find (cellId);
+  NS_ASSERT_MSG (it != m_enbAddrByCellId.end (), "could not find any HeNB with CellId " << cellId);
+  return it->second;
+}
+
+EpcFemtoGwApplication::TunnelInfo*
+EpcFemtoGwApplication::FindTunnelByEnbTeid (uint32_t enbTeid)
+{
+  std::map<uint32_t, uint32_t>::iterator it = m_enbTeidMap.find (enbTeid);
+  return (it != m_enbTeidMap.end ()) ? &m_tunnels[it->second] : 0;
+}
+
+uint32_t
+EpcFemtoGwApplication::AddTunnel (uint32_t sgwTeid, uint16_t cellId)
+{
+  NS_LOG_FUNCTION (this << sgwTeid << cellId);
+  std::map<uint32_t, uint32_t>::iterator it = m_sgwTeidMap.find (sgwTeid);
+  if (it != m_sgwTeidMap.end ())
+    {
+      TunnelInfo& tunnel = m_tunnels[it->second];
+      tunnel.cellId = cellId;
+      tunnel.enbAddr = GetEnbAddr (cellId);
+      return tunnel.enbTeid;
+    }
+  TunnelInfo tunnel;
+  tunnel.sgwTeid = sgwTeid;
+  if (m_translateTeids)
+    {
+      NS_ABORT_MSG_IF (m_teidCount == 0xffffffff, "TEIDs of the femto gateway exhausted");
+      tunnel.enbTeid = ++m_teidCount;
+    }
+  else
+    {
+      tunnel.enbTeid = sgwTeid;
+    }
+  NS_ASSERT_MSG (m_enbTeidMap.find (tunnel.enbTeid) == m_enbTeidMap.end (), "TEID " << tunnel.enbTeid << " already in use");
+  tunnel.cellId = cellId;
+  tunnel.enbAddr = GetEnbAddr (cellId);
+  tunnel.counters.ulPackets = 0;
+  tunnel.counters.ulBytes = 0;
+  tunnel.counters.dlPackets = 0;
+  tunnel.counters.dlBytes = 0;
+  m_sgwTeidMap[tunnel.sgwTeid] = m_tunnels.size ();
+  m_enbTeidMap[tunnel.enbTeid] = m_tunnels.size ();
+  m_tunnels.push_back (tunnel);
+  return tunnel.enbTeid;
+}
+
+void
+EpcFemtoGwApplication::SetTunnel (uint32_t enbTeid, uint16_t cellId)
+{
+  NS_LOG_FUNCTION (this << enbTeid << cellId);
+  TunnelInfo* tunnel = FindTunnelByEnbTeid (enbTeid);
+  if (tunnel == 0)
+    {
+      // a UE coming from a cell outside the gateway, whose TEID has
+      // been allocated by the SGW
+      NS_ASSERT_MSG (m_sgwTeidMap.find (enbTeid) == m_sgwTeidMap.end (), "TEID " << enbTeid << " already in use");
+      TunnelInfo newTunnel;
+      newTunnel.sgwTeid = enbTeid;
+      newTunnel.enbTeid = enbTeid;
+      newTunnel.counters.ulPackets = 0;
+      newTunnel.counters.ulBytes = 0;
+      newTunnel.counters.dlPackets = 0;
+      newTunnel.counters.dlBytes = 0;
+      m_sgwTeidMap[enbTeid] = m_tunnels.size ();
+      m_enbTeidMap[enbTeid] = m_tunnels.size ();
+      m_tunnels.push_back (newTunnel);
+      tunnel = &m_tunnels.back ();
+    }
+  tunnel->cellId = cellId;
+  tunnel->enbAddr = GetEnbAddr (cellId);
+}
+
+void
+EpcFemtoGwApplication::RemoveTunnel (uint32_t enbTeid)
+{
+  NS_LOG_FUNCTION (this << enbTeid);
+  std::map<uint32_t, uint32_t>::iterator it = m_enbTeidMap.find (enbTeid);
+  if (it == m_enbTeidMap.end ())
+    {
+      return;
+    }
+  uint32_t index = it->second;
+  m_sgwTeidMap.erase (m_tunnels[index].sgwTeid);
+  m_enbTeidMap.erase (it);
+  if (index != m_tunnels.size () - 1)
+    {
+      // move the last tunnel in the hole
+      m_tunnels[index] = m_tunnels.back ();
+      m_sgwTeidMap[m_tunnels[index].sgwTeid] = index;
+      m_enbTeidMap[m_tunnels[index].enbTeid] = index;
+    }
+  m_tunnels.pop_back ();
+}
+
+bool
+EpcFemtoGwApplication::IsTranslated (uint32_t enbTeid) const
+{
+  std::map<uint32_t, uint32_t>::const_iterator it = m_enbTeidMap.find (enbTeid);
+  return (it != m_enbTeidMap.end ()) && (m_tunnels[it->second].sgwTeid != enbTeid);
+}
+
+EpcFemtoGwApplication::TunnelCounters
+EpcFemtoGwApplication::GetTunnelCounters (uint32_t enbTeid) const
+{
+  std::map<uint32_t, uint32_t>::const_iterator it = m_enbTeidMap.find (enbTeid);
+  NS_ASSERT_MSG (it != m_enbTeidMap.end (), "unknown TEID " << enbTeid);
+  return m_tunnels[it->second].counters;
+}
+
+uint32_t
+EpcFemtoGwApplication::GetNTunnels () const
+{
+  return m_tunnels.size ();
+}
+
+void
+EpcFemtoGwApplication::RecvFromS1uSocket (Ptr<Socket> socket)
+{
+  NS_LOG_FUNCTION (this << socket);
+  NS_ASSERT (socket == m_s1uSocket);
+  Address from;
+  Ptr<Packet> packet = socket->RecvFrom (from);
+
+  // workaround for bug 231 https://www.nsnam.org/bugzilla/show_bug.cgi?id=231
+  SocketAddressTag tag;
+  packet->RemovePacketTag (tag);
+
+  uint32_t size = packet->GetSize ();
+  // the TEID is rewritten in the received header, which is added back
+  // as it is
+  GtpuHeaderTemplate gtpu;
+  packet->RemoveHeader (gtpu);
+  uint32_t teid = gtpu.GetTeid ();
+  uint32_t flags = 0;
+  if (InetSocketAddress::ConvertFrom (from).GetIpv4 () == m_sgwS1uAddress)
+    {
+      std::map<uint32_t, uint32_t>::iterator it = m_sgwTeidMap.find (teid);
+      if (it == m_sgwTeidMap.end ())
+        {
+          NS_LOG_WARN ("unknown downlink TEID " << teid << ", discarding packet");
+          return;
+        }
+      TunnelInfo& tunnel = m_tunnels[it->second];
+      NS_LOG_LOGIC ("downlink TEID " << teid << " -> " << tunnel.enbTeid << " to HeNB " << tunnel.enbAddr);
+      ++tunnel.counters.dlPackets;
+      tunnel.counters.dlBytes += size;
+      gtpu.SetTeid (tunnel.enbTeid);
+      packet->AddHeader (gtpu);
+      m_s1uSocket->SendTo (packet, flags, InetSocketAddress (tunnel.enbAddr, m_gtpuUdpPort));
+    }
+  else
+    {
+      TunnelInfo* tunnel = FindTunnelByEnbTeid (teid);
+      if (tunnel == 0)
+        {
+          NS_LOG_WARN ("unknown uplink TEID " << teid << ", discarding packet");
+          return;
+        }
+      NS_LOG_LOGIC ("uplink TEID " << teid << " -> " << tunnel->sgwTeid);
+      ++tunnel->counters.ulPackets;
+      tunnel->counters.ulBytes += size;
+      gtpu.SetTeid (tunnel->sgwTeid);
+      packet->AddHeader (gtpu);
+      m_s1uSocket->SendTo (packet, flags, InetSocketAddress (m_sgwS1uAddress, m_gtpuUdpPort));
+    }
+}
+
+} // namespace ns3
@@ -0,0 +1,213 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#ifndef EPC_FEMTO_GW_APPLICATION_H
+#define EPC_FEMTO_GW_APPLICATION_H
+
+#include <ns3/application.h>
+#include <ns3/socket.h>
+#include <ns3/ipv4-address.h>
+
+#include <map>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup lte
+ *
+ * Data plane of the femto gateway. For the SGW, the gateway is the S1-U
+ * endpoint of all the cells of its HeNBs: the SGW sends the downlink
+ * GTP-U packets of a femto UE to the gateway, which relays them to the
+ * HeNB currently serving the tunnel, and the HeNBs send their uplink
+ * GTP-U packets to the gateway, which relays them to the SGW.
+ *
+ * Each tunnel has a TEID towards the SGW and a TEID towards the HeNBs.
+ * The gateway terminates GTP-U on each side and re-originates it on
+ * the other side with the TEID translated, in a single hop: the packets
+ * never go through a tun device or the IP forwarding of the gateway.
+ *
+ * Since the SGW does not know which HeNB serves a tunnel, a handover
+ * between two HeNBs of the gateway is completed by re-pointing the
+ * tunnel with SetTunnel, without any signalling towards the SGW.
+ */
+class EpcFemtoGwApplication : public Application
+{
+public:
+  static TypeId GetTypeId (void);
+protected:
+  void DoDispose (void);
+
+public:
+
+  /**
+   * Constructor
+   *
+   * \param s1uSocket the socket to be used to send/receive GTP-U packets
+   * to/from both the HeNBs and the SGW
+   */
+  EpcFemtoGwApplication (Ptr<Socket> s1uSocket);
+
+  /**
+   * Destructor
+   */
+  virtual ~EpcFemtoGwApplication (void);
+
+  /**
+   * \param sgwS1uAddress the IPv4 address at which the gateway reaches the SGW
+   */
+  void SetSgwS1uAddress (Ipv4Address sgwS1uAddress);
+
+  /**
+   * Add a new HeNB to the gateway
+   *
+   * \param cellId the cell ID of the HeNB
+   * \param enbS1uAddress the S1-U address of the HeNB
+   */
+  void AddEnb (uint16_t cellId, Ipv4Address enbS1uAddress);
+
+  /**
+   * Create the tunnel of a new bearer, or re-point the existing tunnel
+   * of the same SGW TEID
+   *
+   * \param sgwTeid the TEID of the tunnel at the SGW
+   * \param cellId the cell ID of the HeNB which terminates the tunnel
+   * \return the TEID of the tunnel towards the HeNBs, which is sgwTeid
+   * itself unless TranslateTeids is set
+   */
+  uint32_t AddTunnel (uint32_t sgwTeid, uint16_t cellId);
+
+  /**
+   * Re-point a tunnel. A tunnel which is not known yet, i.e., the
+   * tunnel of a UE coming from a cell outside the gateway, is created
+   * with the same TEID on both sides.
+   *
+   * \param enbTeid the TEID of the tunnel towards the HeNBs
+   * \param cellId the cell ID of the HeNB which now terminates the tunnel
+   */
+  void SetTunnel (uint32_t enbTeid, uint16_t cellId);
+
+  /**
+   * Remove a tunnel, e.g., when its UE has left the gateway; a tunnel
+   * which does not exist is ignored
+   *
+   * \param enbTeid the TEID of the tunnel towards the HeNBs
+   */
+  void RemoveTunnel (uint32_t enbTeid);
+
+  /**
+   * \param enbTeid the TEID of the tunnel towards the HeNBs
+   * \return true if the tunnel exists and its TEID towards the HeNBs
+   * differs from its TEID at the SGW
+   */
+  bool IsTranslated (uint32_t enbTeid) const;
+
+  /**
+   * Packets and bytes relayed on a tunnel, GTP-U header included
+   */
+  struct TunnelCounters
+  {
+    uint64_t ulPackets;
+    uint64_t ulBytes;
+    uint64_t dlPackets;
+    uint64_t dlBytes;
+  };
+
+  /**
+   * \param enbTeid the TEID of the tunnel towards the HeNBs
+   * \return the counters of the tunnel
+   */
+  TunnelCounters GetTunnelCounters (uint32_t enbTeid) const;
+
+  /**
+   * \return the number of tunnels of the gateway
+   */
+  uint32_t GetNTunnels () const;
+
+  /**
+   * Method to be assigned to the recv callback of the S1-U socket
+   *
+   * \param socket pointer to the S1-U socket
+   */
+  void RecvFromS1uSocket (Ptr<Socket> socket);
+
+private:
+
+  /**
+   * A GTP-U tunnel relayed by the gateway
+   */
+  struct TunnelInfo
+  {
+    uint32_t sgwTeid;
+    uint32_t enbTeid;
+    uint16_t cellId;
+    Ipv4Address enbAddr;
+    TunnelCounters counters;
+  };
+
+  /**
+   * \param enbTeid the TEID of the tunnel towards the HeNBs
+   * \return the tunnel, or 0 if it does not exist
+   */
+  TunnelInfo* FindTunnelByEnbTeid (uint32_t enbTeid);
+
+  /**
+   * \param cellId the cell ID of a HeNB
+   * \return the S1-U address of the HeNB, which must exist
+   */
+  Ipv4Address GetEnbAddr (uint16_t cellId) const;
+
+  /**
+   * UDP socket to send and receive the GTP-U packets
+   */
+  Ptr<Socket> m_s1uSocket;
+
+  /**
+   * address of the SGW which terminates all S1-U tunnels
+   */
+  Ipv4Address m_sgwS1uAddress;
+
+  /**
+   * UDP port to be used for GTP
+   */
+  uint16_t m_gtpuUdpPort;
+
+  /**
+   * S1-U address of each HeNB, by cell ID
+   */
+  std::map<uint16_t, Ipv4Address> m_enbAddrByCellId;
+
+  /**
+   * the tunnels, indexed by m_sgwTeidMap and m_enbTeidMap
+   */
+  std::vector<TunnelInfo> m_tunnels;
+  std::map<uint32_t, uint32_t> m_sgwTeidMap;
+  std::map<uint32_t, uint32_t> m_enbTeidMap;
+
+  bool m_translateTeids;
+
+  /**
+   * last TEID allocated towards the HeNBs; the TEIDs of the gateway
+   * start at 0x80000000 so that they cannot clash with the TEIDs of
+   * the SGW, which are used unchanged for the tunnels created by
+   * SetTunnel
+   */
+  uint32_t m_teidCount;
+};
+
+} // namespace ns3
+
+#endif // EPC_FEMTO_GW_APPLICATION_H
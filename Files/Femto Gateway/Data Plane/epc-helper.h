@@ -37,6 +37,11 @@ class VirtualNetDevice;
 class EpcSgwPgwApplication;
 class EpcX2;
 class EpcMme;
+class FemtoGW;
+class EpcFemtoGwApplication;
+class EpcS1uDirectSocket;
+class EpcS1apTransport;
+class HandoverLatencyStats;
 
 /**
  * \brief Helper class to handle the creation of the EPC entities and protocols.
@@ -44,7 +49,9 @@ class EpcMme;
  * This Helper will create an EPC network topology comprising of a
  * single node that implements both the SGW and PGW functionality, and
  * is connected to all the eNBs in the simulation by means of the S1-U
- * interface. 
+ * interface. The femto eNBs (HeNBs) are instead connected to a femto
+ * gateway node by one access link each, and the femto gateway is
+ * connected to the SGW by a single backhaul link.
  */
 class EpcHelper : public Object
 {
@@ -69,7 +76,8 @@ public:
    * Add an eNB to the EPC
    * 
    * \param enbNode the previosuly created eNB node which is to be
-   * added to the EPC
+   * added to the EPC; it is connected through the femto gateway if its
+   * role is Node::HOME_ENB, otherwise directly to the SGW
    * \param lteEnbNetDevice the LteEnbNetDevice of the eNB node
    * \param cellId ID of the eNB
    */
@@ -115,6 +123,13 @@ public:
    */
   Ptr<Node> GetPgwNode ();
 
+  /** 
+   * 
+   * \return the femto gateway, which concentrates the S1-AP
+   * signalling of all the femto eNBs (HeNBs)
+   */
+  Ptr<FemtoGW> GetFemtoGw ();
+
   /** 
    * Assign IPv4 addresses to UE devices
    * 
@@ -131,6 +146,15 @@ public:
    */
   Ipv4Address GetUeDefaultGatewayAddress ();
 
+  /** 
+   * Collect the latency of each stage of the X2 handovers, per cell
+   * pair. To be called once all the eNB and UE devices have been
+   * installed.
+   * 
+   * \return the statistics, filled as the simulation runs
+   */
+  Ptr<HandoverLatencyStats> EnableHandoverLatencyStats ();
+
 
 
 private:
@@ -146,14 +170,19 @@ private:
   
   Ptr<Node> m_sgwPgw;
   Ptr<Node> m_sgwPgw2;    /*added*/
-  Ptr<Node> m_sgwPgw3;    /*added*/
   Ptr<EpcSgwPgwApplication> m_sgwPgwApp;
-  Ptr<EpcSgwPgwApplication> m_sgwPgwApp2; /*added*/
-  Ptr<EpcSgwPgwApplication> m_sgwPgwApp3; /*added*/
   Ptr<VirtualNetDevice> m_tunDevice;
-  Ptr<VirtualNetDevice> m_tunDevice2;    /*added*/
-  Ptr<VirtualNetDevice> m_tunDevice3;    /*added*/
   Ptr<EpcMme> m_mme;
+  Ptr<FemtoGW> m_femtoGw;
+  Ptr<EpcFemtoGwApplication> m_femtoGwApp;
+  Ptr<HandoverLatencyStats> m_handoverLatencyStats;
+
+  /**
+   * S1-U sockets of the SGW and of the femto gateway, which skip the
+   * UDP/IP stack towards the endpoints linked to them
+   */
+  Ptr<EpcS1uDirectSocket> m_sgwPgwS1uSocket;
+  Ptr<EpcS1uDirectSocket> m_femtoGwS1uSocket;
 
   /**
    * S1-U interfaces
@@ -164,19 +193,68 @@ private:
    */
   Ipv4AddressHelper m_s1uIpv4AddressHelper;
  /** 
-   * helper to assign addresses to S1-U NetDevices (between femtogateway and sgw ; femtogateway and femto) 
+   * helper to assign addresses to the S1-U access links between the HeNBs and the femto gateway
  */
   Ipv4AddressHelper m_s1u_femtogw_Ipv4AddressHelper; /*added*/ 
 
+  /** 
+   * Install the backhaul link between the femto gateway and the SGW,
+   * the first time a HeNB is added
+   */
+  void InstallFemtoGwBackhaul ();
+
+  bool m_femtoGwBackhaulInstalled;
+  /**
+   * Create the S1-AP endpoint of a node, with its UDP socket, and
+   * aggregate it to the node
+   *
+   * \param node the node
+   * \return the S1-AP endpoint
+   */
+  Ptr<EpcS1apTransport> InstallS1apTransport (Ptr<Node> node);
+
+  /**
+   * S1-AP endpoints of the SGW/PGW node, where the MME is, and of the
+   * femto gateway, if the S1-AP messages are serialized
+   */
+  Ptr<EpcS1apTransport> m_mmeS1apTransport;
+  Ptr<EpcS1apTransport> m_femtoGwS1apTransport;
+  bool m_s1apSerialized;
+
+  /**
+   * address of the femto gateway on its backhaul link, which is the
+   * S1-U address of all the HeNBs for the SGW
+   */
+  Ipv4Address m_femtoGwS1uAddress;
+  /**
+   * address of the SGW on the backhaul link of the femto gateway
+   */
+  Ipv4Address m_sgwFemtoGwS1uAddress;
+  DataRate m_femtoGwBackhaulLinkDataRate;
+  Time     m_femtoGwBackhaulLinkDelay;
+
   DataRate m_s1uLinkDataRate;
   Time     m_s1uLinkDelay;
   uint16_t m_s1uLinkMtu;
+  bool     m_s1uDirect;
 
   /**
    * UDP port where the GTP-U Socket is bound, fixed by the standard as 2152
    */
   uint16_t m_gtpuUdpPort;
 
+  /**
+   * UDP port where the X2-U Socket of the eNBs is bound, used to
+   * forward the downlink packets of the UEs during handover
+   */
+  uint16_t m_x2uUdpPort;
+
+  /**
+   * UDP port where the S1-AP Socket of the eNBs, of the femto gateway
+   * and of the SGW/PGW node is bound, if the S1-AP messages are serialized
+   */
+  uint16_t m_s1apUdpPort;
+
   /**
    * Map storing for each IMSI the corresponding eNB NetDevice
    * 
@@ -27,29 +27,141 @@
 #include <ns3/uinteger.h>
 #include <ns3/string.h>
 #include <ns3/boolean.h>
+#include <ns3/enum.h>
 #include <ns3/spectrum-channel.h>
 #include <ns3/config.h>
 #include <ns3/rem-spectrum-phy.h>
 #include <ns3/buildings-mobility-model.h>
 #include <ns3/simulator.h>
 #include <ns3/node.h>
-#include <ns3/buildings-helper.h>
+#include <ns3/building-grid-index.h>
+#include <ns3/building-list.h>
+#include <ns3/building.h>
+#include <ns3/box.h>
 #include <ns3/lte-spectrum-value-helper.h>
+#include <ns3/pointer.h>
+#include <ns3/object-factory.h>
+#include <ns3/node-list.h>
+#include <ns3/lte-enb-net-device.h>
+#include <ns3/lte-enb-phy.h>
+#include <ns3/lte-spectrum-phy.h>
+#include <ns3/antenna-model.h>
+#include <ns3/angles.h>
+#include <ns3/propagation-loss-model.h>
+#include <ns3/spectrum-converter.h>
 
 #include <fstream>
+#include <sstream>
+#include <algorithm>
 #include <limits>
+#include <cmath>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 NS_LOG_COMPONENT_DEFINE ("RadioEnvironmentMapHelper");
 
 namespace ns3 {
 
+/**
+ * \param description a string
+ * \return the FNV-1a hash of the string
+ */
+static uint64_t
+HashString (const std::string &description)
+{
+  uint64_t hash = 14695981039346656037ULL;
+  for (std::string::const_iterator it = description.begin (); it != description.end (); ++it)
+    {
+      hash ^= (uint8_t) *it;
+      hash *= 1099511628211ULL;
+    }
+  return hash;
+}
+
+/**
+ * \param object an object
+ * \return a hash of the type of the object and of the values of its
+ * attributes, including those of its parent types. The attributes
+ * which point to other objects are not included, since their value is
+ * an address.
+ */
+static uint64_t
+HashObjectAttributes (Ptr<const Object> object)
+{
+  std::ostringstream oss;
+  TypeId tid = object->GetInstanceTypeId ();
+  oss << tid.GetName ();
+  while (true)
+    {
+      for (uint32_t i = 0; i < tid.GetAttributeN (); ++i)
+        {
+          struct TypeId::AttributeInformation info = tid.GetAttribute (i);
+          std::string valueType = info.checker->GetValueTypeName ();
+          if (!(info.flags & TypeId::ATTR_GET) || !info.accessor->HasGetter ()
+              || (valueType == "ns3::PointerValue") || (valueType == "ns3::ObjectPtrContainerValue"))
+            {
+              continue;
+            }
+          Ptr<AttributeValue> value = info.checker->Create ();
+          if (object->GetAttributeFailSafe (info.name, *value))
+            {
+              oss << ";" << info.name << "=" << value->SerializeToString (info.checker);
+            }
+        }
+      TypeId parent = tid.GetParent ();
+      if (parent == tid)
+        {
+          break;
+        }
+      tid = parent;
+    }
+  return HashString (oss.str ());
+}
+
+/**
+ * \return a hash of the boxes, types, external walls, floors and rooms
+ * of all the buildings, in the order of the BuildingList
+ */
+static uint64_t
+HashBuildings ()
+{
+  std::ostringstream oss;
+  oss.precision (17);
+  for (BuildingList::Iterator it = BuildingList::Begin (); it != BuildingList::End (); ++it)
+    {
+      Box box = (*it)->GetBoundaries ();
+      oss << box.xMin << "," << box.xMax << "," << box.yMin << "," << box.yMax
+          << "," << box.zMin << "," << box.zMax
+          << "," << (uint32_t) (*it)->GetBuildingType ()
+          << "," << (uint32_t) (*it)->GetExtWallsType ()
+          << "," << (*it)->GetNFloors ()
+          << "," << (*it)->GetNRoomsX ()
+          << "," << (*it)->GetNRoomsY () << ";";
+    }
+  return HashString (oss.str ());
+}
 
 
 NS_OBJECT_ENSURE_REGISTERED (RadioEnvironmentMapHelper);
 
 RadioEnvironmentMapHelper::RadioEnvironmentMapHelper ()
+  : m_offline (false),
+    m_nWorkers (1),
+    m_tileSize (1000),
+    m_outputFormat (BINARY_OUTPUT),
+    m_nWritten (0),
+    m_nServers (1),
+    m_hysteresisDb (3.0),
+    m_adaptive (false),
+    m_adaptiveStep (16),
+    m_adaptiveThresholdDb (1.0),
+    m_nEvaluated (0),
+    m_contributions (0),
+    m_nDirty (0)
 {
-pause=false;
 }
 
 
@@ -63,6 +175,9 @@ void
 RadioEnvironmentMapHelper::DoDispose ()
 {
   NS_LOG_FUNCTION (this);
+  m_transmitters.clear ();
+  m_pathlossModel = 0;
+  m_raster = 0;
 }
 
 TypeId
@@ -80,6 +195,11 @@ RadioEnvironmentMapHelper::GetTypeId (void)
                    StringValue ("rem.out"),
                    MakeStringAccessor (&RadioEnvironmentMapHelper::m_outputFile),
                    MakeStringChecker ())
+    .AddAttribute ("OutputFormat", "the format of the output file: a binary raster (see RemFileHeader) or one text line per point",
+                   EnumValue (RadioEnvironmentMapHelper::BINARY_OUTPUT),
+                   MakeEnumAccessor (&RadioEnvironmentMapHelper::m_outputFormat),
+                   MakeEnumChecker (RadioEnvironmentMapHelper::BINARY_OUTPUT, "Binary",
+                                    RadioEnvironmentMapHelper::TEXT_OUTPUT, "Text"))
     .AddAttribute ("XMin", "The min x coordinate of the map.",
                    DoubleValue (0.0),
                    MakeDoubleAccessor (&RadioEnvironmentMapHelper::m_xMin),
@@ -133,6 +253,71 @@ RadioEnvironmentMapHelper::GetTypeId (void)
                    MakeUintegerAccessor (&RadioEnvironmentMapHelper::SetBandwidth, 
                                          &RadioEnvironmentMapHelper::GetBandwidth),
                    MakeUintegerChecker<uint16_t> ())
+    .AddAttribute ("Offline",
+                   "If true, the REM is computed when Install () is called from a snapshot of the eNB transmitters, "
+                   "without any simulator event. The PathlossModel attribute must be set.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&RadioEnvironmentMapHelper::m_offline),
+                   MakeBooleanChecker ())
+    .AddAttribute ("NumWorkers",
+                   "Number of worker processes computing the tiles of the offline REM; "
+                   "more than one requires a deterministic PathlossModel (e.g., no shadowing)",
+                   UintegerValue (1),
+                   MakeUintegerAccessor (&RadioEnvironmentMapHelper::m_nWorkers),
+                   MakeUintegerChecker<uint32_t> (1, 1024))
+    .AddAttribute ("TileSize",
+                   "Number of REM points in each tile of the offline REM",
+                   UintegerValue (1000),
+                   MakeUintegerAccessor (&RadioEnvironmentMapHelper::m_tileSize),
+                   MakeUintegerChecker<uint32_t> (1, std::numeric_limits<uint32_t>::max ()))
+    .AddAttribute ("PathlossModel",
+                   "The pathloss model used by the offline REM; it should be configured like "
+                   "the one of the channel for which the REM is generated.",
+                   PointerValue (),
+                   MakePointerAccessor (&RadioEnvironmentMapHelper::m_pathlossModel),
+                   MakePointerChecker<PropagationLossModel> ())
+    .AddAttribute ("NumServers",
+                   "Number of strongest cells by RSRP recorded for each point of the offline REM",
+                   UintegerValue (1),
+                   MakeUintegerAccessor (&RadioEnvironmentMapHelper::m_nServers),
+                   MakeUintegerChecker<uint32_t> (1, 16))
+    .AddAttribute ("HandoverHysteresis",
+                   "The RSRP difference [dB] between the two strongest cells below which a point "
+                   "is considered on the handover boundary",
+                   DoubleValue (3.0),
+                   MakeDoubleAccessor (&RadioEnvironmentMapHelper::m_hysteresisDb),
+                   MakeDoubleChecker<double> (0.0))
+    .AddAttribute ("BoundaryFile",
+                   "If not empty, the filename to which the handover boundary of the offline REM is saved "
+                   "(requires NumServers >= 2)",
+                   StringValue (""),
+                   MakeStringAccessor (&RadioEnvironmentMapHelper::m_boundaryFile),
+                   MakeStringChecker ())
+    .AddAttribute ("Adaptive",
+                   "If true, the offline REM evaluates a coarse grid first, and then recursively splits only the cells "
+                   "whose corners have different best servers or SINRs differing by more than AdaptiveThreshold; "
+                   "the other points are interpolated",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&RadioEnvironmentMapHelper::m_adaptive),
+                   MakeBooleanChecker ())
+    .AddAttribute ("AdaptiveStep",
+                   "Size of the cells of the coarse grid of the adaptive REM, in number of XRes x YRes grid steps",
+                   UintegerValue (16),
+                   MakeUintegerAccessor (&RadioEnvironmentMapHelper::m_adaptiveStep),
+                   MakeUintegerChecker<uint32_t> (1, std::numeric_limits<uint16_t>::max ()))
+    .AddAttribute ("AdaptiveThreshold",
+                   "Maximum SINR difference [dB] between the corners of a cell of the adaptive REM which is not split",
+                   DoubleValue (1.0),
+                   MakeDoubleAccessor (&RadioEnvironmentMapHelper::m_adaptiveThresholdDb),
+                   MakeDoubleChecker<double> (0.0))
+    .AddAttribute ("CacheFile",
+                   "If not empty, the file where the offline REM saves the power received from each "
+                   "transmitter at each point, and from which the contributions of the unchanged "
+                   "transmitters are read back in the next runs. Not supported in adaptive mode "
+                   "nor with a random PathlossModel (e.g., with shadowing).",
+                   StringValue (""),
+                   MakeStringAccessor (&RadioEnvironmentMapHelper::m_cacheFile),
+                   MakeStringChecker ())
   ;
   return tid;
 }
@@ -182,10 +367,45 @@ RadioEnvironmentMapHelper::Install ()
   m_channel = match.Get (0)->GetObject<SpectrumChannel> ();
   NS_ABORT_MSG_IF (m_channel == 0, "object at " << m_channelPath << "is not of type SpectrumChannel");
 
-  m_outFile.open (m_outputFile.c_str ());
-  if (!m_outFile.is_open ())
+  // RemSpectrumPhy does not tell which transmitter is the strongest, so
+  // the event-driven raster holds the SINR only
+  NS_ABORT_MSG_IF (!m_offline && !m_boundaryFile.empty (), "BoundaryFile needs Offline=true");
+  m_raster = Create<RemRaster> (m_xMin, m_xMax, m_xRes, m_yMin, m_yMax, m_yRes, m_z,
+                                m_offline ? m_nServers : 0);
+  m_nWritten = 0;
+
+  if (m_outputFormat == BINARY_OUTPUT)
     {
-      NS_FATAL_ERROR ("Can't open file " << (m_outputFile));
+      RemFileHeader header;
+      std::memset (&header, 0, sizeof (header));
+      header.xMin = m_xMin;
+      header.xMax = m_xMax;
+      header.yMin = m_yMin;
+      header.yMax = m_yMax;
+      header.z = m_z;
+      header.xRes = m_xRes;
+      header.yRes = m_yRes;
+      header.earfcn = m_earfcn;
+      header.bandwidth = m_bandwidth;
+      if (!m_binaryFile.Open (m_outputFile, header))
+        {
+          NS_FATAL_ERROR ("Can't open file " << (m_outputFile));
+          return;
+        }
+    }
+  else
+    {
+      m_outFile.open (m_outputFile.c_str ());
+      if (!m_outFile.is_open ())
+        {
+          NS_FATAL_ERROR ("Can't open file " << (m_outputFile));
+          return;
+        }
+    }
+
+  if (m_offline)
+    {
+      RunOffline ();
       return;
     }
   
@@ -270,7 +490,7 @@ RadioEnvironmentMapHelper::RunOneIteration (double xMin, double xMax, double yMi
         {
           NS_ASSERT (remIt != m_rem.end ());          
           remIt->bmm->SetPosition (Vector (x, y, m_z));
-          BuildingsHelper::MakeConsistent (remIt->bmm);
+          BuildingGridIndex::MakeConsistent (remIt->bmm);
           ++remIt;
         }      
     }
@@ -293,7 +513,6 @@ void
 RadioEnvironmentMapHelper::PrintAndReset ()
 {
   NS_LOG_FUNCTION (this);
-  if(pause==false){
   for (std::list<RemPoint>::iterator it = m_rem.begin ();
        it != m_rem.end ();
        ++it)
@@ -305,34 +524,770 @@ RadioEnvironmentMapHelper::PrintAndReset ()
           break;
         }
       Vector pos = it->bmm->GetPosition ();
+      double sinr = it->phy->GetSinr (m_noisePower);
       NS_LOG_LOGIC ("output: " << pos.x << "\t" 
                     << pos.y << "\t" 
                     << pos.z << "\t" 
-                    << it->phy->GetSinr (m_noisePower));
+                    << sinr);
+      WritePoint (pos, sinr, 0);
+      it->phy->Reset ();
+    }
+}
+
+Ptr<const RemRaster>
+RadioEnvironmentMapHelper::GetRaster () const
+{
+  return m_raster;
+}
+
+Ptr<RemRaster>
+RadioEnvironmentMapHelper::GetSnapshot () const
+{
+  NS_ASSERT_MSG (m_raster != 0, "Install () has not been called");
+  return Create<RemRaster> (*m_raster);
+}
+
+void 
+RadioEnvironmentMapHelper::WritePoint (const Vector &pos, double sinr, const RemServer *servers)
+{
+  if (m_outputFormat == BINARY_OUTPUT)
+    {
+      m_binaryFile.Write (sinr);
+    }
+  else
+    {
+      // no std::endl, which would flush the stream at every point
       m_outFile << pos.x << "\t" 
                 << pos.y << "\t" 
                 << pos.z << "\t" 
-                << it->phy->GetSinr (m_noisePower)
-                << std::endl;
-      struct mystruct *data;
-      data=(struct mystruct *)malloc(sizeof(struct mystruct));
-      data->x=pos.x;
-      data->y=pos.y;
-      data->z=pos.z;
-      data->sinr=it->phy->GetSinr (m_noisePower);
-      //struct mystruct dat;
-      //&dat=data;
-      pos_sinr.push_back(*data);
-      it->phy->Reset ();
+                << sinr
+                << "\n";
     }
-  }
+  // the points are generated with y as the inner index
+  if (m_nWritten < m_raster->GetXRes () * m_raster->GetYRes ())
+    {
+      m_raster->Set (m_nWritten / m_raster->GetYRes (), m_nWritten % m_raster->GetYRes (), sinr, servers);
+    }
+  ++m_nWritten;
+}
+
+void 
+RadioEnvironmentMapHelper::SnapshotTransmitters ()
+{
+  NS_LOG_FUNCTION (this);
+  Ptr<const SpectrumModel> rxSpectrumModel = LteSpectrumValueHelper::GetSpectrumModel (m_earfcn, m_bandwidth);
+  m_transmitters.clear ();
+  for (NodeList::Iterator it = NodeList::Begin (); it != NodeList::End (); ++it)
+    {
+      Ptr<Node> node = *it;
+      if (node->GetRole () == Node::UE || node->GetRole () == Node::GATEWAY)
+        {
+          // no eNB device to look for
+          continue;
+        }
+      for (uint32_t j = 0; j < node->GetNDevices (); ++j)
+        {
+          Ptr<LteEnbNetDevice> enbDev = node->GetDevice (j)->GetObject<LteEnbNetDevice> ();
+          if (enbDev == 0)
+            {
+              continue;
+            }
+          UintegerValue earfcn;
+          UintegerValue bandwidth;
+          DoubleValue txPower;
+          enbDev->GetAttribute ("DlEarfcn", earfcn);
+          enbDev->GetAttribute ("DlBandwidth", bandwidth);
+          Ptr<LteEnbPhy> phy = enbDev->GetPhy ();
+          phy->GetAttribute ("TxPower", txPower);
+
+          // the reference signal is transmitted over the whole bandwidth
+          std::vector<int> activeRbs;
+          for (int rb = 0; rb < (int) bandwidth.Get (); ++rb)
+            {
+              activeRbs.push_back (rb);
+            }
+          Ptr<SpectrumValue> psd = LteSpectrumValueHelper::CreateTxPowerSpectralDensity (earfcn.Get (), bandwidth.Get (), txPower.Get (), activeRbs);
+          if (psd->GetSpectrumModelUid () != rxSpectrumModel->GetUid ())
+            {
+              // same conversion as done by MultiModelSpectrumChannel
+              SpectrumConverter converter (psd->GetSpectrumModel (), rxSpectrumModel);
+              psd = converter.Convert (psd);
+            }
+
+          RemTransmitter tx;
+          tx.mobility = node->GetObject<MobilityModel> ();
+          tx.antenna = phy->GetDownlinkSpectrumPhy ()->GetRxAntenna ();
+          tx.psd = psd;
+          NS_ASSERT_MSG (tx.mobility != 0, "eNB node " << node->GetId () << " has no MobilityModel");
+          tx.cellId = enbDev->GetCellId ();
+          tx.position = tx.mobility->GetPosition ();
+          tx.txPowerDbm = txPower.Get ();
+          tx.earfcn = earfcn.Get ();
+          tx.bandwidth = bandwidth.Get ();
+          tx.antennaHash = (tx.antenna != 0) ? HashObjectAttributes (tx.antenna) : 0;
+          tx.dirty = true;
+          tx.nodeId = node->GetId ();
+          tx.deviceIndex = j;
+          m_transmitters.push_back (tx);
+        }
+    }
+  // the powers are summed in the order in which the channel delivers
+  // the signals of a subframe to a RemSpectrumPhy, so that the float
+  // sums are the same as in the event-driven REM
+  std::sort (m_transmitters.begin (), m_transmitters.end (), IsDeliveredBefore);
+  m_nDirty = m_transmitters.size ();
+  NS_LOG_LOGIC ("offline REM with " << m_transmitters.size () << " transmitters");
+}
+
+bool
+RadioEnvironmentMapHelper::IsDeliveredBefore (const RemTransmitter &a, const RemTransmitter &b)
+{
+  // the eNB PHYs start their frames when their device is started, i.e.,
+  // by node ID and then by device index, and all of them transmit at the
+  // start of each subframe. The LTE channels have no propagation delay
+  // model, so MultiModelSpectrumChannel delivers these signals in the
+  // order of transmission.
+  if (a.nodeId != b.nodeId)
+    {
+      return a.nodeId < b.nodeId;
+    }
+  return a.deviceIndex < b.deviceIndex;
+}
+
+double
+RadioEnvironmentMapHelper::ComputeRxPower (Ptr<BuildingsMobilityModel> rx, const RemTransmitter &tx)
+{
+  // same gain computation as MultiModelSpectrumChannel::StartTx
+  double pathLossDb = 0;
+  if (tx.antenna != 0)
+    {
+      Angles txAngles (rx->GetPosition (), tx.mobility->GetPosition ());
+      pathLossDb -= tx.antenna->GetGainDb (txAngles);
+    }
+  pathLossDb -= m_pathlossModel->CalcRxPower (0, tx.mobility, rx);
+  double pathGainLinear = std::pow (10.0, (-pathLossDb) / 10.0);
+  SpectrumValue rxPsd = *(tx.psd);
+  rxPsd *= pathGainLinear;
+  return Integral (rxPsd);
+}
+
+double
+RadioEnvironmentMapHelper::ComputeSinr (Ptr<BuildingsMobilityModel> rx, uint32_t point, RemServer *servers)
+{
+  // same accumulation as RemSpectrumPhy::StartRx
+  double referenceSignalPower = 0;
+  double sumPower = 0;
+  for (uint32_t k = 0; k < m_nServers; ++k)
+    {
+      servers[k].cellId = 0;
+      servers[k].rsrpDbm = std::numeric_limits<float>::quiet_NaN ();
+    }
+  uint32_t nTransmitters = m_transmitters.size ();
+  for (uint32_t t = 0; t < nTransmitters; ++t)
+    {
+      const RemTransmitter *it = &m_transmitters[t];
+      double power;
+      if (m_contributions == 0)
+        {
+          power = ComputeRxPower (rx, *it);
+        }
+      else
+        {
+          float *contribution = m_contributions + (uint64_t) point * nTransmitters + t;
+          if (it->dirty)
+            {
+              *contribution = ComputeRxPower (rx, *it);
+            }
+          // the cached value, so that the result does not depend on
+          // whether the contribution has been recomputed
+          power = *contribution;
+        }
+      if (referenceSignalPower < power)
+        {
+          sumPower += referenceSignalPower;
+          referenceSignalPower = power;
+        }
+      else
+        {
+          sumPower += power;
+        }
+
+      // keep the strongest cells sorted by decreasing RSRP, i.e., by
+      // decreasing power per RB; unknown (NaN) entries compare false
+      float rsrpDbm = 10 * std::log10 (power / m_bandwidth) + 30;
+      uint32_t k = m_nServers;
+      while ((k > 0) && !(servers[k - 1].rsrpDbm >= rsrpDbm))
+        {
+          if (k < m_nServers)
+            {
+              servers[k] = servers[k - 1];
+            }
+          --k;
+        }
+      if (k < m_nServers)
+        {
+          servers[k].cellId = it->cellId;
+          servers[k].rsrpDbm = rsrpDbm;
+        }
+    }
+  return referenceSignalPower / (sumPower + m_noisePower);
+}
+
+bool
+RadioEnvironmentMapHelper::IsPathlossRandom () const
+{
+  std::string name = m_pathlossModel->GetInstanceTypeId ().GetName ();
+  if ((name == "ns3::RandomPropagationLossModel")
+      || (name == "ns3::NakagamiPropagationLossModel")
+      || (name == "ns3::JakesPropagationLossModel"))
+    {
+      return true;
+    }
+  // the shadowing of the BuildingsPropagationLossModel subclasses
+  const char *sigmaNames[] = { "ShadowSigmaOutdoor", "ShadowSigmaIndoor", "ShadowSigmaExtWalls" };
+  for (uint32_t i = 0; i < sizeof (sigmaNames) / sizeof (sigmaNames[0]); ++i)
+    {
+      DoubleValue sigma;
+      if (m_pathlossModel->GetAttributeFailSafe (sigmaNames[i], sigma) && (sigma.Get () > 0))
+        {
+          return true;
+        }
+    }
+  return false;
+}
+
+void
+RadioEnvironmentMapHelper::ComputeTiles (const std::vector<Vector> &points, double *sinr, RemServer *servers, volatile uint32_t *nextTile)
+{
+  uint32_t nTiles = (points.size () + m_tileSize - 1) / m_tileSize;
+  while (true)
+    {
+      uint32_t tile = __sync_fetch_and_add (nextTile, 1);
+      if (tile >= nTiles)
+        {
+          break;
+        }
+      uint32_t end = std::min ((uint32_t) points.size (), (tile + 1) * m_tileSize);
+      for (uint32_t i = tile * m_tileSize; i < end; ++i)
+        {
+          Ptr<BuildingsMobilityModel> rx;
+          if ((m_contributions == 0) || (m_nDirty > 0))
+            {
+              // with the analytic update and no velocity, the model
+              // schedules no event whatever the default update mode
+              rx = CreateObjectWithAttributes<BuildingsMobilityModel> ("AnalyticUpdate", BooleanValue (true));
+              rx->SetPosition (points[i]);
+              BuildingGridIndex::MakeConsistent (rx);
+            }
+          sinr[i] = ComputeSinr (rx, i, servers + i * m_nServers);
+          if (rx != 0)
+            {
+              // the pathloss model may keep it in its shadowing map
+              rx->Dispose ();
+            }
+        }
+    }
+}
+
+void 
+RadioEnvironmentMapHelper::RunOffline ()
+{
+  NS_LOG_FUNCTION (this);
+  NS_ABORT_MSG_IF (m_pathlossModel == 0, "the offline REM needs the PathlossModel attribute to be set");
+  // the workers would draw from copies of the same random stream, in
+  // an order which depends on the scheduling of the processes
+  NS_ABORT_MSG_IF (m_nWorkers > 1 && IsPathlossRandom (),
+                   "the offline REM needs a deterministic pathloss model (e.g., no shadowing) with NumWorkers > 1");
+  SnapshotTransmitters ();
+  m_xStep = (m_xMax - m_xMin)/(m_xRes-1);
+  m_yStep = (m_yMax - m_yMin)/(m_yRes-1);
+
+  // make sure that all the buildings are indexed before the workers start
+  BuildingGridIndex::GetBuilding (Vector (m_xMin, m_yMin, m_z));
+
+  if (m_adaptive)
+    {
+      NS_ABORT_MSG_IF (!m_cacheFile.empty (), "CacheFile is not supported by the adaptive REM");
+      RunAdaptive ();
+    }
+  else
+    {
+      // same points, in the same order, as the event-driven REM
+      std::vector<Vector> points;
+      for (double x = m_xMin; x < m_xMax + 0.5*m_xStep; x += m_xStep)
+        {
+          for (double y = m_yMin; y < m_yMax + 0.5*m_yStep ; y += m_yStep)
+            {
+              points.push_back (Vector (x, y, m_z));
+            }
+        }
+      std::vector<double> sinr (points.size ());
+      std::vector<RemServer> servers (points.size () * m_nServers);
+      size_t contributionsSize = sizeof (float) * points.size () * m_transmitters.size ();
+      // the cached contributions of a random model would be mixed with
+      // new draws for the transmitters which changed
+      NS_ABORT_MSG_IF (!m_cacheFile.empty () && IsPathlossRandom (),
+                       "CacheFile needs a deterministic pathloss model (e.g., no shadowing)");
+      if (!m_cacheFile.empty () && (contributionsSize > 0))
+        {
+          // shared with the workers, which fill the dirty contributions
+          void *contributions = mmap (0, contributionsSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+          NS_ABORT_MSG_IF (contributions == MAP_FAILED, "mmap failed");
+          m_contributions = (float *) contributions;
+          LoadCache (points.size ());
+        }
+      EvaluatePoints (points, &sinr[0], &servers[0]);
+      if (m_contributions != 0)
+        {
+          SaveCache (points.size ());
+          munmap (m_contributions, contributionsSize);
+          m_contributions = 0;
+        }
+      for (uint32_t i = 0; i < points.size (); ++i)
+        {
+          WritePoint (points[i], sinr[i], &servers[i * m_nServers]);
+        }
+    }
+
+  if (!m_boundaryFile.empty ())
+    {
+      WriteHandoverBoundary ();
+    }
+  Finalize ();
+}
+
+void 
+RadioEnvironmentMapHelper::EvaluatePoints (const std::vector<Vector> &points, double *sinrOut, RemServer *serversOut)
+{
+  NS_LOG_FUNCTION (this << points.size ());
+  m_nEvaluated += points.size ();
+  if (points.empty ())
+    {
+      return;
+    }
+
+  // the results are written by the workers to memory shared with this process
+  size_t sharedSize = sizeof (double) * (points.size () + 1) + sizeof (RemServer) * points.size () * m_nServers;
+  void *shared = mmap (0, sharedSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  NS_ABORT_MSG_IF (shared == MAP_FAILED, "mmap failed");
+  volatile uint32_t *nextTile = (volatile uint32_t *) shared;
+  *nextTile = 0;
+  double *sinr = (double *) ((char *) shared + sizeof (double));
+  RemServer *servers = (RemServer *) (sinr + points.size ());
+
+  if (m_nWorkers == 1)
+    {
+      ComputeTiles (points, sinr, servers, nextTile);
+    }
+  else
+    {
+      // worker processes rather than threads, since ns-3 objects
+      // (e.g., reference counts, pathloss caches) are not thread safe
+      std::cout.flush ();
+      std::vector<pid_t> workers;
+      for (uint32_t w = 0; w < m_nWorkers; ++w)
+        {
+          pid_t pid = fork ();
+          NS_ABORT_MSG_IF (pid < 0, "fork failed");
+          if (pid == 0)
+            {
+              ComputeTiles (points, sinr, servers, nextTile);
+              _exit (0);
+            }
+          workers.push_back (pid);
+        }
+      for (std::vector<pid_t>::iterator it = workers.begin (); it != workers.end (); ++it)
+        {
+          int status;
+          waitpid (*it, &status, 0);
+          NS_ABORT_MSG_IF (!WIFEXITED (status) || WEXITSTATUS (status) != 0, "REM worker " << *it << " failed");
+        }
+    }
+
+  std::copy (sinr, sinr + points.size (), sinrOut);
+  std::copy (servers, servers + points.size () * m_nServers, serversOut);
+  munmap (shared, sharedSize);
+}
+
+void 
+RadioEnvironmentMapHelper::RunAdaptive ()
+{
+  NS_LOG_FUNCTION (this);
+  uint32_t nPoints = m_xRes * m_yRes;
+  std::vector<double> sinr (nPoints);
+  std::vector<RemServer> servers (nPoints * m_nServers);
+  // 0: not evaluated, 1: evaluated or scheduled for evaluation, 2: interpolated
+  std::vector<uint8_t> state (nPoints, 0);
+
+  // the cells of the coarse grid; the last row and column may be smaller
+  std::vector<AdaptiveCell> cells;
+  std::vector<uint32_t> xs;
+  std::vector<uint32_t> ys;
+  for (uint32_t ix = 0; ix < m_xRes - 1; ix += m_adaptiveStep)
+    {
+      xs.push_back (ix);
+    }
+  xs.push_back (m_xRes - 1);
+  for (uint32_t iy = 0; iy < m_yRes - 1; iy += m_adaptiveStep)
+    {
+      ys.push_back (iy);
+    }
+  ys.push_back (m_yRes - 1);
+  std::vector<Vector> points;
+  std::vector<uint32_t> indices;
+  for (uint32_t i = 0; i < xs.size (); ++i)
+    {
+      for (uint32_t j = 0; j < ys.size (); ++j)
+        {
+          AddAdaptivePoint (xs[i], ys[j], state, points, indices);
+          if ((i + 1 < xs.size ()) && (j + 1 < ys.size ()))
+            {
+              AdaptiveCell c = { xs[i], xs[i + 1], ys[j], ys[j + 1] };
+              cells.push_back (c);
+            }
+        }
+    }
+
+  // each pass evaluates the new corners of the cells split by the
+  // previous pass; the cells which are not split are interpolated
+  // later, the smallest first so that the finest corners prevail
+  std::vector<std::vector<AdaptiveCell> > unsplit;
+  while (!points.empty ())
+    {
+      std::vector<double> newSinr (points.size ());
+      std::vector<RemServer> newServers (points.size () * m_nServers);
+      EvaluatePoints (points, &newSinr[0], &newServers[0]);
+      for (uint32_t n = 0; n < points.size (); ++n)
+        {
+          sinr[indices[n]] = newSinr[n];
+          std::copy (&newServers[n * m_nServers], &newServers[(n + 1) * m_nServers], &servers[indices[n] * m_nServers]);
+        }
+      points.clear ();
+      indices.clear ();
+
+      std::vector<AdaptiveCell> children;
+      unsplit.push_back (std::vector<AdaptiveCell> ());
+      for (std::vector<AdaptiveCell>::const_iterator it = cells.begin (); it != cells.end (); ++it)
+        {
+          if ((it->ix1 - it->ix0 <= 1) && (it->iy1 - it->iy0 <= 1))
+            {
+              // minimum cell size reached, all the points are evaluated
+              continue;
+            }
+          uint32_t corners[4] = { it->ix0 * m_yRes + it->iy0, it->ix0 * m_yRes + it->iy1,
+                                  it->ix1 * m_yRes + it->iy0, it->ix1 * m_yRes + it->iy1 };
+          bool split = false;
+          double minDb = std::numeric_limits<double>::infinity ();
+          double maxDb = -std::numeric_limits<double>::infinity ();
+          for (uint32_t k = 0; k < 4; ++k)
+            {
+              double db = 10 * std::log10 (sinr[corners[k]]);
+              minDb = std::min (minDb, db);
+              maxDb = std::max (maxDb, db);
+              split = split || (servers[corners[k] * m_nServers].cellId != servers[corners[0] * m_nServers].cellId);
+            }
+          split = split || (maxDb - minDb > m_adaptiveThresholdDb);
+          if (!split)
+            {
+              unsplit.back ().push_back (*it);
+              continue;
+            }
+          uint32_t mx = (it->ix0 + it->ix1) / 2;
+          uint32_t my = (it->iy0 + it->iy1) / 2;
+          uint32_t cx[3] = { it->ix0, mx, it->ix1 };
+          uint32_t cy[3] = { it->iy0, my, it->iy1 };
+          for (uint32_t a = 0; a < 2; ++a)
+            {
+              for (uint32_t b = 0; b < 2; ++b)
+                {
+                  if ((cx[a] == cx[a + 1]) || (cy[b] == cy[b + 1]))
+                    {
+                      // a cell which is one step wide is split along one axis only
+                      continue;
+                    }
+                  AdaptiveCell c = { cx[a], cx[a + 1], cy[b], cy[b + 1] };
+                  children.push_back (c);
+                }
+            }
+          for (uint32_t a = 0; a < 3; ++a)
+            {
+              for (uint32_t b = 0; b < 3; ++b)
+                {
+                  AddAdaptivePoint (cx[a], cy[b], state, points, indices);
+                }
+            }
+        }
+      cells.swap (children);
+    }
+
+  for (std::vector<std::vector<AdaptiveCell> >::reverse_iterator level = unsplit.rbegin ();
+       level != unsplit.rend ();
+       ++level)
+    {
+      for (std::vector<AdaptiveCell>::const_iterator it = level->begin (); it != level->end (); ++it)
+        {
+          double sx = it->ix1 - it->ix0;
+          double sy = it->iy1 - it->iy0;
+          for (uint32_t ix = it->ix0; ix <= it->ix1; ++ix)
+            {
+              for (uint32_t iy = it->iy0; iy <= it->iy1; ++iy)
+                {
+                  uint32_t i = ix * m_yRes + iy;
+                  if (state[i] != 0)
+                    {
+                      continue;
+                    }
+                  // bilinear interpolation, as done by RemRaster::GetSinr
+                  double dx = (ix - it->ix0) / sx;
+                  double dy = (iy - it->iy0) / sy;
+                  sinr[i] = (1 - dx) * (1 - dy) * sinr[it->ix0 * m_yRes + it->iy0]
+                            + (1 - dx) * dy * sinr[it->ix0 * m_yRes + it->iy1]
+                            + dx * (1 - dy) * sinr[it->ix1 * m_yRes + it->iy0]
+                            + dx * dy * sinr[it->ix1 * m_yRes + it->iy1];
+                  // the best servers are those of the closest corner
+                  uint32_t nearest = (dx < 0.5 ? it->ix0 : it->ix1) * m_yRes + (dy < 0.5 ? it->iy0 : it->iy1);
+                  std::copy (&servers[nearest * m_nServers], &servers[(nearest + 1) * m_nServers], &servers[i * m_nServers]);
+                  state[i] = 2;
+                }
+            }
+        }
+    }
+
+  NS_LOG_INFO ("adaptive REM: " << m_nEvaluated << " points evaluated out of " << nPoints);
+  for (uint32_t ix = 0; ix < m_xRes; ++ix)
+    {
+      for (uint32_t iy = 0; iy < m_yRes; ++iy)
+        {
+          uint32_t i = ix * m_yRes + iy;
+          NS_ASSERT (state[i] != 0);
+          WritePoint (m_raster->GetPosition (ix, iy), sinr[i], &servers[i * m_nServers]);
+        }
+    }
+}
+
+void
+RadioEnvironmentMapHelper::AddAdaptivePoint (uint32_t ix, uint32_t iy, std::vector<uint8_t> &state,
+                                             std::vector<Vector> &points, std::vector<uint32_t> &indices)
+{
+  uint32_t i = ix * m_yRes + iy;
+  if (state[i] == 0)
+    {
+      state[i] = 1;
+      points.push_back (Vector (m_xMin + ix * m_xStep, m_yMin + iy * m_yStep, m_z));
+      indices.push_back (i);
+    }
+}
+
+uint32_t
+RadioEnvironmentMapHelper::GetNEvaluatedPoints () const
+{
+  return m_nEvaluated;
+}
+
+/**
+ * Header of the cache file of the offline REM. It is followed by the
+ * description of the cached transmitters, and then by the power [W]
+ * received from each of them at each point, one transmitter at a time.
+ */
+struct RemCacheHeader
+{
+  char magic[4];        ///< "REMC"
+  uint32_t version;
+  double xMin;
+  double xMax;
+  double yMin;
+  double yMax;
+  double z;
+  uint32_t xRes;
+  uint32_t yRes;
+  uint32_t earfcn;
+  uint32_t bandwidth;
+  uint32_t nBuildings;
+  uint32_t nTransmitters;
+  uint64_t pathlossHash;   ///< type and attributes of the pathloss model
+  uint64_t buildingsHash;  ///< geometry of the buildings
+};
+
+struct RemCacheTransmitter
+{
+  double x;
+  double y;
+  double z;
+  double txPowerDbm;
+  uint32_t cellId;
+  uint32_t earfcn;
+  uint32_t bandwidth;
+  uint32_t reserved;
+  uint64_t antennaHash;    ///< type and attributes of the antenna, 0 if none
+};
+
+static const uint32_t REM_CACHE_VERSION = 3;
+
+static RemCacheHeader
+MakeRemCacheHeader (double xMin, double xMax, uint32_t xRes,
+                    double yMin, double yMax, uint32_t yRes,
+                    double z, uint32_t earfcn, uint32_t bandwidth,
+                    Ptr<const PropagationLossModel> pathlossModel)
+{
+  RemCacheHeader header;
+  std::memset (&header, 0, sizeof (header));
+  std::memcpy (header.magic, "REMC", 4);
+  header.version = REM_CACHE_VERSION;
+  header.xMin = xMin;
+  header.xMax = xMax;
+  header.yMin = yMin;
+  header.yMax = yMax;
+  header.z = z;
+  header.xRes = xRes;
+  header.yRes = yRes;
+  header.earfcn = earfcn;
+  header.bandwidth = bandwidth;
+  header.nBuildings = BuildingList::GetNBuildings ();
+  header.pathlossHash = HashObjectAttributes (pathlossModel);
+  header.buildingsHash = HashBuildings ();
+  return header;
+}
+
+void 
+RadioEnvironmentMapHelper::LoadCache (uint32_t nPoints)
+{
+  NS_LOG_FUNCTION (this << m_cacheFile);
+  uint32_t nTransmitters = m_transmitters.size ();
+  std::ifstream inFile (m_cacheFile.c_str (), std::ios::binary);
+  if (!inFile.is_open ())
+    {
+      NS_LOG_INFO ("no REM cache in " << m_cacheFile << ", computing all the contributions");
+      return;
+    }
+  RemCacheHeader expected = MakeRemCacheHeader (m_xMin, m_xMax, m_xRes, m_yMin, m_yMax, m_yRes, m_z, m_earfcn, m_bandwidth, m_pathlossModel);
+  RemCacheHeader header;
+  inFile.read ((char *) &header, sizeof (header));
+  expected.nTransmitters = header.nTransmitters;
+  if (!inFile || (std::memcmp (&header, &expected, sizeof (header)) != 0))
+    {
+      NS_LOG_WARN ("ignoring the REM cache in " << m_cacheFile << ", which was generated for a different map");
+      return;
+    }
+  std::vector<RemCacheTransmitter> cached (header.nTransmitters);
+  if (header.nTransmitters > 0)
+    {
+      inFile.read ((char *) &cached[0], sizeof (RemCacheTransmitter) * header.nTransmitters);
+    }
+  std::vector<float> column (nPoints);
+  for (uint32_t c = 0; (c < header.nTransmitters) && inFile; ++c)
+    {
+      inFile.read ((char *) &column[0], sizeof (float) * nPoints);
+      if (!inFile)
+        {
+          NS_LOG_WARN ("truncated REM cache in " << m_cacheFile);
+          break;
+        }
+      for (uint32_t t = 0; t < nTransmitters; ++t)
+        {
+          RemTransmitter &tx = m_transmitters[t];
+          if (tx.dirty
+              && (tx.cellId == cached[c].cellId)
+              && (tx.position.x == cached[c].x)
+              && (tx.position.y == cached[c].y)
+              && (tx.position.z == cached[c].z)
+              && (tx.earfcn == cached[c].earfcn)
+              && (tx.bandwidth == cached[c].bandwidth)
+              && (tx.antennaHash == cached[c].antennaHash))
+            {
+              // the received power is proportional to the TX power
+              float scale = std::pow (10.0, (tx.txPowerDbm - cached[c].txPowerDbm) / 10.0);
+              for (uint32_t i = 0; i < nPoints; ++i)
+                {
+                  m_contributions[(uint64_t) i * nTransmitters + t] = column[i] * scale;
+                }
+              tx.dirty = false;
+              --m_nDirty;
+              break;
+            }
+        }
+    }
+  NS_LOG_INFO ("REM cache: " << (nTransmitters - m_nDirty) << " transmitters reused, "
+               << m_nDirty << " to be recomputed");
+}
+
+void 
+RadioEnvironmentMapHelper::SaveCache (uint32_t nPoints)
+{
+  NS_LOG_FUNCTION (this << m_cacheFile);
+  uint32_t nTransmitters = m_transmitters.size ();
+  std::ofstream outFile (m_cacheFile.c_str (), std::ios::binary);
+  if (!outFile.is_open ())
+    {
+      NS_LOG_WARN ("Can't open file " << m_cacheFile);
+      return;
+    }
+  RemCacheHeader header = MakeRemCacheHeader (m_xMin, m_xMax, m_xRes, m_yMin, m_yMax, m_yRes, m_z, m_earfcn, m_bandwidth, m_pathlossModel);
+  header.nTransmitters = nTransmitters;
+  outFile.write ((const char *) &header, sizeof (header));
+  for (uint32_t t = 0; t < nTransmitters; ++t)
+    {
+      RemCacheTransmitter cached;
+      std::memset (&cached, 0, sizeof (cached));
+      cached.x = m_transmitters[t].position.x;
+      cached.y = m_transmitters[t].position.y;
+      cached.z = m_transmitters[t].position.z;
+      cached.txPowerDbm = m_transmitters[t].txPowerDbm;
+      cached.cellId = m_transmitters[t].cellId;
+      cached.earfcn = m_transmitters[t].earfcn;
+      cached.bandwidth = m_transmitters[t].bandwidth;
+      cached.antennaHash = m_transmitters[t].antennaHash;
+      outFile.write ((const char *) &cached, sizeof (cached));
+    }
+  std::vector<float> column (nPoints);
+  for (uint32_t t = 0; t < nTransmitters; ++t)
+    {
+      for (uint32_t i = 0; i < nPoints; ++i)
+        {
+          column[i] = m_contributions[(uint64_t) i * nTransmitters + t];
+        }
+      outFile.write ((const char *) &column[0], sizeof (float) * nPoints);
+    }
+}
+
+void 
+RadioEnvironmentMapHelper::WriteHandoverBoundary ()
+{
+  NS_LOG_FUNCTION (this);
+  NS_ABORT_MSG_IF (m_nServers < 2, "the handover boundary needs NumServers >= 2");
+  std::ofstream outFile (m_boundaryFile.c_str ());
+  if (!outFile.is_open ())
+    {
+      NS_FATAL_ERROR ("Can't open file " << m_boundaryFile);
+      return;
+    }
+  std::vector<RemBoundaryPoint> boundary = m_raster->GetHandoverBoundary (m_hysteresisDb);
+  for (std::vector<RemBoundaryPoint>::const_iterator it = boundary.begin ();
+       it != boundary.end ();
+       ++it)
+    {
+      Vector pos = m_raster->GetPosition (it->ix, it->iy);
+      outFile << pos.x << "\t"
+              << pos.y << "\t"
+              << it->bestCellId << "\t"
+              << it->secondCellId << "\t"
+              << it->marginDb
+              << "\n";
+    }
+  NS_LOG_LOGIC (boundary.size () << " points on the handover boundary");
 }
 
 void 
 RadioEnvironmentMapHelper::Finalize ()
 {
   NS_LOG_FUNCTION (this);
-  m_outFile.close ();
+  if (m_outputFormat == BINARY_OUTPUT)
+    {
+      m_binaryFile.Close ();
+    }
+  else
+    {
+      m_outFile.close ();
+    }
   if (m_stopWhenDone)
     {
       //Simulator::Stop ();   //modified
@@ -24,24 +24,77 @@
 
 
 #include <ns3/object.h>
+#include <ns3/vector.h>
 #include <fstream>
 #include <vector>
 #include <ns3/buildings-module.h>  // modified
+#include "rem-file.h"
+#include "rem-raster.h"
 namespace ns3 {
 
 class RemSpectrumPhy;
 class Node;
 class NetDevice;
 class SpectrumChannel;
+class SpectrumValue;
+class MobilityModel;
+class AntennaModel;
+class PropagationLossModel;
 
 /** 
  * Generates a 2D map of the SINR from the strongest transmitter in the downlink of an LTE FDD system.
  * 
+ * The map is a single horizontal plane at height Z; a map of several
+ * floors needs one helper per height.
+ *
+ * By default the map is computed by attaching RemSpectrumPhy
+ * receivers to the channel and letting the simulation run. In offline
+ * mode, the eNB transmitters (position, antenna, TX PSD) are instead
+ * snapshotted when Install () is called, and the SINR of every point
+ * is computed directly with the given pathloss model, without any
+ * simulator event. The points are split in tiles which are processed
+ * by NumWorkers worker processes.
+ *
+ * The offline map is the same as the event-driven one only with a
+ * deterministic pathloss model. With shadowing, the value drawn for a
+ * point depends on the order in which the points are evaluated, so a
+ * random pathloss model is only accepted with a single worker.
+ *
+ * The map is saved either in the binary format described in
+ * RemFileHeader (the default), which can be read back with
+ * RemFileReader, or as text with one "x y z sinr" line per point.
+ * It is also kept in memory as a RemRaster, which can be queried
+ * while the map is being generated.
+ *
+ * In offline mode, the NumServers strongest cells by RSRP are also
+ * recorded for each point, and the handover boundary (the points
+ * where the two strongest cells are within HandoverHysteresis of each
+ * other) can be saved to BoundaryFile. The event-driven REM only
+ * measures the total received power, so its raster holds the SINR only
+ * and BoundaryFile is rejected. With Adaptive set, the offline
+ * REM starts from a grid of AdaptiveStep x AdaptiveStep cells and splits
+ * recursively, down to the XRes x YRes resolution, only the cells
+ * across which the best server changes or the SINR varies by more than
+ * AdaptiveThreshold; the points of the other cells are interpolated.
+ *
+ * If CacheFile is set, the offline REM saves the power received from
+ * each transmitter at each point. In the next runs, the contributions
+ * of the transmitters whose position, EARFCN, bandwidth and antenna
+ * did not change are read back (and scaled if their TX power changed)
+ * instead of being recomputed. The cache is discarded if the pathloss
+ * model or its attributes, or any building, changed, and it needs a
+ * deterministic pathloss model.
  */
 class RadioEnvironmentMapHelper : public Object
 {
 public:  
 
+  enum OutputFormat
+  {
+    TEXT_OUTPUT,
+    BINARY_OUTPUT
+  };
+
   RadioEnvironmentMapHelper ();
   virtual ~RadioEnvironmentMapHelper ();
   
@@ -65,22 +118,128 @@ public:
    * 
    */
   void Install ();
-  struct mystruct
-  {
-     double x;
-     double y;
-     double z;
-     double sinr;   
-  };
-  std::list <struct mystruct> pos_sinr;
-  std::list <struct mystruct>::iterator iter;
-  bool pause;
+
+  /** 
+   * \return the map being generated; it is updated in place as the
+   * points are computed
+   */
+  Ptr<const RemRaster> GetRaster () const;
+
+  /** 
+   * \return a copy of the map as computed so far, which is not
+   * affected by the points computed afterwards
+   */
+  Ptr<RemRaster> GetSnapshot () const;
+
+  /** 
+   * \return the number of points for which the SINR has been
+   * computed by the offline REM, excluding the interpolated ones
+   */
+  uint32_t GetNEvaluatedPoints () const;
+
 private:
 
   void DelayedInstall ();
   void RunOneIteration (double xMin, double xMax, double yMin, double yMax);
   void PrintAndReset ();
   void Finalize ();
+  /** 
+   * Save one point of the map, in the order in which the points are generated
+   * 
+   * \param pos the position of the point
+   * \param sinr the SINR at the point
+   * \param servers the NumServers strongest cells at the point, 0 if unknown
+   */
+  void WritePoint (const Vector &pos, double sinr, const RemServer *servers);
+  void WriteHandoverBoundary ();
+
+  /**
+   * Downlink transmitter as seen by the offline REM
+   */
+  struct RemTransmitter
+  {
+    Ptr<MobilityModel> mobility;
+    Ptr<AntennaModel> antenna;
+    Ptr<SpectrumValue> psd;
+    uint16_t cellId;
+    Vector position;
+    double txPowerDbm;
+    uint16_t earfcn;
+    uint16_t bandwidth;
+    uint64_t antennaHash; ///< type and attributes of the antenna, 0 if none
+    bool dirty;           ///< false if its contributions are read from the cache
+    uint32_t nodeId;
+    uint32_t deviceIndex; ///< index of the eNB device in its node
+  };
+
+  /**
+   * A cell of the adaptive REM, delimited by the indices of its corners
+   * in the XRes x YRes grid
+   */
+  struct AdaptiveCell
+  {
+    uint32_t ix0;
+    uint32_t ix1;
+    uint32_t iy0;
+    uint32_t iy1;
+  };
+
+  void SnapshotTransmitters ();
+  /** 
+   * \return true if a RemSpectrumPhy receives the signal of a in a
+   * subframe before the one of b, which is the order in which the
+   * offline REM sums the received powers
+   */
+  static bool IsDeliveredBefore (const RemTransmitter &a, const RemTransmitter &b);
+  void RunOffline ();
+  void RunAdaptive ();
+  void AddAdaptivePoint (uint32_t ix, uint32_t iy, std::vector<uint8_t> &state,
+                         std::vector<Vector> &points, std::vector<uint32_t> &indices);
+  /** 
+   * Compute the SINR and the strongest cells of a set of points, with
+   * NumWorkers workers
+   * 
+   * \param points the points
+   * \param sinr where the SINR of each point is stored
+   * \param servers where the NumServers strongest cells of each point are stored
+   */
+  void EvaluatePoints (const std::vector<Vector> &points, double *sinr, RemServer *servers);
+  /** 
+   * Compute the tiles of points not yet taken by another worker
+   * 
+   * \param points the REM points
+   * \param sinr where the SINR of each point is stored
+   * \param servers where the NumServers strongest cells of each point are stored
+   * \param nextTile the index of the next tile to be computed, shared among the workers
+   */
+  void ComputeTiles (const std::vector<Vector> &points, double *sinr, RemServer *servers, volatile uint32_t *nextTile);
+  /** 
+   * \param rx the mobility model of the REM point, may be 0 if no
+   * contribution needs to be recomputed
+   * \param point the index of the point
+   * \param servers where the NumServers strongest cells, by decreasing RSRP, are stored
+   * \return the SINR at the point, computed like RemSpectrumPhy::GetSinr
+   */
+  double ComputeSinr (Ptr<BuildingsMobilityModel> rx, uint32_t point, RemServer *servers);
+  /** 
+   * \param rx the mobility model of the REM point
+   * \param tx the transmitter
+   * \return the power [W] received from the transmitter over the REM bandwidth
+   */
+  double ComputeRxPower (Ptr<BuildingsMobilityModel> rx, const RemTransmitter &tx);
+  /** 
+   * \return true if the pathloss model draws random values, e.g., the
+   * shadowing of the buildings pathloss models
+   */
+  bool IsPathlossRandom () const;
+  /** 
+   * Fill the contributions of the transmitters which are in the cache
+   * and did not change, and mark the others as dirty
+   * 
+   * \param nPoints the number of points of the REM
+   */
+  void LoadCache (uint32_t nPoints);
+  void SaveCache (uint32_t nPoints);
 
 
   struct RemPoint 
@@ -117,7 +276,34 @@ private:
 
   double m_noisePower;
 
+  OutputFormat m_outputFormat;
   std::ofstream m_outFile;
+  RemFileWriter m_binaryFile;
+  Ptr<RemRaster> m_raster;
+  uint32_t m_nWritten;
+
+  uint32_t m_nServers;
+  double m_hysteresisDb;
+  std::string m_boundaryFile;
+
+  bool m_adaptive;
+  uint32_t m_adaptiveStep;
+  double m_adaptiveThresholdDb;
+  uint32_t m_nEvaluated;
+
+  bool m_offline;
+  uint32_t m_nWorkers;
+  uint32_t m_tileSize;
+  Ptr<PropagationLossModel> m_pathlossModel;
+  std::vector<RemTransmitter> m_transmitters;
+
+  std::string m_cacheFile;
+  /**
+   * power received from transmitter t at point i, at i * (number of
+   * transmitters) + t; 0 if CacheFile is not set
+   */
+  float *m_contributions;
+  uint32_t m_nDirty;
 
 };
 
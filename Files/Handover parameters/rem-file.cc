@@ -0,0 +1,239 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "rem-file.h"
+
+#include <ns3/log.h>
+#include <ns3/assert.h>
+#include <ns3/fatal-error.h>
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+NS_LOG_COMPONENT_DEFINE ("RemFile");
+
+namespace ns3 {
+
+static const uint32_t REM_FILE_VERSION = 2;
+// reads 0x04030201 on a host of the other byte order
+static const uint32_t REM_FILE_BYTE_ORDER = 0x01020304;
+static const uint32_t REM_FILE_BUFFER_SIZE = 16384;
+
+
+RemFileWriter::RemFileWriter ()
+  : m_file (0),
+    m_nWritten (0),
+    m_nPoints (0)
+{
+}
+
+RemFileWriter::~RemFileWriter ()
+{
+  Close ();
+}
+
+bool
+RemFileWriter::Open (std::string filename, RemFileHeader header)
+{
+  NS_LOG_FUNCTION (this << filename);
+  NS_ASSERT (m_file == 0);
+  m_file = std::fopen (filename.c_str (), "wb");
+  if (m_file == 0)
+    {
+      return false;
+    }
+  m_filename = filename;
+  std::memcpy (header.magic, "REM1", 4);
+  header.version = REM_FILE_VERSION;
+  header.byteOrder = REM_FILE_BYTE_ORDER;
+  header.reserved = 0;
+  if (std::fwrite (&header, sizeof (header), 1, m_file) != 1)
+    {
+      NS_FATAL_ERROR ("cannot write the header of the REM file " << m_filename);
+    }
+  m_buffer.reserve (REM_FILE_BUFFER_SIZE);
+  m_nWritten = 0;
+  m_nPoints = (uint64_t) header.xRes * header.yRes;
+  return true;
+}
+
+void
+RemFileWriter::Write (float sinr)
+{
+  NS_ASSERT (m_file != 0);
+  if (m_nWritten == m_nPoints)
+    {
+      NS_LOG_WARN ("ignoring value beyond the end of the raster");
+      return;
+    }
+  m_buffer.push_back (sinr);
+  ++m_nWritten;
+  if (m_buffer.size () == REM_FILE_BUFFER_SIZE)
+    {
+      Flush ();
+    }
+}
+
+void
+RemFileWriter::Flush ()
+{
+  if (!m_buffer.empty ())
+    {
+      if (std::fwrite (&m_buffer[0], sizeof (float), m_buffer.size (), m_file) != m_buffer.size ())
+        {
+          NS_FATAL_ERROR ("cannot write the REM file " << m_filename);
+        }
+      m_buffer.clear ();
+    }
+}
+
+void
+RemFileWriter::Close ()
+{
+  NS_LOG_FUNCTION (this);
+  if (m_file == 0)
+    {
+      return;
+    }
+  if (m_nWritten < m_nPoints)
+    {
+      NS_LOG_WARN ((m_nPoints - m_nWritten) << " points of the raster have not been computed");
+      while (m_nWritten < m_nPoints)
+        {
+          Write (std::numeric_limits<float>::quiet_NaN ());
+        }
+    }
+  Flush ();
+  // the data buffered by the C library are only written now
+  int error = std::fclose (m_file);
+  m_file = 0;
+  if (error != 0)
+    {
+      NS_FATAL_ERROR ("cannot write the REM file " << m_filename);
+    }
+}
+
+uint64_t
+RemFileWriter::GetNWritten () const
+{
+  return m_nWritten;
+}
+
+
+RemFileReader::RemFileReader ()
+  : m_map (0),
+    m_mapSize (0),
+    m_header (0),
+    m_raster (0),
+    m_xStep (0),
+    m_yStep (0)
+{
+}
+
+RemFileReader::~RemFileReader ()
+{
+  Close ();
+}
+
+bool
+RemFileReader::Open (std::string filename)
+{
+  NS_LOG_FUNCTION (this << filename);
+  Close ();
+  int fd = open (filename.c_str (), O_RDONLY);
+  if (fd < 0)
+    {
+      return false;
+    }
+  struct stat st;
+  if ((fstat (fd, &st) != 0) || ((size_t) st.st_size < sizeof (RemFileHeader)))
+    {
+      close (fd);
+      return false;
+    }
+  void *map = mmap (0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close (fd);
+  if (map == MAP_FAILED)
+    {
+      return false;
+    }
+  m_map = map;
+  m_mapSize = st.st_size;
+  m_header = (const RemFileHeader *) m_map;
+  if ((std::memcmp (m_header->magic, "REM1", 4) != 0)
+      || (m_header->version != REM_FILE_VERSION)
+      || (m_header->byteOrder != REM_FILE_BYTE_ORDER)
+      || (m_header->xRes < 2) || (m_header->yRes < 2)
+      || (m_mapSize < sizeof (RemFileHeader) + sizeof (float) * (uint64_t) m_header->xRes * m_header->yRes))
+    {
+      NS_LOG_WARN (filename << " is not a valid REM file");
+      Close ();
+      return false;
+    }
+  m_raster = (const float *) ((const char *) m_map + sizeof (RemFileHeader));
+  m_xStep = (m_header->xMax - m_header->xMin) / (m_header->xRes - 1);
+  m_yStep = (m_header->yMax - m_header->yMin) / (m_header->yRes - 1);
+  return true;
+}
+
+void
+RemFileReader::Close ()
+{
+  if (m_map != 0)
+    {
+      munmap (m_map, m_mapSize);
+      m_map = 0;
+      m_mapSize = 0;
+      m_header = 0;
+      m_raster = 0;
+    }
+}
+
+const RemFileHeader &
+RemFileReader::GetHeader () const
+{
+  NS_ASSERT (m_header != 0);
+  return *m_header;
+}
+
+float
+RemFileReader::GetSinr (uint32_t ix, uint32_t iy) const
+{
+  NS_ASSERT (m_raster != 0);
+  NS_ASSERT ((ix < m_header->xRes) && (iy < m_header->yRes));
+  return m_raster[(uint64_t) ix * m_header->yRes + iy];
+}
+
+float
+RemFileReader::GetSinr (double x, double y) const
+{
+  NS_ASSERT (m_raster != 0);
+  double fx = std::floor ((x - m_header->xMin) / m_xStep + 0.5);
+  double fy = std::floor ((y - m_header->yMin) / m_yStep + 0.5);
+  if ((fx < 0) || (fx >= m_header->xRes) || (fy < 0) || (fy >= m_header->yRes))
+    {
+      return std::numeric_limits<float>::quiet_NaN ();
+    }
+  return GetSinr ((uint32_t) fx, (uint32_t) fy);
+}
+
+} // namespace ns3
@@ -0,0 +1,154 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef REM_FILE_H
+#define REM_FILE_H
+
+#include <stdint.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * Header of a binary REM file. It is followed by XRes * YRes float32
+ * SINR values (linear, not dB), stored with x as the outer and y as the
+ * inner index, i.e., the value of grid point (ix, iy) is at position
+ * ix * YRes + iy. Points which have not been computed are stored as NaN.
+ * All the fields and values are in the byte order of the host which
+ * wrote the file, recorded in byteOrder. The reader maps the values as
+ * they are, so it rejects a file written with the other byte order.
+ */
+struct RemFileHeader
+{
+  char magic[4];        ///< "REM1"
+  uint32_t version;
+  uint32_t byteOrder;   ///< REM_FILE_BYTE_ORDER as written by the host
+  uint32_t reserved;
+  double xMin;
+  double xMax;
+  double yMin;
+  double yMax;
+  double z;
+  uint32_t xRes;
+  uint32_t yRes;
+  uint32_t earfcn;
+  uint32_t bandwidth;   ///< in number of RBs
+};
+
+/**
+ * Writes a binary REM file, one point at a time, in the order defined
+ * by RemFileHeader. The values are buffered and written in large
+ * blocks.
+ */
+class RemFileWriter
+{
+public:
+  RemFileWriter ();
+  ~RemFileWriter ();
+
+  /**
+   * Create the file and write its header
+   *
+   * \param filename the name of the file
+   * \param header the header; magic, version and byteOrder are filled
+   * in by the writer
+   * \return false if the file could not be created
+   *
+   * A failure to write the file afterwards, e.g., a full disk, is fatal,
+   * so that no truncated REM file is left behind as a valid one.
+   */
+  bool Open (std::string filename, RemFileHeader header);
+
+  /**
+   * Append the value of the next grid point
+   *
+   * \param sinr the linear SINR
+   */
+  void Write (float sinr);
+
+  /**
+   * Pad the raster with NaN up to XRes * YRes values, and close the file
+   */
+  void Close ();
+
+  /**
+   * \return the number of values written so far
+   */
+  uint64_t GetNWritten () const;
+
+private:
+  void Flush ();
+
+  FILE *m_file;
+  std::string m_filename;
+  std::vector<float> m_buffer;
+  uint64_t m_nWritten;
+  uint64_t m_nPoints;
+};
+
+/**
+ * Read-only access to a binary REM file, which is memory-mapped so
+ * that single values can be looked up without reading the whole file.
+ */
+class RemFileReader
+{
+public:
+  RemFileReader ();
+  ~RemFileReader ();
+
+  /**
+   * \param filename the name of the file
+   * \return false if the file could not be mapped or is not a valid REM
+   * file of this version and of the byte order of this host
+   */
+  bool Open (std::string filename);
+  void Close ();
+
+  const RemFileHeader & GetHeader () const;
+
+  /**
+   * \param ix the index of the grid point along the x axis
+   * \param iy the index of the grid point along the y axis
+   * \return the linear SINR of the grid point
+   */
+  float GetSinr (uint32_t ix, uint32_t iy) const;
+
+  /**
+   * \param x the x coordinate
+   * \param y the y coordinate
+   * \return the linear SINR of the grid point closest to (x, y), or NaN
+   * if (x, y) is outside the map
+   */
+  float GetSinr (double x, double y) const;
+
+private:
+  RemFileReader (const RemFileReader &);
+  RemFileReader & operator= (const RemFileReader &);
+
+  void *m_map;
+  size_t m_mapSize;
+  const RemFileHeader *m_header;
+  const float *m_raster;
+  double m_xStep;
+  double m_yStep;
+};
+
+} // namespace ns3
+
+#endif // REM_FILE_H
@@ -0,0 +1,136 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+// Generates the same REM with the event-driven and with the offline
+// RadioEnvironmentMapHelper, for a few eNBs and a deterministic pathloss
+// model, and compares the two binary maps point by point. The exit
+// status is 1 if any point differs.
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/lte-module.h"
+#include "ns3/buildings-module.h"
+#include <ns3/radio-environment-map-helper.h>
+#include <ns3/rem-file.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace ns3;
+
+int main (int argc, char *argv[])
+{
+  uint32_t nEnbs = 4;
+  uint32_t res = 50;
+  CommandLine cmd;
+  cmd.AddValue ("nEnbs", "Number of eNBs", nEnbs);
+  cmd.AddValue ("res", "Number of REM points along each axis", res);
+  cmd.Parse (argc, argv);
+
+  NodeContainer enbs;
+  enbs.Create (nEnbs);
+  Ptr<ListPositionAllocator> positionAlloc = CreateObject<ListPositionAllocator> ();
+  for (uint32_t i = 0; i < nEnbs; ++i)
+    {
+      enbs.Get (i)->SetRole (Node::MACRO_ENB);
+      // on a circle, so that every eNB is the best server somewhere
+      double angle = 2 * M_PI * i / nEnbs;
+      positionAlloc->Add (Vector (500 + 300 * std::cos (angle), 500 + 300 * std::sin (angle), 30));
+    }
+  MobilityHelper mobility;
+  mobility.SetMobilityModel ("ns3::BuildingsMobilityModel");
+  mobility.SetPositionAllocator (positionAlloc);
+  mobility.Install (enbs);
+
+  // Friis, as the one of the channel
+  Ptr<LteHelper> lteHelper = CreateObject<LteHelper> ();
+  lteHelper->SetAttribute ("PathlossModel", StringValue ("ns3::FriisPropagationLossModel"));
+  lteHelper->SetSpectrumChannelType ("ns3::MultiModelSpectrumChannel");
+  NetDeviceContainer enbDevs = lteHelper->InstallEnbDevice (enbs);
+  BuildingsHelper::MakeMobilityModelConsistent ();
+
+  UintegerValue earfcn;
+  enbDevs.Get (0)->GetAttribute ("DlEarfcn", earfcn);
+  Ptr<FriisPropagationLossModel> pathloss = CreateObject<FriisPropagationLossModel> ();
+  pathloss->SetAttribute ("Frequency", DoubleValue (LteSpectrumValueHelper::GetCarrierFrequency (earfcn.Get ())));
+
+  Ptr<RadioEnvironmentMapHelper> remHelper[2];
+  const char *filename[2] = { "rem-event-driven.rem", "rem-offline.rem" };
+  for (int mode = 0; mode < 2; ++mode)
+    {
+      remHelper[mode] = CreateObject<RadioEnvironmentMapHelper> ();
+      remHelper[mode]->SetAttribute ("ChannelPath", StringValue ("/ChannelList/0"));
+      remHelper[mode]->SetAttribute ("OutputFile", StringValue (filename[mode]));
+      remHelper[mode]->SetAttribute ("Earfcn", UintegerValue (earfcn.Get ()));
+      remHelper[mode]->SetAttribute ("XMin", DoubleValue (0));
+      remHelper[mode]->SetAttribute ("XMax", DoubleValue (1000));
+      remHelper[mode]->SetAttribute ("XRes", UintegerValue (res));
+      remHelper[mode]->SetAttribute ("YMin", DoubleValue (0));
+      remHelper[mode]->SetAttribute ("YMax", DoubleValue (1000));
+      remHelper[mode]->SetAttribute ("YRes", UintegerValue (res));
+      remHelper[mode]->SetAttribute ("Z", DoubleValue (1.5));
+      if (mode == 1)
+        {
+          remHelper[mode]->SetAttribute ("Offline", BooleanValue (true));
+          remHelper[mode]->SetAttribute ("PathlossModel", PointerValue (pathloss));
+        }
+      remHelper[mode]->Install ();
+    }
+
+  // enough for the event-driven REM to go through all the points, one
+  // iteration per ms after it has been installed
+  UintegerValue maxPoints;
+  remHelper[0]->GetAttribute ("MaxPointsPerIteration", maxPoints);
+  Simulator::Stop (Seconds (0.0026 + 0.001 * (res * res / maxPoints.Get () + 10)));
+  Simulator::Run ();
+  Simulator::Destroy ();
+
+  RemFileReader reader[2];
+  for (int mode = 0; mode < 2; ++mode)
+    {
+      if (!reader[mode].Open (filename[mode]))
+        {
+          std::cerr << "Can't read " << filename[mode] << std::endl;
+          return 1;
+        }
+    }
+  uint32_t nMismatches = 0;
+  double maxRelativeError = 0;
+  for (uint32_t ix = 0; ix < res; ++ix)
+    {
+      for (uint32_t iy = 0; iy < res; ++iy)
+        {
+          float eventDriven = reader[0].GetSinr (ix, iy);
+          float offline = reader[1].GetSinr (ix, iy);
+          // bit by bit, so that two NaN are equal
+          if (std::memcmp (&eventDriven, &offline, sizeof (float)) != 0)
+            {
+              if (nMismatches < 10)
+                {
+                  std::cout << "point (" << ix << ", " << iy << "): event-driven " << eventDriven
+                            << ", offline " << offline << std::endl;
+                }
+              ++nMismatches;
+              maxRelativeError = std::max (maxRelativeError, (double) std::fabs (offline - eventDriven) / eventDriven);
+            }
+        }
+    }
+  std::cout << "points\tmismatches\tmax relative error" << std::endl;
+  std::cout << res * res << "\t" << nMismatches << "\t" << maxRelativeError << std::endl;
+  return (nMismatches == 0) ? 0 : 1;
+}
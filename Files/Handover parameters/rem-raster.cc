@@ -0,0 +1,205 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "rem-raster.h"
+
+#include <ns3/abort.h>
+#include <ns3/assert.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace ns3 {
+
+RemRaster::RemRaster (double xMin, double xMax, uint32_t xRes,
+                      double yMin, double yMax, uint32_t yRes,
+                      double z, uint32_t nServers)
+  : m_xMin (xMin),
+    m_yMin (yMin),
+    m_xStep ((xMax - xMin) / (xRes - 1)),
+    m_yStep ((yMax - yMin) / (yRes - 1)),
+    m_xRes (xRes),
+    m_yRes (yRes),
+    m_z (z),
+    m_nServers (nServers),
+    m_nComputed (0),
+    m_sinr (xRes * yRes, std::numeric_limits<float>::quiet_NaN ())
+{
+  NS_ASSERT ((xRes >= 2) && (yRes >= 2));
+  RemServer unknown;
+  unknown.cellId = 0;
+  unknown.rsrpDbm = std::numeric_limits<float>::quiet_NaN ();
+  m_servers.resize (xRes * yRes * nServers, unknown);
+}
+
+uint32_t
+RemRaster::GetXRes () const
+{
+  return m_xRes;
+}
+
+uint32_t
+RemRaster::GetYRes () const
+{
+  return m_yRes;
+}
+
+uint32_t
+RemRaster::GetNServers () const
+{
+  return m_nServers;
+}
+
+uint32_t
+RemRaster::GetIndex (uint32_t ix, uint32_t iy) const
+{
+  NS_ASSERT ((ix < m_xRes) && (iy < m_yRes));
+  return ix * m_yRes + iy;
+}
+
+void
+RemRaster::CheckServers () const
+{
+  NS_ABORT_MSG_IF (m_nServers == 0, "this REM raster holds the SINR only "
+                   "(the best servers are recorded by the offline REM only)");
+}
+
+Vector
+RemRaster::GetPosition (uint32_t ix, uint32_t iy) const
+{
+  return Vector (m_xMin + ix * m_xStep, m_yMin + iy * m_yStep, m_z);
+}
+
+void
+RemRaster::Set (uint32_t ix, uint32_t iy, double sinr, const RemServer *servers)
+{
+  uint32_t i = GetIndex (ix, iy);
+  if (std::isnan (m_sinr[i]))
+    {
+      ++m_nComputed;
+    }
+  m_sinr[i] = sinr;
+  if ((servers != 0) && (m_nServers > 0))
+    {
+      std::copy (servers, servers + m_nServers, m_servers.begin () + i * m_nServers);
+    }
+}
+
+double
+RemRaster::GetSinr (uint32_t ix, uint32_t iy) const
+{
+  return m_sinr[GetIndex (ix, iy)];
+}
+
+uint16_t
+RemRaster::GetCellId (uint32_t ix, uint32_t iy) const
+{
+  CheckServers ();
+  return m_servers[GetIndex (ix, iy) * m_nServers].cellId;
+}
+
+RemServer
+RemRaster::GetServer (uint32_t ix, uint32_t iy, uint32_t k) const
+{
+  CheckServers ();
+  NS_ASSERT (k < m_nServers);
+  return m_servers[GetIndex (ix, iy) * m_nServers + k];
+}
+
+double
+RemRaster::GetMargin (uint32_t ix, uint32_t iy) const
+{
+  CheckServers ();
+  if (m_nServers < 2)
+    {
+      return std::numeric_limits<double>::quiet_NaN ();
+    }
+  const RemServer *s = &m_servers[GetIndex (ix, iy) * m_nServers];
+  return s[0].rsrpDbm - s[1].rsrpDbm;
+}
+
+std::vector<RemBoundaryPoint>
+RemRaster::GetHandoverBoundary (double hysteresisDb) const
+{
+  CheckServers ();
+  NS_ASSERT_MSG (m_nServers >= 2, "the handover boundary needs the two strongest cells of each point");
+  std::vector<RemBoundaryPoint> boundary;
+  for (uint32_t ix = 0; ix < m_xRes; ++ix)
+    {
+      for (uint32_t iy = 0; iy < m_yRes; ++iy)
+        {
+          const RemServer *s = &m_servers[GetIndex (ix, iy) * m_nServers];
+          double margin = s[0].rsrpDbm - s[1].rsrpDbm;
+          // false for NaN, i.e., for unknown or single-cell points
+          if (margin <= hysteresisDb)
+            {
+              RemBoundaryPoint p;
+              p.ix = ix;
+              p.iy = iy;
+              p.bestCellId = s[0].cellId;
+              p.secondCellId = s[1].cellId;
+              p.marginDb = margin;
+              boundary.push_back (p);
+            }
+        }
+    }
+  return boundary;
+}
+
+double
+RemRaster::GetSinr (const Vector &pos) const
+{
+  double fx = (pos.x - m_xMin) / m_xStep;
+  double fy = (pos.y - m_yMin) / m_yStep;
+  if ((fx < 0) || (fx > m_xRes - 1) || (fy < 0) || (fy > m_yRes - 1))
+    {
+      return std::numeric_limits<double>::quiet_NaN ();
+    }
+  // the last row and column are interpolated with the previous ones
+  uint32_t ix = std::min ((uint32_t) fx, m_xRes - 2);
+  uint32_t iy = std::min ((uint32_t) fy, m_yRes - 2);
+  double dx = fx - ix;
+  double dy = fy - iy;
+  const float *s = &m_sinr[GetIndex (ix, iy)];
+  // NaN corners propagate to the result
+  return (1 - dx) * (1 - dy) * s[0]
+         + (1 - dx) * dy * s[1]
+         + dx * (1 - dy) * s[m_yRes]
+         + dx * dy * s[m_yRes + 1];
+}
+
+uint16_t
+RemRaster::GetCellId (const Vector &pos) const
+{
+  CheckServers ();
+  double fx = std::floor ((pos.x - m_xMin) / m_xStep + 0.5);
+  double fy = std::floor ((pos.y - m_yMin) / m_yStep + 0.5);
+  if ((fx < 0) || (fx >= m_xRes) || (fy < 0) || (fy >= m_yRes))
+    {
+      return 0;
+    }
+  return GetCellId ((uint32_t) fx, (uint32_t) fy);
+}
+
+uint32_t
+RemRaster::GetNComputed () const
+{
+  return m_nComputed;
+}
+
+} // namespace ns3
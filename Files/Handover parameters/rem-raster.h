@@ -0,0 +1,164 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef REM_RASTER_H
+#define REM_RASTER_H
+
+#include <ns3/simple-ref-count.h>
+#include <ns3/vector.h>
+#include <stdint.h>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * A cell received at a REM point
+ */
+struct RemServer
+{
+  uint16_t cellId;     ///< 0 if unknown
+  float rsrpDbm;       ///< NaN if unknown
+};
+
+/**
+ * A REM point where the two strongest cells are received within the
+ * handover hysteresis of each other
+ */
+struct RemBoundaryPoint
+{
+  uint32_t ix;
+  uint32_t iy;
+  uint16_t bestCellId;
+  uint16_t secondCellId;
+  double marginDb;     ///< RSRP of the best minus RSRP of the second cell
+};
+
+/**
+ * A Radio Environment Map held in memory: the SINR and the strongest
+ * cells (up to NServers, by decreasing RSRP) of each point of a regular
+ * XRes x YRes grid at height z.
+ *
+ * The points are indexed like in RemFileHeader, i.e., point (ix, iy)
+ * is at (xMin + ix * xStep, yMin + iy * yStep, z) and is stored at
+ * position ix * YRes + iy. Points which have not been computed yet
+ * hold a NaN SINR.
+ *
+ * The raster is a single horizontal plane, like the REM it is built
+ * from: a map of several floors needs one raster (and one
+ * RadioEnvironmentMapHelper) per height.
+ *
+ * A raster built with nServers = 0 holds the SINR only, as does the
+ * event-driven REM, which cannot tell which transmitter is the
+ * strongest; the per-cell queries (GetCellId, GetServer, GetMargin,
+ * GetHandoverBoundary) abort on such a raster.
+ */
+class RemRaster : public SimpleRefCount<RemRaster>
+{
+public:
+  RemRaster (double xMin, double xMax, uint32_t xRes,
+             double yMin, double yMax, uint32_t yRes,
+             double z, uint32_t nServers = 1);
+
+  uint32_t GetXRes () const;
+  uint32_t GetYRes () const;
+  /**
+   * \return the number of cells recorded for each point, 0 if the
+   * raster holds the SINR only
+   */
+  uint32_t GetNServers () const;
+
+  /**
+   * \param ix the index of the point along the x axis
+   * \param iy the index of the point along the y axis
+   * \return the position of the point
+   */
+  Vector GetPosition (uint32_t ix, uint32_t iy) const;
+
+  /**
+   * \param ix the index of the point along the x axis
+   * \param iy the index of the point along the y axis
+   * \param sinr the linear SINR at the point
+   * \param servers the NServers strongest cells by decreasing RSRP, or 0 if unknown
+   * (ignored if the raster holds the SINR only)
+   */
+  void Set (uint32_t ix, uint32_t iy, double sinr, const RemServer *servers);
+
+  double GetSinr (uint32_t ix, uint32_t iy) const;
+  /**
+   * \return the cell ID of the best server at the point, 0 if unknown
+   */
+  uint16_t GetCellId (uint32_t ix, uint32_t iy) const;
+  /**
+   * \param k the rank of the cell, 0 for the best server
+   * \return the k-th strongest cell at the point
+   */
+  RemServer GetServer (uint32_t ix, uint32_t iy, uint32_t k) const;
+  /**
+   * \return the RSRP difference in dB between the best and the second
+   * strongest cell, NaN if unknown
+   */
+  double GetMargin (uint32_t ix, uint32_t iy) const;
+
+  /**
+   * \param hysteresisDb the handover hysteresis
+   * \return the points where the two strongest cells are received
+   * within the hysteresis of each other, i.e., the points where a UE
+   * served by either cell is close to triggering a handover to the
+   * other one. NServers must be at least 2.
+   */
+  std::vector<RemBoundaryPoint> GetHandoverBoundary (double hysteresisDb) const;
+
+  /**
+   * \param pos a position within the map (z is ignored)
+   * \return the linear SINR interpolated bilinearly between the four
+   * surrounding points, or NaN if pos is outside the map or any of
+   * these points has not been computed yet
+   */
+  double GetSinr (const Vector &pos) const;
+
+  /**
+   * \param pos a position within the map (z is ignored)
+   * \return the best server at the closest point, 0 if pos is outside
+   * the map or the best server is unknown
+   */
+  uint16_t GetCellId (const Vector &pos) const;
+
+  /**
+   * \return the number of points which have been computed
+   */
+  uint32_t GetNComputed () const;
+
+private:
+  uint32_t GetIndex (uint32_t ix, uint32_t iy) const;
+  void CheckServers () const;
+
+  double m_xMin;
+  double m_yMin;
+  double m_xStep;
+  double m_yStep;
+  uint32_t m_xRes;
+  uint32_t m_yRes;
+  double m_z;
+  uint32_t m_nServers;
+  uint32_t m_nComputed;
+  std::vector<float> m_sinr;
+  std::vector<RemServer> m_servers;
+};
+
+} // namespace ns3
+
+#endif // REM_RASTER_H
@@ -0,0 +1,276 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <ns3/building-grid-index.h>
+#include <ns3/building.h>
+#include <ns3/building-list.h>
+#include <ns3/buildings-mobility-model.h>
+#include <ns3/object.h>
+#include <ns3/simulator.h>
+#include <ns3/box.h>
+#include <ns3/log.h>
+#include <ns3/assert.h>
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+NS_LOG_COMPONENT_DEFINE ("BuildingGridIndex");
+
+namespace ns3 {
+
+/**
+ * private implementation detail of the BuildingGridIndex API.
+ */
+class BuildingGridIndexPriv : public Object
+{
+public:
+  static TypeId GetTypeId (void);
+  BuildingGridIndexPriv ();
+  ~BuildingGridIndexPriv ();
+
+  Ptr<Building> GetBuilding (const Vector &position);
+  void SetCellSize (double cellSize);
+
+  static Ptr<BuildingGridIndexPriv> Get (void);
+
+private:
+  virtual void DoDispose (void);
+  static Ptr<BuildingGridIndexPriv> *DoGet (void);
+  static void Delete (void);
+
+  /**
+   * insert the buildings added to the BuildingList since the last call
+   */
+  void Sync (void);
+  /**
+   * resize the grid so that it covers the given area, and re-insert
+   * all the indexed buildings
+   */
+  void Rebuild (const Box &area);
+  void Insert (uint32_t index);
+
+  std::vector<Ptr<Building> > m_buildings;
+  std::vector<std::vector<uint32_t> > m_cells;
+  double m_cellSize;
+  double m_xMin;
+  double m_yMin;
+  uint32_t m_nX;
+  uint32_t m_nY;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (BuildingGridIndexPriv);
+
+TypeId
+BuildingGridIndexPriv::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::BuildingGridIndexPriv")
+    .SetParent<Object> ()
+  ;
+  return tid;
+}
+
+Ptr<BuildingGridIndexPriv>
+BuildingGridIndexPriv::Get (void)
+{
+  return *DoGet ();
+}
+
+Ptr<BuildingGridIndexPriv> *
+BuildingGridIndexPriv::DoGet (void)
+{
+  static Ptr<BuildingGridIndexPriv> ptr = 0;
+  if (ptr == 0)
+    {
+      ptr = CreateObject<BuildingGridIndexPriv> ();
+      Simulator::ScheduleDestroy (&BuildingGridIndexPriv::Delete);
+    }
+  return &ptr;
+}
+
+void
+BuildingGridIndexPriv::Delete (void)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+  (*DoGet ())->Dispose ();
+  (*DoGet ()) = 0;
+}
+
+BuildingGridIndexPriv::BuildingGridIndexPriv ()
+  : m_cellSize (50.0),
+    m_xMin (0.0),
+    m_yMin (0.0),
+    m_nX (0),
+    m_nY (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+BuildingGridIndexPriv::~BuildingGridIndexPriv ()
+{
+}
+
+void
+BuildingGridIndexPriv::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_buildings.clear ();
+  m_cells.clear ();
+  m_nX = 0;
+  m_nY = 0;
+  Object::DoDispose ();
+}
+
+void
+BuildingGridIndexPriv::SetCellSize (double cellSize)
+{
+  NS_LOG_FUNCTION (this << cellSize);
+  NS_ASSERT (cellSize > 0);
+  m_cellSize = cellSize;
+  if (m_nX > 0)
+    {
+      Rebuild (Box (m_xMin, m_xMin + m_nX * m_cellSize, m_yMin, m_yMin + m_nY * m_cellSize, 0, 0));
+    }
+}
+
+void
+BuildingGridIndexPriv::Sync (void)
+{
+  uint32_t nBuildings = BuildingList::GetNBuildings ();
+  while (m_buildings.size () < nBuildings)
+    {
+      Ptr<Building> building = BuildingList::GetBuilding (m_buildings.size ());
+      Box box = building->GetBoundaries ();
+      m_buildings.push_back (building);
+      double xMax = m_xMin + m_nX * m_cellSize;
+      double yMax = m_yMin + m_nY * m_cellSize;
+      if ((m_nX == 0) || (box.xMin < m_xMin) || (box.xMax >= xMax) || (box.yMin < m_yMin) || (box.yMax >= yMax))
+        {
+          // grow the grid with some margin, so that the cost of the
+          // rebuilds is amortized over many insertions
+          Box area = box;
+          if (m_nX > 0)
+            {
+              area.xMin = std::min (box.xMin, m_xMin);
+              area.xMax = std::max (box.xMax, xMax);
+              area.yMin = std::min (box.yMin, m_yMin);
+              area.yMax = std::max (box.yMax, yMax);
+            }
+          double margin = std::max (m_cellSize, 0.25 * std::max (area.xMax - area.xMin, area.yMax - area.yMin));
+          area.xMin -= margin;
+          area.xMax += margin;
+          area.yMin -= margin;
+          area.yMax += margin;
+          Rebuild (area);
+        }
+      else
+        {
+          Insert (m_buildings.size () - 1);
+        }
+    }
+}
+
+void
+BuildingGridIndexPriv::Rebuild (const Box &area)
+{
+  NS_LOG_FUNCTION (this << area);
+  m_xMin = area.xMin;
+  m_yMin = area.yMin;
+  m_nX = std::max (1, (int) std::ceil ((area.xMax - area.xMin) / m_cellSize));
+  m_nY = std::max (1, (int) std::ceil ((area.yMax - area.yMin) / m_cellSize));
+  m_cells.clear ();
+  m_cells.resize (m_nX * m_nY);
+  for (uint32_t i = 0; i < m_buildings.size (); ++i)
+    {
+      Insert (i);
+    }
+}
+
+void
+BuildingGridIndexPriv::Insert (uint32_t index)
+{
+  Box box = m_buildings[index]->GetBoundaries ();
+  uint32_t ix0 = (uint32_t) std::floor ((box.xMin - m_xMin) / m_cellSize);
+  uint32_t ix1 = std::min (m_nX - 1, (uint32_t) std::floor ((box.xMax - m_xMin) / m_cellSize));
+  uint32_t iy0 = (uint32_t) std::floor ((box.yMin - m_yMin) / m_cellSize);
+  uint32_t iy1 = std::min (m_nY - 1, (uint32_t) std::floor ((box.yMax - m_yMin) / m_cellSize));
+  for (uint32_t iy = iy0; iy <= iy1; ++iy)
+    {
+      for (uint32_t ix = ix0; ix <= ix1; ++ix)
+        {
+          m_cells[iy * m_nX + ix].push_back (index);
+        }
+    }
+}
+
+Ptr<Building>
+BuildingGridIndexPriv::GetBuilding (const Vector &position)
+{
+  Sync ();
+  if (m_nX == 0)
+    {
+      return 0;
+    }
+  double fx = std::floor ((position.x - m_xMin) / m_cellSize);
+  double fy = std::floor ((position.y - m_yMin) / m_cellSize);
+  if ((fx < 0) || (fx >= m_nX) || (fy < 0) || (fy >= m_nY))
+    {
+      return 0;
+    }
+  const std::vector<uint32_t> &cell = m_cells[(uint32_t) fy * m_nX + (uint32_t) fx];
+  for (std::vector<uint32_t>::const_iterator it = cell.begin (); it != cell.end (); ++it)
+    {
+      if (m_buildings[*it]->IsInside (position))
+        {
+          return m_buildings[*it];
+        }
+    }
+  return 0;
+}
+
+
+Ptr<Building>
+BuildingGridIndex::GetBuilding (const Vector &position)
+{
+  return BuildingGridIndexPriv::Get ()->GetBuilding (position);
+}
+
+void
+BuildingGridIndex::MakeConsistent (Ptr<BuildingsMobilityModel> bmm)
+{
+  Vector position = bmm->GetPosition ();
+  Ptr<Building> building = GetBuilding (position);
+  if (building != 0)
+    {
+      uint16_t floor = building->GetFloor (position);
+      uint16_t roomX = building->GetRoomX (position);
+      uint16_t roomY = building->GetRoomY (position);
+      bmm->SetIndoor (building, floor, roomX, roomY);
+    }
+  else
+    {
+      bmm->SetOutdoor ();
+    }
+}
+
+void
+BuildingGridIndex::SetCellSize (double cellSize)
+{
+  BuildingGridIndexPriv::Get ()->SetCellSize (cellSize);
+}
+
+} // namespace ns3
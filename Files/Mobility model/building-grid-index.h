@@ -0,0 +1,68 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#ifndef BUILDING_GRID_INDEX_H
+#define BUILDING_GRID_INDEX_H
+
+#include <ns3/ptr.h>
+#include <ns3/vector.h>
+
+namespace ns3 {
+
+class Building;
+class BuildingsMobilityModel;
+
+/**
+ * \ingroup buildings
+ * \brief Uniform grid index over the boundaries of all the buildings
+ *
+ * Every building of the BuildingList is registered in the grid cells
+ * overlapped by its boundaries, so that the building (if any) which
+ * contains a given point is found by looking only at the few
+ * buildings of one cell, instead of scanning the whole BuildingList.
+ *
+ * The index is kept up to date incrementally: buildings added to the
+ * BuildingList (e.g., by GridBuildingAllocator) after the last query
+ * are inserted at the next query. The boundaries of a building are
+ * assumed not to change after it has been indexed.
+ */
+class BuildingGridIndex
+{
+public:
+  /**
+   * \param position a point
+   * \return the building containing the point, or 0 if the point is outdoor
+   */
+  static Ptr<Building> GetBuilding (const Vector &position);
+
+  /**
+   * Same as BuildingsHelper::MakeConsistent, using the index
+   *
+   * \param bmm the mobility model to be made consistent
+   */
+  static void MakeConsistent (Ptr<BuildingsMobilityModel> bmm);
+
+  /**
+   * Set the size of the (square) grid cells. The index is rebuilt.
+   *
+   * \param cellSize the side of a cell [m]
+   */
+  static void SetCellSize (double cellSize);
+};
+
+} // namespace ns3
+
+#endif // BUILDING_GRID_INDEX_H
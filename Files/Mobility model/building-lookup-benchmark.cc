@@ -0,0 +1,124 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+// Compares the cost of finding the building which contains a point
+// by scanning the BuildingList (as done by BuildingsHelper::MakeConsistent)
+// and by using the BuildingGridIndex, for an increasing number of buildings.
+
+#include "ns3/core-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/buildings-module.h"
+#include <ns3/building-grid-index.h>
+#include <ns3/system-wall-clock-ms.h>
+#include <algorithm>
+#include <vector>
+
+using namespace ns3;
+
+static Ptr<Building>
+LinearLookup (const Vector &position)
+{
+  for (BuildingList::Iterator it = BuildingList::Begin (); it != BuildingList::End (); ++it)
+    {
+      if ((*it)->IsInside (position))
+        {
+          return *it;
+        }
+    }
+  return 0;
+}
+
+int main (int argc, char *argv[])
+{
+  uint32_t nLookups = 100000;
+  uint32_t maxBuildings = 10000;
+  CommandLine cmd;
+  cmd.AddValue ("nLookups", "Number of point lookups per measurement", nLookups);
+  cmd.AddValue ("maxBuildings", "Maximum number of buildings", maxBuildings);
+  cmd.Parse (argc, argv);
+
+  // buildings are laid out like the apartment blocks of the dual stripe scenario
+  Ptr<GridBuildingAllocator> gridBuildingAllocator = CreateObject<GridBuildingAllocator> ();
+  gridBuildingAllocator->SetAttribute ("GridWidth", UintegerValue (100));
+  gridBuildingAllocator->SetAttribute ("LengthX", DoubleValue (50));
+  gridBuildingAllocator->SetAttribute ("LengthY", DoubleValue (20));
+  gridBuildingAllocator->SetAttribute ("DeltaX", DoubleValue (10));
+  gridBuildingAllocator->SetAttribute ("DeltaY", DoubleValue (10));
+  gridBuildingAllocator->SetAttribute ("Height", DoubleValue (3));
+  gridBuildingAllocator->SetBuildingAttribute ("NRoomsX", UintegerValue (5));
+  gridBuildingAllocator->SetBuildingAttribute ("NRoomsY", UintegerValue (2));
+  gridBuildingAllocator->SetBuildingAttribute ("NFloors", UintegerValue (1));
+
+  Ptr<UniformRandomVariable> xVal = CreateObject<UniformRandomVariable> ();
+  Ptr<UniformRandomVariable> yVal = CreateObject<UniformRandomVariable> ();
+
+  std::cout << "buildings\tlinear [ns/lookup]\tgrid [ns/lookup]\tmismatches" << std::endl;
+  uint32_t nBuildings = 0;
+  for (uint32_t target = 10; target <= maxBuildings; target *= 10)
+    {
+      gridBuildingAllocator->Create (target - nBuildings);
+      nBuildings = target;
+
+      // the points span the area covered by the buildings
+      uint32_t nRows = (nBuildings + 99) / 100;
+      xVal->SetAttribute ("Max", DoubleValue (60.0 * std::min (nBuildings, (uint32_t) 100)));
+      yVal->SetAttribute ("Max", DoubleValue (30.0 * nRows));
+      std::vector<Vector> points;
+      for (uint32_t i = 0; i < nLookups; ++i)
+        {
+          points.push_back (Vector (xVal->GetValue (), yVal->GetValue (), 1.5));
+        }
+
+      // the buildings found, compared point by point afterwards
+      std::vector<Building *> linearResults (nLookups);
+      std::vector<Building *> gridResults (nLookups);
+
+      SystemWallClockMs clock;
+      clock.Start ();
+      for (uint32_t i = 0; i < nLookups; ++i)
+        {
+          linearResults[i] = PeekPointer (LinearLookup (points[i]));
+        }
+      int64_t linearMs = clock.End ();
+
+      // the first lookup also inserts the new buildings in the index
+      clock.Start ();
+      for (uint32_t i = 0; i < nLookups; ++i)
+        {
+          gridResults[i] = PeekPointer (BuildingGridIndex::GetBuilding (points[i]));
+        }
+      int64_t gridMs = clock.End ();
+
+      uint32_t nMismatches = 0;
+      for (uint32_t i = 0; i < nLookups; ++i)
+        {
+          if (linearResults[i] != gridResults[i])
+            {
+              ++nMismatches;
+            }
+        }
+
+      std::cout << nBuildings << "\t\t"
+                << (linearMs * 1e6 / nLookups) << "\t\t\t"
+                << (gridMs * 1e6 / nLookups) << "\t\t\t"
+                << nMismatches
+                << std::endl;
+    }
+
+  Simulator::Destroy ();
+  return 0;
+}
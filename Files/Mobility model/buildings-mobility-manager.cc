@@ -0,0 +1,202 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <ns3/buildings-mobility-manager.h>
+#include <ns3/buildings-mobility-model.h>
+#include <ns3/simulator.h>
+#include <ns3/node.h>
+#include <ns3/log.h>
+#include <ns3/assert.h>
+
+#include <limits>
+
+NS_LOG_COMPONENT_DEFINE ("BuildingsMobilityManager");
+
+namespace ns3 {
+
+NS_OBJECT_ENSURE_REGISTERED (BuildingsMobilityManager);
+
+TypeId
+BuildingsMobilityManager::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::BuildingsMobilityManager")
+    .SetParent<Object> ()
+    .AddConstructor<BuildingsMobilityManager> ()
+    .AddAttribute ("Interval",
+                   "The time between two consecutive updates of all the registered models.",
+                   TimeValue (MilliSeconds (1)),
+                   MakeTimeAccessor (&BuildingsMobilityManager::m_interval),
+                   MakeTimeChecker ());
+
+  return tid;
+}
+
+
+BuildingsMobilityManager::BuildingsMobilityManager ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+BuildingsMobilityManager::~BuildingsMobilityManager ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+BuildingsMobilityManager::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_tickEvent.Cancel ();
+  m_models.clear ();
+  Object::DoDispose ();
+}
+
+void
+BuildingsMobilityManager::Add (Ptr<BuildingsMobilityModel> model)
+{
+  NS_LOG_FUNCTION (this << model);
+  NS_ASSERT_MSG (model->m_manager == 0, "model already registered with a BuildingsMobilityManager");
+  if (m_models.empty ())
+    {
+      m_lastTick = Simulator::Now ();
+      m_tickEvent = Simulator::Schedule (m_interval, &BuildingsMobilityManager::Tick, this);
+    }
+  uint32_t index = m_models.size ();
+  m_models.push_back (model);
+  m_x.push_back (0);
+  m_y.push_back (0);
+  m_z.push_back (0);
+  m_vx.push_back (0);
+  m_vy.push_back (0);
+  m_vz.push_back (0);
+  m_nextCrossing.push_back (std::numeric_limits<double>::infinity ());
+  m_rebound.push_back (false);
+  model->m_manager = this;
+  model->m_managerIndex = index;
+  // from now on the model does not schedule events of its own
+  model->ScheduleNextCrossing ();
+}
+
+void
+BuildingsMobilityManager::Install (NodeContainer c)
+{
+  NS_LOG_FUNCTION (this);
+  for (NodeContainer::Iterator it = c.Begin (); it != c.End (); ++it)
+    {
+      if ((*it)->IsStationary ())
+        {
+          // eNBs and gateways schedule no event of their own anyway
+          continue;
+        }
+      Ptr<BuildingsMobilityModel> model = (*it)->GetObject<BuildingsMobilityModel> ();
+      NS_ASSERT_MSG (model != 0, "node " << (*it)->GetId () << " has no BuildingsMobilityModel");
+      Add (model);
+    }
+}
+
+uint32_t
+BuildingsMobilityManager::GetN (void) const
+{
+  return m_models.size ();
+}
+
+Vector
+BuildingsMobilityManager::GetPosition (uint32_t index) const
+{
+  NS_ASSERT (index < m_models.size ());
+  double dt = (Simulator::Now () - m_lastTick).GetSeconds ();
+  return Vector (m_x[index] + m_vx[index] * dt,
+                 m_y[index] + m_vy[index] * dt,
+                 m_z[index] + m_vz[index] * dt);
+}
+
+void
+BuildingsMobilityManager::Update (uint32_t index, double delay, bool rebound)
+{
+  NS_LOG_FUNCTION (this << index << delay << rebound);
+  NS_ASSERT (index < m_models.size ());
+  ConstantVelocityHelper &helper = m_models[index]->m_helper;
+  helper.Update ();
+  Vector position = helper.GetCurrentPosition ();
+  Vector velocity = helper.GetVelocity ();
+  // the arrays hold the positions at the time of the last tick
+  double dt = (Simulator::Now () - m_lastTick).GetSeconds ();
+  m_x[index] = position.x - velocity.x * dt;
+  m_y[index] = position.y - velocity.y * dt;
+  m_z[index] = position.z - velocity.z * dt;
+  m_vx[index] = velocity.x;
+  m_vy[index] = velocity.y;
+  m_vz[index] = velocity.z;
+  if (delay < 0)
+    {
+      m_nextCrossing[index] = std::numeric_limits<double>::infinity ();
+    }
+  else
+    {
+      m_nextCrossing[index] = Simulator::Now ().GetSeconds () + delay;
+    }
+  m_rebound[index] = rebound;
+}
+
+void
+BuildingsMobilityManager::Tick ()
+{
+  NS_LOG_FUNCTION (this);
+  double dt = (Simulator::Now () - m_lastTick).GetSeconds ();
+  m_lastTick = Simulator::Now ();
+  uint32_t n = m_models.size ();
+
+  // one pass over contiguous arrays, which the compiler can vectorize
+  double *x = &m_x[0];
+  double *y = &m_y[0];
+  double *z = &m_z[0];
+  const double *vx = &m_vx[0];
+  const double *vy = &m_vy[0];
+  const double *vz = &m_vz[0];
+  for (uint32_t i = 0; i < n; ++i)
+    {
+      x[i] += vx[i] * dt;
+      y[i] += vy[i] * dt;
+      z[i] += vz[i] * dt;
+    }
+
+  // only the models which crossed a boundary are called back
+  double now = m_lastTick.GetSeconds ();
+  for (uint32_t i = 0; i < n; ++i)
+    {
+      if (m_nextCrossing[i] <= now)
+        {
+          Ptr<BuildingsMobilityModel> model = m_models[i];
+          model->m_helper.SetPosition (Vector (m_x[i], m_y[i], m_z[i]));
+          model->m_helper.SetVelocity (Vector (m_vx[i], m_vy[i], m_vz[i]));
+          if (m_rebound[i])
+            {
+              model->Rebound ();
+            }
+          else
+            {
+              model->CrossBoundary ();
+            }
+        }
+    }
+
+  m_tickEvent = Simulator::Schedule (m_interval, &BuildingsMobilityManager::Tick, this);
+  ++BuildingsMobilityModel::m_nUpdateEvents;
+}
+
+
+} // namespace ns3
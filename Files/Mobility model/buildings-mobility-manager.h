@@ -0,0 +1,116 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#ifndef BUILDINGS_MOBILITY_MANAGER_H
+#define BUILDINGS_MOBILITY_MANAGER_H
+
+#include <ns3/object.h>
+#include <ns3/ptr.h>
+#include <ns3/nstime.h>
+#include <ns3/event-id.h>
+#include <ns3/vector.h>
+#include <ns3/node-container.h>
+#include <vector>
+
+namespace ns3 {
+
+class BuildingsMobilityModel;
+
+/**
+ * \ingroup mobility
+ * \brief Advances many BuildingsMobilityModel instances with one event per tick
+ *
+ * The positions and velocities of all the registered models are kept
+ * in contiguous arrays (one per coordinate) which are advanced in a
+ * single pass every Interval. The registered models do not schedule
+ * any event of their own: the manager only calls back a model when
+ * its trajectory has crossed the boundary of its room or building
+ * (or has hit a wall of its room, for constrained nodes), so that
+ * NotifyCourseChange is fired only for those models.
+ */
+class BuildingsMobilityManager : public Object
+{
+public:
+  static TypeId GetTypeId (void);
+  BuildingsMobilityManager ();
+  virtual ~BuildingsMobilityManager ();
+
+  /**
+   * Register a model with the manager
+   *
+   * \param model the model to be advanced by the manager
+   */
+  void Add (Ptr<BuildingsMobilityModel> model);
+
+  /**
+   * Register the BuildingsMobilityModel of each node of the
+   * container, except the stationary nodes (see Node::IsStationary),
+   * which need no update at all
+   *
+   * \param c the nodes
+   */
+  void Install (NodeContainer c);
+
+  /**
+   * \return the number of registered models
+   */
+  uint32_t GetN (void) const;
+
+  /**
+   * \param index the index of the model, as assigned by Add
+   * \return the current position of the model
+   */
+  Vector GetPosition (uint32_t index) const;
+
+  /**
+   * Refresh the stored position and velocity of a model from its
+   * ConstantVelocityHelper, and set the time of its next boundary
+   * crossing.
+   *
+   * \param index the index of the model, as assigned by Add
+   * \param delay the time [s] to the next crossing, negative if none
+   * \param rebound whether the model bounces (true) or changes room or
+   * building (false) at the next crossing
+   */
+  void Update (uint32_t index, double delay, bool rebound);
+
+private:
+  virtual void DoDispose (void);
+  void Tick ();
+
+  Time m_interval;
+  Time m_lastTick;
+  EventId m_tickEvent;
+
+  std::vector<Ptr<BuildingsMobilityModel> > m_models;
+  std::vector<double> m_x;
+  std::vector<double> m_y;
+  std::vector<double> m_z;
+  std::vector<double> m_vx;
+  std::vector<double> m_vy;
+  std::vector<double> m_vz;
+  /**
+   * absolute time [s] of the next crossing of each model, infinity if none
+   */
+  std::vector<double> m_nextCrossing;
+  std::vector<bool> m_rebound;
+};
+
+
+} // namespace ns3
+
+
+#endif // BUILDINGS_MOBILITY_MANAGER_H
@@ -22,9 +22,17 @@
 #include <ns3/simulator.h>
 #include <ns3/position-allocator.h>
 #include <ns3/buildings-mobility-model.h>
+#include <ns3/buildings-mobility-manager.h>
 #include <ns3/pointer.h>
 #include <ns3/log.h>
 #include <ns3/assert.h>
+#include <ns3/boolean.h>
+#include <ns3/building-list.h>
+#include <ns3/building-grid-index.h>
+#include <ns3/node.h>
+
+#include <algorithm>
+#include <limits>
 
 NS_LOG_COMPONENT_DEFINE ("BuildingsMobilityModel");
 
@@ -32,13 +40,24 @@ namespace ns3 {
 
 NS_OBJECT_ENSURE_REGISTERED (BuildingsMobilityModel);
 
+uint64_t BuildingsMobilityModel::m_nUpdateEvents = 0;
+
 TypeId
 BuildingsMobilityModel::GetTypeId (void)
 {
   static TypeId tid = TypeId ("ns3::BuildingsMobilityModel")
     .SetParent<MobilityModel> ()
     .SetGroupName ("Mobility")
-    .AddConstructor<BuildingsMobilityModel> ();
+    .AddConstructor<BuildingsMobilityModel> ()
+    .AddAttribute ("AnalyticUpdate",
+                   "If true, the position is computed analytically whenever it is requested, "
+                   "and an event is scheduled only when the node crosses the boundary of its room "
+                   "or of a building (no event at all for stationary nodes). "
+                   "If false (the default), the position is updated every 1 ms. In both modes, "
+                   "the wall hits of a node constrained to its room are predicted rather than polled.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&BuildingsMobilityModel::m_analytic),
+                   MakeBooleanChecker ());
 
   return tid;
 }
@@ -51,11 +70,21 @@ BuildingsMobilityModel::BuildingsMobilityModel ()
   m_nFloor = 1;
   m_roomX = 1;
   m_roomY = 1;
+  constraint = false;
+  m_stationary = false;
+  m_managerIndex = 0;
+}
+
+BuildingsMobilityModel::~BuildingsMobilityModel ()
+{
+  NS_LOG_FUNCTION (this);
 }
 
 void
 BuildingsMobilityModel::DoStart (void)
 {
+  Ptr<Node> node = GetObject<Node> ();
+  m_stationary = (node != 0) && node->IsStationary ();
   DoStartPrivate ();
   MobilityModel::DoStart ();
 }
@@ -64,6 +93,8 @@ void
 BuildingsMobilityModel::DoDispose (void)
 {
   NS_LOG_FUNCTION (this);
+  m_event.Cancel ();
+  m_manager = 0;
   MobilityModel::DoDispose ();
 }
 
@@ -71,6 +102,10 @@ Vector
 BuildingsMobilityModel::DoGetPosition (void) const
 {
   NS_LOG_FUNCTION (this);
+  if (m_manager != 0)
+    {
+      return m_manager->GetPosition (m_managerIndex);
+    }
   m_helper.Update ();
   return m_helper.GetCurrentPosition ();
 }
@@ -82,73 +117,245 @@ BuildingsMobilityModel::DoStartPrivate (void)  //Function for updating New posit
   Vector vector=m_vel;
   m_helper.SetVelocity (vector);
   m_helper.Unpause ();
-  DoWalk ();
+  if (m_analytic || m_manager != 0)
+    {
+      ScheduleNextCrossing ();
+      NotifyCourseChange ();
+    }
+  else if (m_stationary)
+    {
+      NotifyCourseChange ();
+    }
+  else
+    {
+      DoWalk ();
+    }
+}
+
+void
+BuildingsMobilityModel::ScheduleNextCrossing ()
+{
+  NS_LOG_FUNCTION (this);
+  m_event.Cancel ();
+  Vector position = m_helper.GetCurrentPosition ();
+  Vector speed = m_helper.GetVelocity ();
+  double delay = -1;
+  bool rebound = false;
+  if (m_stationary || (speed.x == 0 && speed.y == 0 && speed.z == 0))
+    {
+      // the position will never change
+    }
+  else if (m_indoor && m_myBuilding != 0)
+    {
+      delay = GetExitTime (GetRoomBoundaries (), position, speed);
+      // a node confined to its room bounces exactly when the wall is hit
+      rebound = constraint;
+    }
+  else
+    {
+      for (BuildingList::Iterator it = BuildingList::Begin (); it != BuildingList::End (); ++it)
+        {
+          double t = GetEntryTime ((*it)->GetBoundaries (), position, speed);
+          if ((t >= 0) && ((delay < 0) || (t < delay)))
+            {
+              delay = t;
+            }
+        }
+    }
+  if (m_manager != 0)
+    {
+      m_manager->Update (m_managerIndex, delay, rebound);
+    }
+  else if (delay < 0)
+    {
+      NS_LOG_LOGIC ("no boundary will ever be crossed");
+    }
+  else if (rebound)
+    {
+      m_event = Simulator::Schedule (GetCrossingEventDelay (delay), &BuildingsMobilityModel::Rebound, this);
+      ++m_nUpdateEvents;
+    }
+  else
+    {
+      m_event = Simulator::Schedule (GetCrossingEventDelay (delay), &BuildingsMobilityModel::CrossBoundary, this);
+      ++m_nUpdateEvents;
+    }
+}
+
+Time
+BuildingsMobilityModel::GetCrossingEventDelay (double delay)
+{
+  // Seconds () rounds to the closest tick, which may be just before the
+  // crossing
+  return Seconds (delay) + NanoSeconds (1);
+}
+
+void
+BuildingsMobilityModel::CrossBoundary ()
+{
+  NS_LOG_FUNCTION (this);
+  m_helper.Update ();
+  BuildingGridIndex::MakeConsistent (this);
+  NotifyCourseChange ();
+  ScheduleNextCrossing ();
+}
+
+Box
+BuildingsMobilityModel::GetRoomBoundaries ()
+{
+  NS_ASSERT (m_myBuilding != 0);
+  Box box = m_myBuilding->GetBoundaries ();
+  double dx = (box.xMax - box.xMin) / m_myBuilding->GetNRoomsX ();
+  double dy = (box.yMax - box.yMin) / m_myBuilding->GetNRoomsY ();
+  double dz = (box.zMax - box.zMin) / m_myBuilding->GetNFloors ();
+  return Box (box.xMin + (m_roomX - 1) * dx, box.xMin + m_roomX * dx,
+              box.yMin + (m_roomY - 1) * dy, box.yMin + m_roomY * dy,
+              box.zMin + (m_nFloor - 1) * dz, box.zMin + m_nFloor * dz);
+}
+
+double
+BuildingsMobilityModel::GetExitTime (const Box &box, const Vector &position, const Vector &velocity)
+{
+  double pos[3] = {position.x, position.y, position.z};
+  double vel[3] = {velocity.x, velocity.y, velocity.z};
+  double lo[3] = {box.xMin, box.yMin, box.zMin};
+  double hi[3] = {box.xMax, box.yMax, box.zMax};
+  double tExit = -1;
+  for (int i = 0; i < 3; ++i)
+    {
+      if (vel[i] == 0)
+        {
+          continue;
+        }
+      double t = (((vel[i] > 0) ? hi[i] : lo[i]) - pos[i]) / vel[i];
+      if (t < 0)
+        {
+          t = 0;
+        }
+      if ((tExit < 0) || (t < tExit))
+        {
+          tExit = t;
+        }
+    }
+  return tExit;
+}
+
+double
+BuildingsMobilityModel::GetEntryTime (const Box &box, const Vector &position, const Vector &velocity)
+{
+  double pos[3] = {position.x, position.y, position.z};
+  double vel[3] = {velocity.x, velocity.y, velocity.z};
+  double lo[3] = {box.xMin, box.yMin, box.zMin};
+  double hi[3] = {box.xMax, box.yMax, box.zMax};
+  double tEnter = -std::numeric_limits<double>::infinity ();
+  double tExit = std::numeric_limits<double>::infinity ();
+  for (int i = 0; i < 3; ++i)
+    {
+      if (vel[i] == 0)
+        {
+          if ((pos[i] < lo[i]) || (pos[i] > hi[i]))
+            {
+              return -1;
+            }
+          continue;
+        }
+      double t1 = (lo[i] - pos[i]) / vel[i];
+      double t2 = (hi[i] - pos[i]) / vel[i];
+      tEnter = std::max (tEnter, std::min (t1, t2));
+      tExit = std::min (tExit, std::max (t1, t2));
+    }
+  if ((tEnter > tExit) || (tEnter < 0))
+    {
+      // the box is either missed, behind, or we are already inside it
+      return -1;
+    }
+  return tEnter;
 }
 
 void
-BuildingsMobilityModel::DoWalk ()              //Checking whether new position is out of room.
+BuildingsMobilityModel::DoWalk ()              //Updating the position every 1 ms.
 {
-  double x,y,z;
-  Vector nextpos;
-  x=GetRoomNumberX();
-  y=GetRoomNumberY();
-  z=GetFloorNumber();
   Time curr_time = Simulator::Now ();
   NS_ASSERT (lastUpdate <= curr_time); 
-  Time delTime = curr_time - lastUpdate;       //Time interval for which new position is to be updated. 
   lastUpdate = curr_time;
-  double delS = delTime.GetSeconds ();
-  Vector position = m_helper.GetCurrentPosition ();
-  Vector speed = m_helper.GetVelocity ();    
-  Vector nextPosition = position;          //New Position.
-  nextPosition.x += speed.x * delS;
-  nextPosition.y += speed.y * delS;
-  nextPosition.z += speed.z * delS;
   m_event.Cancel ();
-  Ptr<Building> curr_building=GetBuilding ();
   Time delay = Seconds(0.001);
-  if (constraint){      //If constraint is true, then it checks whether new position leads to new room. 
-        if (curr_building->IsInside(nextpos) == true&&((x==curr_building->GetRoomX (nextpos))&&(y==curr_building->GetRoomY (nextpos))&&(z==curr_building->GetFloor (nextpos)))) 
-        {    
-                m_event = Simulator::Schedule (delay, &BuildingsMobilityModel::DoStartPrivate, this); 
-        }
-        else
-        {
-                m_event = Simulator::Schedule (delay, &BuildingsMobilityModel::Rebound, this);
-        }
+  double wallHit = -1;
+  if (constraint && m_indoor && m_myBuilding != 0)
+    {
+      // same prediction as ScheduleNextCrossing, rather than finding
+      // the node out of its room at the next update
+      wallHit = GetExitTime (GetRoomBoundaries (), m_helper.GetCurrentPosition (), m_helper.GetVelocity ());
     }
-    else{    //Node moves without ant room constraint
-              m_event = Simulator::Schedule (delay, &BuildingsMobilityModel::DoStartPrivate, this);       
+  if ((wallHit >= 0) && (wallHit < delay.GetSeconds ()))
+    {
+      m_event = Simulator::Schedule (GetCrossingEventDelay (wallHit), &BuildingsMobilityModel::Rebound, this);
+    }
+  else
+    {
+      m_event = Simulator::Schedule (delay, &BuildingsMobilityModel::DoStartPrivate, this);
     }
+  ++m_nUpdateEvents;
   NotifyCourseChange ();
 }
 
 void
-BuildingsMobilityModel::Rebound ()     //Getting the closest side of room and setting velocity in opposite direction.
+BuildingsMobilityModel::Rebound ()     //Reflecting the velocity on the wall(s) of the room that have been hit.
 {
-  Ptr<Building> curr_building=GetBuilding ();
-  Box box=curr_building->GetBoundaries ();    
+  NS_LOG_FUNCTION (this);
+  Box box = GetRoomBoundaries ();
+  // the event runs just past the wall (see GetCrossingEventDelay), and
+  // the node is brought back exactly onto the walls it went through
   m_helper.UpdateWithBounds (box);
   Vector position = m_helper.GetCurrentPosition ();
   Vector speed = m_helper.GetVelocity ();
-  switch (box.GetClosestSide (position))  
-    {
-    case Box::RIGHT:
-    case Box::LEFT:
-      speed.x = -speed.x;            
-      break;
-    case Box::TOP:
-    case Box::BOTTOM:
+  bool hit = false;
+  if (((speed.x > 0) && (position.x >= box.xMax)) || ((speed.x < 0) && (position.x <= box.xMin)))
+    {
+      speed.x = -speed.x;
+      hit = true;
+    }
+  if (((speed.y > 0) && (position.y >= box.yMax)) || ((speed.y < 0) && (position.y <= box.yMin)))
+    {
       speed.y = -speed.y;
-      break;
-    case Box::UP:
-    case Box::DOWN:
+      hit = true;
+    }
+  if (((speed.z > 0) && (position.z >= box.zMax)) || ((speed.z < 0) && (position.z <= box.zMin)))
+    {
       speed.z = -speed.z;
-      break;
+      hit = true;
+    }
+  if (!hit)
+    {
+      switch (box.GetClosestSide (position))  
+        {
+        case Box::RIGHT:
+        case Box::LEFT:
+          speed.x = -speed.x;            
+          break;
+        case Box::TOP:
+        case Box::BOTTOM:
+          speed.y = -speed.y;
+          break;
+        case Box::UP:
+        case Box::DOWN:
+          speed.z = -speed.z;
+          break;
+        }
     }
+  // keep the new direction when DoStartPrivate re-applies m_vel
+  m_vel = speed;
   m_helper.SetVelocity (speed);
   m_helper.Unpause ();
-  DoWalk ();
+  if (m_analytic || m_manager != 0)
+    {
+      ScheduleNextCrossing ();
+      NotifyCourseChange ();
+    }
+  else
+    {
+      DoWalk ();
+    }
 }
 
 void 
@@ -157,7 +364,16 @@ BuildingsMobilityModel::DoSetPosition (const Vector &position)
   NS_LOG_FUNCTION (this);
   m_helper.SetPosition (position);
   lastUpdate = Simulator::Now ();
-  m_event = Simulator::ScheduleNow (&BuildingsMobilityModel::DoStartPrivate, this);
+  m_event.Cancel ();
+  if (m_analytic || m_manager != 0 || m_stationary)
+    {
+      DoStartPrivate ();
+    }
+  else
+    {
+      m_event = Simulator::ScheduleNow (&BuildingsMobilityModel::DoStartPrivate, this);
+      ++m_nUpdateEvents;
+    }
 }
 Vector
 BuildingsMobilityModel::DoGetVelocity (void) const
@@ -237,5 +453,11 @@ BuildingsMobilityModel::GetBuilding ()
   return (m_myBuilding);
 }
 
+uint64_t
+BuildingsMobilityModel::GetNUpdateEvents (void)
+{
+  return m_nUpdateEvents;
+}
+
   
 } // namespace
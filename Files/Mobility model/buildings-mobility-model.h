@@ -35,6 +35,7 @@
 
 namespace ns3 {
 
+class BuildingsMobilityManager;
 
 /**
  * \ingroup mobility
@@ -46,9 +47,12 @@ namespace ns3 {
  */
 class BuildingsMobilityModel : public MobilityModel
 {
+  friend class BuildingsMobilityManager;
+
 public:
   static TypeId GetTypeId (void);
   BuildingsMobilityModel ();
+  virtual ~BuildingsMobilityModel ();
 
   /** 
    * 
@@ -101,6 +105,14 @@ public:
    * \return 
    */
   Ptr<Building> GetBuilding ();
+
+  /** 
+   * 
+   * \return the total number of position update events scheduled so
+   * far by all the BuildingsMobilityModel instances
+   */
+  static uint64_t GetNUpdateEvents (void);
+
   //New objects added
   Vector m_vel;
   bool constraint;
@@ -113,6 +125,41 @@ private:
   void Rebound ();
   virtual void DoStart();
   void DoStartPrivate();
+  /** 
+   * Schedule the next position update at the time at which the
+   * current trajectory crosses the boundary of the current room (if
+   * indoor) or enters a building (if outdoor). If the node is
+   * constrained to its room, Rebound is scheduled at the time the
+   * wall is hit instead. Nothing is scheduled for stationary nodes.
+   * If the model is registered with a BuildingsMobilityManager, the
+   * crossing time is handed over to the manager instead.
+   */
+  void ScheduleNextCrossing ();
+  void CrossBoundary ();
+  /** 
+   * \param delay the time [s] until the node crosses a boundary
+   * \return the delay of the Rebound or CrossBoundary event handling
+   * the crossing, which runs one nanosecond after it so that the node
+   * is never found short of the boundary
+   */
+  static Time GetCrossingEventDelay (double delay);
+  /** 
+   * 
+   * \return the boundaries of the room in which the node is located
+   */
+  Box GetRoomBoundaries ();
+  /** 
+   * \return the time [s] after which a point moving from position
+   * with the given velocity leaves the box, or a negative value if it
+   * never does
+   */
+  static double GetExitTime (const Box &box, const Vector &position, const Vector &velocity);
+  /** 
+   * \return the time [s] after which a point moving from position
+   * with the given velocity enters the box, or a negative value if it
+   * never does
+   */
+  static double GetEntryTime (const Box &box, const Vector &position, const Vector &velocity);
   ///////////////////////
   virtual void DoDispose (void);
   virtual Vector DoGetPosition (void) const;
@@ -125,6 +172,22 @@ private:
   uint8_t m_nFloor;
   uint8_t m_roomX;
   uint8_t m_roomY;
+  bool m_analytic;
+  /**
+   * true if the role of the node implies a fixed position (eNBs and
+   * gateways, see Node::IsStationary): the model then schedules no
+   * event at all, whatever the update mode, and reads m_vel only when
+   * the position is set
+   */
+  bool m_stationary;
+  /**
+   * the manager advancing this model, if any; when set, the model
+   * does not schedule any event of its own
+   */
+  Ptr<BuildingsMobilityManager> m_manager;
+  uint32_t m_managerIndex;
+
+  static uint64_t m_nUpdateEvents;
 
 };
 
@@ -32,18 +32,17 @@ using namespace ns3;
 FILE *fr=fopen("sinr","w");
 FILE *fp=fopen("datadl","w");
 /*void func(Ptr<RadioEnvironmentMapHelper> remHelper){
-        //std::cout<<"yes\n";
-        remHelper->pause=true;
-        if((remHelper->pos_sinr).begin ()->z==1.5){std::cout<<"kn\n"<<(remHelper->pos_sinr).begin ()->sinr<<"\n";}
-        if((remHelper->pos_sinr).end ()->z==1.5){std::cout<<"bk\n"<<(remHelper->pos_sinr).end ()->sinr<<"\n";}
-        for (remHelper->iter = (remHelper->pos_sinr).begin (); remHelper->iter != (remHelper->pos_sinr).end (); remHelper->iter++)
+        // the snapshot is not modified by the REM points computed afterwards
+        Ptr<RemRaster> snapshot = remHelper->GetSnapshot ();
+        for (uint32_t ix = 0; ix < snapshot->GetXRes (); ix++)
         {
-                fprintf(fr,"Positions: %lf...%lf...%lf\n",(remHelper->iter)->x,(remHelper->iter)->y,(remHelper->iter)->z);
-                fprintf(fr,"SINR:%lf\n",(remHelper->iter)->sinr);
-                std::cout<<"Positions: "<<(remHelper->iter)->x<<"..."<<(remHelper->iter)->y<<"..."<<(remHelper->iter)->z<<"\n";
-                std::cout<<"SINR:"<<(remHelper->iter)->sinr<<"\n";
+                for (uint32_t iy = 0; iy < snapshot->GetYRes (); iy++)
+                {
+                        Vector p = snapshot->GetPosition (ix, iy);
+                        fprintf(fr,"Positions: %lf...%lf...%lf\n",p.x,p.y,p.z);
+                        fprintf(fr,"SINR:%lf\n",snapshot->GetSinr (ix, iy));
+                }
         }
-        remHelper->pause=false;
 }*/
 void func2(Ptr<LteHelper> ltehelper){
         int i,j;
@@ -83,8 +82,10 @@ int main (int argc, char *argv[])
   NodeContainer ueNodes;
   enbNodes.Create (2);
   ueNodes.Create (2);
-  enbNodes.Get(0)->femto=false;
-  enbNodes.Get(0)->femto=false;
+  enbNodes.Get(0)->SetRole (Node::MACRO_ENB);
+  enbNodes.Get(1)->SetRole (Node::MACRO_ENB);
+  ueNodes.Get(0)->SetRole (Node::UE);
+  ueNodes.Get(1)->SetRole (Node::UE);
 
   Ptr<BuildingsMobilityModel> mm1;
   int i;
@@ -150,7 +151,6 @@ int main (int argc, char *argv[])
   remHelper->SetAttribute ("YMin", DoubleValue (-2000.5));
   remHelper->SetAttribute ("YMax", DoubleValue (+2000.5));
   remHelper->SetAttribute ("Z", DoubleValue (1.5));
-  remHelper->pause=false;
   remHelper->Install ();
   */
   //Simulator::Schedule(Seconds(0.00366),&func,remHelper);
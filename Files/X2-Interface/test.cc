@@ -25,9 +25,13 @@
 #include <ns3/lte-module.h>
 #include <ns3/config-store-module.h>
 #include <ns3/buildings-module.h>
+#include <ns3/buildings-mobility-manager.h>
+#include <ns3/handover-latency-stats.h>
+#include <ns3/epc-s1ap-transport.h>
 #include <ns3/point-to-point-helper.h>
 #include <ns3/applications-module.h>
 #include <ns3/log.h>
+#include <ns3/system-wall-clock-ms.h>
 #include <iomanip>
 #include <ios>
 #include <string>
@@ -125,6 +129,25 @@ NotifyHandoverEndOkEnb (std::string context,
             << std::endl;
 }
 
+void
+NotifyHandoverDataEnb (std::string context, 
+                       uint16_t rnti, 
+                       uint16_t sourceCellId, 
+                       uint16_t targetCellId, 
+                       Time interruption, 
+                       uint32_t nForwarded, 
+                       uint32_t nLost)
+{
+  std::cout << context 
+            << " eNB CellId " << targetCellId 
+            << ": data of the handover of RNTI " << rnti 
+            << " from CellId " << sourceCellId 
+            << ", interruption " << interruption.GetSeconds () << " s" 
+            << ", " << nForwarded << " packets forwarded" 
+            << ", " << nLost << " lost" 
+            << std::endl;
+}
+
 bool AreOverlapping (Box a, Box b)
 {
         return !((a.xMin > b.xMax) || (b.xMin > a.xMax) || (a.yMin > b.yMax) || (b.yMin > a.yMax));
@@ -410,6 +433,67 @@ static ns3::GlobalValue g_numBearersPerUe ("numBearersPerUe",
                                                ns3::UintegerValue (1),
                                                ns3::MakeUintegerChecker<uint16_t> ());
 
+static ns3::GlobalValue g_analyticMobility ("analyticMobility",
+                                            "if true, BuildingsMobilityModel computes positions analytically and "
+                                            "only schedules events at room/building boundary crossings; "
+                                            "if false, every node polls its position every 1 ms",
+                                            ns3::BooleanValue (false),
+                                            ns3::MakeBooleanChecker ());
+
+static ns3::GlobalValue g_batchMobility ("batchMobility",
+                                         "if true, the mobility of all the UEs is advanced by a single "
+                                         "BuildingsMobilityManager event per tick",
+                                         ns3::BooleanValue (false),
+                                         ns3::MakeBooleanChecker ());
+
+static ns3::GlobalValue g_offlineRem ("offlineRem",
+                                      "if true, the REM is computed right away from a snapshot of the eNBs "
+                                      "instead of by running the simulation",
+                                      ns3::BooleanValue (false),
+                                      ns3::MakeBooleanChecker ());
+
+static ns3::GlobalValue g_remWorkers ("remWorkers",
+                                      "number of worker processes used to compute the offline REM",
+                                      ns3::UintegerValue (1),
+                                      ns3::MakeUintegerChecker<uint32_t> (1, 1024));
+
+static ns3::GlobalValue g_remShadowing ("remShadowing",
+                                        "if true, the pathloss model of the offline REM has the shadowing of the channel, "
+                                        "which makes the map depend on the run (only with remWorkers = 1 and no remCacheFile)",
+                                        ns3::BooleanValue (false),
+                                        ns3::MakeBooleanChecker ());
+
+static ns3::GlobalValue g_adaptiveRem ("adaptiveRem",
+                                       "if true, the offline REM only evaluates the points where the SINR "
+                                       "or the best server changes, and interpolates the others",
+                                       ns3::BooleanValue (false),
+                                       ns3::MakeBooleanChecker ());
+
+static ns3::GlobalValue g_remCacheFile ("remCacheFile",
+                                        "if not empty, the offline REM reuses from this file the contributions "
+                                        "of the eNBs which did not change since the previous run",
+                                        ns3::StringValue (""),
+                                        ns3::MakeStringChecker ());
+
+static ns3::GlobalValue g_s1uDirect ("s1uDirect",
+                                     "if true, the GTP-U packets are handed directly between the S1-U "
+                                     "endpoints instead of going through UDP/IP and the S1-U links",
+                                     ns3::BooleanValue (false),
+                                     ns3::MakeBooleanChecker ());
+
+static ns3::GlobalValue g_s1apSerialized ("s1apSerialized",
+                                          "if true, the S1-AP messages are sent over the S1 links and through "
+                                          "the femto gateway instead of being direct calls which take no time",
+                                          ns3::BooleanValue (false),
+                                          ns3::MakeBooleanChecker ());
+
+static ns3::GlobalValue g_homeEnbsViaGateway ("homeEnbsViaGateway",
+                                              "if true, the HeNBs are given the HomeEnb role and are connected "
+                                              "to the MME and to the SGW through the femto gateway; otherwise "
+                                              "they are connected directly, as the macro eNBs",
+                                              ns3::BooleanValue (false),
+                                              ns3::MakeBooleanChecker ());
+
 static ns3::GlobalValue g_srsPeriodicity ("srsPeriodicity",
                                                "SRS Periodicity (has to be at least greater than the number of UEs per eNB)",
                                                ns3::UintegerValue (80),
@@ -487,10 +571,33 @@ main (int argc,char *argv[])
   std::string fadingTrace = stringValue.Get ();
   GlobalValue::GetValueByName ("numBearersPerUe", uintegerValue);
   uint16_t numBearersPerUe = uintegerValue.Get ();
+  GlobalValue::GetValueByName ("analyticMobility", booleanValue);
+  bool analyticMobility = booleanValue.Get ();
+  GlobalValue::GetValueByName ("batchMobility", booleanValue);
+  bool batchMobility = booleanValue.Get ();
+  GlobalValue::GetValueByName ("offlineRem", booleanValue);
+  bool offlineRem = booleanValue.Get ();
+  GlobalValue::GetValueByName ("remWorkers", uintegerValue);
+  uint32_t remWorkers = uintegerValue.Get ();
+  GlobalValue::GetValueByName ("remShadowing", booleanValue);
+  bool remShadowing = booleanValue.Get ();
+  GlobalValue::GetValueByName ("adaptiveRem", booleanValue);
+  bool adaptiveRem = booleanValue.Get ();
+  GlobalValue::GetValueByName ("remCacheFile", stringValue);
+  std::string remCacheFile = stringValue.Get ();
+  GlobalValue::GetValueByName ("s1uDirect", booleanValue);
+  bool s1uDirect = booleanValue.Get ();
+  GlobalValue::GetValueByName ("s1apSerialized", booleanValue);
+  bool s1apSerialized = booleanValue.Get ();
+  GlobalValue::GetValueByName ("homeEnbsViaGateway", booleanValue);
+  bool homeEnbsViaGateway = booleanValue.Get ();
   GlobalValue::GetValueByName ("srsPeriodicity", uintegerValue);
   //uint16_t srsPeriodicity = uintegerValue.Get ();
 
   //Config::SetDefault ("ns3::LteEnbRrc::SrsPeriodicity", UintegerValue(srsPeriodicity));
+  Config::SetDefault ("ns3::BuildingsMobilityModel::AnalyticUpdate", BooleanValue (analyticMobility));
+  Config::SetDefault ("ns3::EpcHelper::S1uDirect", BooleanValue (s1uDirect));
+  Config::SetDefault ("ns3::EpcHelper::S1apSerialized", BooleanValue (s1apSerialized));
 
   Box macroUeBox;
 
@@ -540,6 +647,22 @@ main (int argc,char *argv[])
   homeUes.Create (nHomeUes);
   NodeContainer macroUes;
   macroUes.Create (nMacroUes);
+  for (NodeContainer::Iterator it = homeEnbs.Begin (); it != homeEnbs.End (); ++it)
+    {
+      (*it)->SetRole (homeEnbsViaGateway ? Node::HOME_ENB : Node::MACRO_ENB);
+    }
+  for (NodeContainer::Iterator it = macroEnbs.Begin (); it != macroEnbs.End (); ++it)
+    {
+      (*it)->SetRole (Node::MACRO_ENB);
+    }
+  for (NodeContainer::Iterator it = homeUes.Begin (); it != homeUes.End (); ++it)
+    {
+      (*it)->SetRole (Node::UE);
+    }
+  for (NodeContainer::Iterator it = macroUes.Begin (); it != macroUes.End (); ++it)
+    {
+      (*it)->SetRole (Node::UE);
+    }
   std::cout<<"Macro Enb's: "<<macroEnbs.GetN()<<"\n";
   MobilityHelper mobility;
   mobility.SetMobilityModel ("ns3::BuildingsMobilityModel");
@@ -858,6 +981,13 @@ main (int argc,char *argv[])
     }
 
   BuildingsHelper::MakeMobilityModelConsistent ();
+  Ptr<BuildingsMobilityManager> mobilityManager;
+  if (batchMobility)
+    {
+      mobilityManager = CreateObject<BuildingsMobilityManager> ();
+      mobilityManager->Install (homeUes);
+      mobilityManager->Install (macroUes);
+    }
   /*for(uint32_t i=0;i < nHomeEnbs;i++)
   {
    for(uint32_t j=0;i < nHomeEnbs && i!=j;j++)
@@ -865,6 +995,11 @@ main (int argc,char *argv[])
 }*/
  lteHelper->AddX2Interface (homeEnbs.Get(0),homeEnbs.Get(1));
  lteHelper->HandoverRequest (Seconds (0.30), homeUeDevs.Get (0), homeEnbDevs.Get (0), homeEnbDevs.Get (1));
+  Ptr<HandoverLatencyStats> handoverLatencyStats;
+  if (epc)
+    {
+      handoverLatencyStats = epcHelper->EnableHandoverLatencyStats ();
+    }
 
   Ptr<RadioEnvironmentMapHelper> remHelper;
   if (generateRem)
@@ -881,7 +1016,27 @@ main (int argc,char *argv[])
       remHelper->SetAttribute ("YMin", DoubleValue (macroUeBox.yMin));
       remHelper->SetAttribute ("YMax", DoubleValue (macroUeBox.yMax));
       remHelper->SetAttribute ("Z", DoubleValue (1.5));
+      if (offlineRem)
+        {
+          // same pathloss model as the one configured in the LteHelper
+          Ptr<HybridBuildingsPropagationLossModel> remPathloss = CreateObject<HybridBuildingsPropagationLossModel> ();
+          remPathloss->SetAttribute ("ShadowSigmaExtWalls", DoubleValue (0));
+          remPathloss->SetAttribute ("ShadowSigmaOutdoor", DoubleValue (remShadowing ? 1 : 0));
+          remPathloss->SetAttribute ("ShadowSigmaIndoor", DoubleValue (remShadowing ? 1.5 : 0));
+          remPathloss->SetAttribute ("Los2NlosThr", DoubleValue (1e6));
+          remHelper->SetAttribute ("Offline", BooleanValue (true));
+          remHelper->SetAttribute ("NumWorkers", UintegerValue (remWorkers));
+          remHelper->SetAttribute ("PathlossModel", PointerValue (remPathloss));
+          remHelper->SetAttribute ("NumServers", UintegerValue (2));
+          remHelper->SetAttribute ("BoundaryFile", StringValue ("lena-dual-stripe.boundary"));
+          remHelper->SetAttribute ("Adaptive", BooleanValue (adaptiveRem));
+          remHelper->SetAttribute ("CacheFile", StringValue (remCacheFile));
+        }
       remHelper->Install ();
+      if (offlineRem)
+        {
+          std::cout << "REM points evaluated: " << remHelper->GetNEvaluatedPoints () << std::endl;
+        }
       // simulation will stop right after the REM has been generated
     }
   else
@@ -907,10 +1062,33 @@ main (int argc,char *argv[])
                    MakeCallback (&NotifyHandoverEndOkEnb));
   Config::Connect ("/NodeList/*/DeviceList/*/LteUeRrc/HandoverEndOk",
                    MakeCallback (&NotifyHandoverEndOkUe));
+  Config::Connect ("/NodeList/*/ApplicationList/*/$ns3::EpcEnbApplication/HandoverData",
+                   MakeCallback (&NotifyHandoverDataEnb));
 
   Simulator::Stop (Seconds(5));
   
+  // run the two mobility modes (--analyticMobility=0/1) to compare them
+  SystemWallClockMs wallClock;
+  wallClock.Start ();
   Simulator::Run ();
+  int64_t wallTimeMs = wallClock.End ();
+  uint64_t mobilityEvents = BuildingsMobilityModel::GetNUpdateEvents ();
+  std::cout << "Mobility mode: " << (batchMobility ? "batch" : (analyticMobility ? "analytic" : "polling")) << "\n";
+  std::cout << "Mobility events: " << mobilityEvents << "\n";
+  std::cout << "Wall time [ms]: " << wallTimeMs << "\n";
+  if (wallTimeMs > 0)
+    {
+      std::cout << "Mobility events/s: " << (mobilityEvents * 1000.0 / wallTimeMs) << "\n";
+    }
+  if (handoverLatencyStats != 0)
+    {
+      handoverLatencyStats->Print (std::cout);
+    }
+  if (epc && s1apSerialized)
+    {
+      std::cout << "S1-AP messages of the MME:\n";
+      epcHelper->GetPgwNode ()->GetObject<EpcS1apTransport> ()->Print (std::cout);
+    }
 
   //GtkConfigStore config;
   //config.ConfigureAttributes ();